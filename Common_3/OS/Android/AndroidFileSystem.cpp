@@ -452,4 +452,10 @@ FileWatcher* fsCreateFileWatcher(const Path* path, FileWatcherEventMask eventMas
 
 void fsFreeFileWatcher(FileWatcher* fileWatcher) { LOGF(LogLevel::eERROR, "FileWatcher is unsupported on Android."); }
 
+bool fsAddFileWatcherPath(FileWatcher* fileWatcher, const Path* path)
+{
+	LOGF(LogLevel::eERROR, "FileWatcher is unsupported on Android.");
+	return false;
+}
+
 #endif
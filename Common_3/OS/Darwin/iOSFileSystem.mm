@@ -37,6 +37,12 @@ FileWatcher* fsCreateFileWatcher(const Path* path, FileWatcherEventMask eventMas
 
 void fsFreeFileWatcher(FileWatcher* fileWatcher) { LOGF(LogLevel::eERROR, "FileWatcher is unsupported on iOS."); }
 
+bool fsAddFileWatcherPath(FileWatcher* fileWatcher, const Path* path)
+{
+	LOGF(LogLevel::eERROR, "FileWatcher is unsupported on iOS.");
+	return false;
+}
+
 //-------------------------------------------------------------------------------------------------------------
 // CAUTION using URLs for file system directories!
 //
@@ -102,6 +102,12 @@ void fsFreeFileWatcher(FileWatcher* fileWatcher)
 	conf_delete(fileWatcher);
 }
 
+bool fsAddFileWatcherPath(FileWatcher* fileWatcher, const Path* path)
+{
+	// The paths of an FSEventStream are fixed when it is created.
+	return false;
+}
+
 #pragma mark - FileManager Dialogs
 
 void fsShowOpenFileDialog(
@@ -62,6 +62,7 @@ bool fsInitAPI(void)
 
 void fsDeinitAPI(void)
 {
+	fsSetFileMetadataCacheEnabled(fsGetSystemFileSystem(), false);
 	fsResetResourceDirectories();
 }
 
@@ -653,6 +654,12 @@ bool fsFileSystemIsReadOnly(const FileSystem* fileSystem)
 	return fileSystem->IsReadOnly(); 
 }
 
+bool fsSetFileMetadataCacheEnabled(FileSystem* fileSystem, bool enabled)
+{
+	if (!fileSystem) { return false; }
+	return fileSystem->SetMetadataCacheEnabled(enabled);
+}
+
 // MARK: - Resource Directories
 
 #if defined(DIRECT3D12) && !defined(_DURANGO)
@@ -832,6 +839,12 @@ bool fsDeleteFile(const Path* path)
 	return path->pFileSystem->DeleteFile(path); 
 }
 
+bool fsRenameFile(const Path* sourcePath, const Path* destinationPath)
+{
+	if (!sourcePath || !destinationPath || sourcePath->pFileSystem != destinationPath->pFileSystem) { return false; }
+	return sourcePath->pFileSystem->RenameFile(sourcePath, destinationPath);
+}
+
 bool fsFileExists(const Path* path) 
 { 
 	if (!path) { return false; }
@@ -66,6 +66,8 @@ struct FileSystem
 	virtual FileStream* OpenFile(const Path* filePath, FileMode mode) const = 0;
 	virtual bool        CopyFile(const Path* sourcePath, const Path* destinationPath, bool overwriteIfExists) const = 0;
 	virtual bool        DeleteFile(const Path* path) const = 0;
+	/// Replaces destinationPath, which is on this file system as well. Returns false if the file system can't rename files.
+	virtual bool RenameFile(const Path* sourcePath, const Path* destinationPath) const { return false; }
 
 	virtual bool FileExists(const Path* path) const = 0;
 	virtual bool IsDirectory(const Path* path) const = 0;
@@ -74,6 +76,9 @@ struct FileSystem
 		const Path* directory, const char* extension, bool (*processFile)(const Path*, void* userData), void* userData) const = 0;
 	virtual void
 		EnumerateSubDirectories(const Path* directory, bool (*processDirectory)(const Path*, void* userData), void* userData) const = 0;
+
+	/// Enables or disables caching of file existence and timestamp queries. Returns false if the file system does not support it.
+	virtual bool SetMetadataCacheEnabled(bool enabled) { return false; }
 };
 
 // MARK: - Path
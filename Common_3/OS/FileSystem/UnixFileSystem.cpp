@@ -26,12 +26,223 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "../../ThirdParty/OpenSource/EASTL/string.h"
+#include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+
 #include "UnixFileSystem.h"
 #include "SystemFileStream.h"
 
 #include "../Interfaces/ILog.h"
+#include "../Interfaces/IThread.h"
 #include "../Interfaces/IMemory.h"
 
+// MARK: - Metadata Cache
+
+// Every watched directory costs a kernel watch, and a watcher of its own where watchers can't share paths,
+// so stop caching new directories past this limit.
+#define MAX_METADATA_CACHE_WATCHED_DIRECTORIES 128
+
+struct FileMetadataCache
+{
+	Mutex mMutex;
+	/// Incremented on every invalidation so that a stat racing with a change is never inserted.
+	uint64_t mGeneration;
+	eastl::unordered_map<eastl::string, UnixFileSystem::FileMetadata> mEntries;
+	/// Watchers for the parent directories of cached entries.
+	/// A NULL watcher marks a directory which can't be watched; its files are never cached.
+	eastl::unordered_map<eastl::string, FileWatcher*> mWatchers;
+	/// Watches every directory where the platform allows it, so that the whole cache needs a single watcher thread.
+	FileWatcher* pSharedWatcher;
+};
+
+static void statFileMetadata(const char* nativePath, UnixFileSystem::FileMetadata* metadata)
+{
+	struct stat fileInfo = {};
+
+	metadata->mExists = stat(nativePath, &fileInfo) == 0;
+	metadata->mIsDirectory = metadata->mExists && (fileInfo.st_mode & S_IFDIR);
+	metadata->mCreationTime = fileInfo.st_ctime;
+	metadata->mLastModifiedTime = fileInfo.st_mtime;
+}
+
+static void metadataCacheWatcherCallback(const Path* path, uint32_t action)
+{
+	// Only UnixFileSystem registers this callback, so the path always belongs to one.
+	const UnixFileSystem* fileSystem = (const UnixFileSystem*)fsGetPathFileSystem(path);
+	fileSystem->InvalidateMetadata(path);
+}
+
+/// Returns true if the parent directory of `path` is watched, creating the watcher if needed.
+/// Must be called with the cache's mutex held.
+static bool watchParentDirectory(FileMetadataCache* cache, const Path* path)
+{
+	Path* parentPath = fsCopyParentPath(path);
+	if (!parentPath)
+	{
+		return false;
+	}
+
+	eastl::string parent = fsGetPathAsNativeString(parentPath);
+	eastl::unordered_map<eastl::string, FileWatcher*>::iterator it = cache->mWatchers.find(parent);
+	if (it == cache->mWatchers.end())
+	{
+		FileWatcher* watcher = NULL;
+		if (cache->mWatchers.size() < MAX_METADATA_CACHE_WATCHED_DIRECTORIES)
+		{
+			if (cache->pSharedWatcher && fsAddFileWatcherPath(cache->pSharedWatcher, parentPath))
+			{
+				watcher = cache->pSharedWatcher;
+			}
+			else
+			{
+				watcher = fsCreateFileWatcher(
+					parentPath, (FileWatcherEventMask)(FWE_MODIFIED | FWE_CREATED | FWE_DELETED), metadataCacheWatcherCallback);
+				if (!cache->pSharedWatcher)
+				{
+					cache->pSharedWatcher = watcher;
+				}
+			}
+		}
+		it = cache->mWatchers.insert(eastl::make_pair(parent, watcher)).first;
+	}
+
+	fsFreePath(parentPath);
+	return it->second != NULL;
+}
+
+bool UnixFileSystem::SetMetadataCacheEnabled(bool enabled)
+{
+	if (enabled == (pMetadataCache != NULL))
+	{
+		return true;
+	}
+
+	if (enabled)
+	{
+		FileMetadataCache* cache = conf_new(FileMetadataCache);
+		cache->mMutex.Init();
+		cache->mGeneration = 0;
+		cache->pSharedWatcher = NULL;
+		pMetadataCache = cache;
+		return true;
+	}
+
+	// Free the watchers first so that no callback can reach the cache while it is destroyed.
+	FileMetadataCache* cache = pMetadataCache;
+	for (eastl::unordered_map<eastl::string, FileWatcher*>::iterator it = cache->mWatchers.begin(); it != cache->mWatchers.end(); ++it)
+	{
+		if (it->second && it->second != cache->pSharedWatcher)
+		{
+			fsFreeFileWatcher(it->second);
+		}
+	}
+	if (cache->pSharedWatcher)
+	{
+		fsFreeFileWatcher(cache->pSharedWatcher);
+	}
+
+	pMetadataCache = NULL;
+	cache->mMutex.Destroy();
+	conf_delete(cache);
+	return true;
+}
+
+void UnixFileSystem::InvalidateMetadata(const Path* path) const
+{
+	FileMetadataCache* cache = pMetadataCache;
+	if (!cache)
+	{
+		return;
+	}
+
+	eastl::string key = fsGetPathAsNativeString(path);
+	eastl::string prefix = key + '/';
+
+	MutexLock lock(cache->mMutex);
+	++cache->mGeneration;
+	cache->mEntries.erase(key);
+
+	// A renamed or deleted directory takes everything below it along. Any cached entry below `path` has a watched
+	// parent directory, so there is nothing more to drop unless `path` is or contains one.
+	bool isWatchedTree = false;
+	for (eastl::unordered_map<eastl::string, FileWatcher*>::iterator it = cache->mWatchers.begin(); it != cache->mWatchers.end();)
+	{
+		if (it->first != key && it->first.compare(0, prefix.size(), prefix) != 0)
+		{
+			++it;
+			continue;
+		}
+
+		isWatchedTree = true;
+		// Forget shared and failed watches so that they are set up again for whatever lives at the path next.
+		// Dedicated watchers can't be freed from their own callback, so they stay registered.
+		if (!it->second || it->second == cache->pSharedWatcher)
+		{
+			it = cache->mWatchers.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	if (isWatchedTree)
+	{
+		for (eastl::unordered_map<eastl::string, FileMetadata>::iterator it = cache->mEntries.begin(); it != cache->mEntries.end();)
+		{
+			if (it->first.compare(0, prefix.size(), prefix) == 0)
+			{
+				it = cache->mEntries.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
+
+void UnixFileSystem::GetMetadata(const Path* path, FileMetadata* metadata) const
+{
+	const char*        nativePath = fsGetPathAsNativeString(path);
+	FileMetadataCache* cache = pMetadataCache;
+	if (!cache)
+	{
+		statFileMetadata(nativePath, metadata);
+		return;
+	}
+
+	eastl::string key = nativePath;
+	uint64_t      generation = 0;
+	bool          cacheable = false;
+	{
+		MutexLock lock(cache->mMutex);
+		eastl::unordered_map<eastl::string, FileMetadata>::const_iterator it = cache->mEntries.find(key);
+		if (it != cache->mEntries.end())
+		{
+			*metadata = it->second;
+			return;
+		}
+
+		// The watcher has to exist before the stat, otherwise a change in between would go unnoticed.
+		cacheable = watchParentDirectory(cache, path);
+		generation = cache->mGeneration;
+	}
+
+	statFileMetadata(nativePath, metadata);
+
+	if (cacheable)
+	{
+		MutexLock lock(cache->mMutex);
+		if (generation == cache->mGeneration)
+		{
+			cache->mEntries.insert(eastl::make_pair(key, *metadata));
+		}
+	}
+}
+
+// MARK: - UnixFileSystem
+
 bool UnixFileSystem::IsReadOnly() const { return false; }
 
 char UnixFileSystem::GetPathDirectorySeparator() const { return '/'; }
@@ -59,6 +270,11 @@ bool UnixFileSystem::FormRootPath(const char* absolutePathString, Path* path, si
 FileStream* UnixFileSystem::OpenFile(const Path* filePath, FileMode mode) const
 {
 	FILE* file = fopen(fsGetPathAsNativeString(filePath), fsFileModeToString(mode));
+	if (mode & (FM_WRITE | FM_APPEND))
+	{
+		InvalidateMetadata(filePath);
+	}
+
 	if (!file)
 	{
 		return NULL;
@@ -69,10 +285,9 @@ FileStream* UnixFileSystem::OpenFile(const Path* filePath, FileMode mode) const
 
 time_t UnixFileSystem::GetCreationTime(const Path* filePath) const
 {
-	struct stat fileInfo = {};
-
-	stat(fsGetPathAsNativeString(filePath), &fileInfo);
-	return fileInfo.st_ctime;
+	FileMetadata metadata;
+	GetMetadata(filePath, &metadata);
+	return metadata.mCreationTime;
 }
 
 time_t UnixFileSystem::GetLastAccessedTime(const Path* filePath) const
@@ -85,10 +300,9 @@ time_t UnixFileSystem::GetLastAccessedTime(const Path* filePath) const
 
 time_t UnixFileSystem::GetLastModifiedTime(const Path* filePath) const
 {
-	struct stat fileInfo = {};
-
-	stat(fsGetPathAsNativeString(filePath), &fileInfo);
-	return fileInfo.st_mtime;
+	FileMetadata metadata;
+	GetMetadata(filePath, &metadata);
+	return metadata.mLastModifiedTime;
 }
 
 bool UnixFileSystem::CreateDirectory(const Path* directoryPath) const
@@ -105,7 +319,9 @@ bool UnixFileSystem::CreateDirectory(const Path* directoryPath) const
         fsFreePath(parentPath);
 	}
 
-	if (mkdir(fsGetPathAsNativeString(directoryPath), 0777) != 0)
+	int result = mkdir(fsGetPathAsNativeString(directoryPath), 0777);
+	InvalidateMetadata(directoryPath);
+	if (result != 0)
 	{
 		LOGF(LogLevel::eINFO, "Unable to create directory at %s: %s", fsGetPathAsNativeString(directoryPath), strerror(errno));
 		return false;
@@ -114,21 +330,46 @@ bool UnixFileSystem::CreateDirectory(const Path* directoryPath) const
 	return true;
 }
 
-bool UnixFileSystem::FileExists(const Path* path) const { return access(fsGetPathAsNativeString(path), F_OK) != -1; }
+bool UnixFileSystem::FileExists(const Path* path) const
+{
+	if (!pMetadataCache)
+	{
+		return access(fsGetPathAsNativeString(path), F_OK) != -1;
+	}
+
+	FileMetadata metadata;
+	GetMetadata(path, &metadata);
+	return metadata.mExists;
+}
 
 bool UnixFileSystem::IsDirectory(const Path* path) const
 {
-	struct stat s;
-	if (stat(fsGetPathAsNativeString(path), &s) == 0 && (s.st_mode & S_IFDIR))
+	FileMetadata metadata;
+	GetMetadata(path, &metadata);
+	return metadata.mIsDirectory;
+}
+
+bool UnixFileSystem::RenameFile(const Path* sourcePath, const Path* destinationPath) const
+{
+	int result = rename(fsGetPathAsNativeString(sourcePath), fsGetPathAsNativeString(destinationPath));
+	InvalidateMetadata(sourcePath);
+	InvalidateMetadata(destinationPath);
+	if (result != 0)
 	{
-		return true;
+		LOGF(
+			LogLevel::eINFO, "Unable to rename file %s to %s: %s", fsGetPathAsNativeString(sourcePath),
+			fsGetPathAsNativeString(destinationPath), strerror(errno));
+		return false;
 	}
-	return false;
+
+	return true;
 }
 
 bool UnixFileSystem::DeleteFile(const Path* path) const
 {
-	if (remove(fsGetPathAsNativeString(path)) != 0)
+	int result = remove(fsGetPathAsNativeString(path));
+	InvalidateMetadata(path);
+	if (result != 0)
 	{
 		LOGF(LogLevel::eINFO, "Unable to delete file at %s: %s", fsGetPathAsNativeString(path), strerror(errno));
 		return false;
@@ -27,10 +27,12 @@
 
 #include "FileSystemInternal.h"
 
+struct FileMetadataCache;
+
 class UnixFileSystem: public FileSystem
 {
 	public:
-    inline UnixFileSystem() : FileSystem(FSK_SYSTEM) {};
+    inline UnixFileSystem() : FileSystem(FSK_SYSTEM), pMetadataCache(NULL) {};
 
 	bool   IsReadOnly() const override;
 	char   GetPathDirectorySeparator() const override;
@@ -47,11 +49,32 @@ class UnixFileSystem: public FileSystem
 
 	bool CreateDirectory(const Path* directoryPath) const override;
 	bool DeleteFile(const Path* path) const override;
+	bool RenameFile(const Path* sourcePath, const Path* destinationPath) const override;
 
 	bool FileExists(const Path* path) const override;
 	bool IsDirectory(const Path* path) const override;
 
 	FileStream* OpenFile(const Path* filePath, FileMode mode) const override;
+
+	struct FileMetadata
+	{
+		bool   mExists;
+		bool   mIsDirectory;
+		time_t mCreationTime;
+		time_t mLastModifiedTime;
+	};
+
+	bool SetMetadataCacheEnabled(bool enabled) override;
+
+	/// Drops any cached metadata for `path` and, if it is a directory, for everything below it. Called from the cache's
+	/// FileWatchers and after modifications made through this file system, since watcher notifications arrive asynchronously.
+	void InvalidateMetadata(const Path* path) const;
+
+	protected:
+	/// Fills `metadata` with the result of a stat call for `path`, serving it from the metadata cache when possible.
+	void GetMetadata(const Path* path, FileMetadata* metadata) const;
+
+	FileMetadataCache* pMetadataCache;
 };
 
 #endif /* UnixFileSystem_h */
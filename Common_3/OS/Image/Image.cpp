@@ -29,6 +29,7 @@
 
 #include "../../ThirdParty/OpenSource/EASTL/functional.h"
 #include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
 
 #define IMAGE_CLASS_ALLOWED
 #include "Image.h"
@@ -71,6 +72,21 @@
 #include "../../ThirdParty/OpenSource/tinyktx/tinyktx.h"
 #endif
 #include "ImageHelper.h"
+#include "../Core/ThreadSystem.h"
+#include "../Core/Atomics.h"
+#include "../Interfaces/ITime.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define IMAGE_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMAGE_SIMD_NEON
+#include <arm_neon.h>
+#endif
 
 #include "../Interfaces/IMemory.h"
 
@@ -91,9 +107,7 @@ typedef struct PVR_Header_Texture_TAG
 	uint32_t 	mMetaDataSize; //!< Size of the accompanying meta data.
 } PVR_Texture_Header;
 
-#ifdef TARGET_IOS
 const uint32_t gPvrtexV3HeaderVersion = 0x03525650;
-#endif
 
 // --- BLOCK DECODING ---
 
@@ -207,28 +221,37 @@ void iDecodeDXT5Block(unsigned char* dest, int w, int h, int xOff, int yOff, uns
 
 void iDecodeCompressedImage(unsigned char* dest, unsigned char* src, const int width, const int height, const TinyImageFormat format)
 {
-	int sx = (width < 4) ? width : 4;
-	int sy = (height < 4) ? height : 4;
-
 	int nChannels = TinyImageFormat_ChannelCount(format);
 
 	for (int y = 0; y < height; y += 4)
 	{
+		// edge blocks only write the pixels inside the image
+		int sy = (height - y < 4) ? height - y : 4;
 		for (int x = 0; x < width; x += 4)
 		{
+			int sx = (width - x < 4) ? width - x : 4;
 			unsigned char* dst = dest + (y * width + x) * nChannels;
 			if (format == TinyImageFormat_DXBC2_UNORM || format == TinyImageFormat_DXBC2_SRGB)
 			{
 				iDecodeDXT3Block(dst + 3, sx, sy, nChannels, width * nChannels, src);
+				iDecodeColorBlock(dst, sx, sy, nChannels, width * nChannels, format, 0, 2, src + 8);
 			}
 			else if (format == TinyImageFormat_DXBC3_UNORM || format == TinyImageFormat_DXBC3_SRGB)
 			{
 				iDecodeDXT5Block(dst + 3, sx, sy, nChannels, width * nChannels, src);
+				iDecodeColorBlock(dst, sx, sy, nChannels, width * nChannels, format, 0, 2, src + 8);
 			}
-			if ((format == TinyImageFormat_DXBC1_RGBA_UNORM || format == TinyImageFormat_DXBC1_RGB_UNORM) ||
+			else if ((format == TinyImageFormat_DXBC1_RGBA_UNORM || format == TinyImageFormat_DXBC1_RGB_UNORM) ||
 					(format == TinyImageFormat_DXBC1_RGBA_SRGB || format == TinyImageFormat_DXBC1_RGB_SRGB))
             {
 				iDecodeColorBlock(dst, sx, sy, nChannels, width * nChannels, format, 0, 2, src);
+				// punch through alpha is not decoded, BC1 blocks come out opaque
+				if (nChannels == 4)
+				{
+					for (int by = 0; by < sy; ++by)
+						for (int bx = 0; bx < sx; ++bx)
+							dst[(by * width + bx) * 4 + 3] = 255;
+				}
 			}
 			else
 			{
@@ -238,8 +261,8 @@ void iDecodeCompressedImage(unsigned char* dest, unsigned char* src, const int w
 				}
 				else if (format == TinyImageFormat_DXBC5_UNORM || format == TinyImageFormat_DXBC5_SNORM)
 				{
-					iDecodeDXT5Block(dst, sx, sy, 2, width * 2, src + 8);
-					iDecodeDXT5Block(dst + 1, sx, sy, 2, width * 2, src);
+					iDecodeDXT5Block(dst, sx, sy, 2, width * 2, src);
+					iDecodeDXT5Block(dst + 1, sx, sy, 2, width * 2, src + 8);
 				}
 				else
 					return;
@@ -264,11 +287,6 @@ Image::Image()
 	pAdditionalData = NULL;
 	mOwnsMemory = true;
 	mLinearLayout = true;
-
-#ifndef IMAGE_DISABLE_GOOGLE_BASIS
-	// Init basisu
-	basist::basisu_transcoder_init();
-#endif
 }
 
 Image::Image(const Image& img)
@@ -280,8 +298,10 @@ Image::Image(const Image& img)
 	mArrayCount = img.mArrayCount;
 	mFormat = img.mFormat;
 	mLinearLayout = img.mLinearLayout;
+	mMipsAfterSlices = img.mMipsAfterSlices;
+	mOwnsMemory = true;
 
-	int size = GetMipMappedSize(0, mMipMapCount) * mArrayCount;
+	int size = GetMipMappedSize(0, mMipMapCount) * (mMipsAfterSlices ? 1 : mArrayCount);
 	pData = (unsigned char*)conf_malloc(sizeof(unsigned char) * size);
 	memcpy(pData, img.pData, size);
 	mLoadFilePath = fsCopyPath(img.mLoadFilePath);
@@ -780,46 +800,50 @@ static void tinyktxddsCallbackWrite(void* user, void const* data, size_t size) {
 
 // Load Image Data form mData functions
 
-bool iLoadDDSFromMemory(Image* pImage,
-	const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator, void* pUserData)
+// Reads size bytes at offset straight into the image allocation
+static bool iReadSubresource(FileStream* pStream, int64_t offset, void* pDst, size_t size)
 {
-	if (memory == NULL || memSize == 0)
+	if (!fsSeekStream(pStream, SBO_START_OF_FILE, offset))
 		return false;
+	return (size_t)fsReadFromStream(pStream, pDst, size) == size;
+}
 
+// Streams DDS pixel data one subresource at a time into the destination returned by pAllocator.
+// Only the header is parsed by tinydds, no intermediate copy of the file or of a mip level is made.
+bool iLoadDDSFromStream(Image* pImage, FileStream* pStream, memoryAllocationFunc pAllocator, void* pUserData)
+{
 	TinyDDS_Callbacks callbacks {
 			&tinyktxddsCallbackError,
 			&tinyktxddsCallbackAlloc,
 			&tinyktxddsCallbackFree,
-			tinyktxddsCallbackRead,
+			&tinyktxddsCallbackRead,
 			&tinyktxddsCallbackSeek,
 			&tinyktxddsCallbackTell
 	};
 
-    FileStream *fh = fsOpenReadOnlyMemory(memory, memSize);
-
-	auto ctx = TinyDDS_CreateContext(&callbacks, (void*)fh);
-	bool headerOkay = TinyDDS_ReadHeader(ctx);
-	if(!headerOkay) {
-        fsCloseStream(fh);
+	TinyDDS_ContextHandle ctx = TinyDDS_CreateContext(&callbacks, (void*)pStream);
+	if (!TinyDDS_ReadHeader(ctx))
+	{
 		TinyDDS_DestroyContext(ctx);
 		return false;
 	}
+	int64_t const firstImagePos = fsGetStreamSeekPosition(pStream);
 
 	uint32_t w = TinyDDS_Width(ctx);
 	uint32_t h = TinyDDS_Height(ctx);
 	uint32_t d = TinyDDS_Depth(ctx);
 	uint32_t s = TinyDDS_ArraySlices(ctx);
 	uint32_t mm = TinyDDS_NumberOfMipmaps(ctx);
+	bool const isCube = TinyDDS_IsCubemap(ctx);
 	TinyImageFormat fmt = TinyImageFormat_FromTinyDDSFormat(TinyDDS_GetFormat(ctx));
 	if(fmt == TinyImageFormat_UNDEFINED)
 	{
-        fsCloseStream(fh);
 		TinyDDS_DestroyContext(ctx);
 		return false;
 	}
 
 	// TheForge Image uses d = 0 as cubemap marker
-	if(TinyDDS_IsCubemap(ctx))
+	if(isCube)
 		d = 0;
 	else
 		d = d ? d : 1;
@@ -828,6 +852,19 @@ bool iLoadDDSFromMemory(Image* pImage,
 	pImage->RedefineDimensions(fmt, w, h, d, mm, s);
 	pImage->SetMipsAfterSlices(true); // tinyDDS API is mips after slices even if DDS traditionally weren't
 
+	uint32_t const mipMapCount = pImage->GetMipMapCount();
+	for (uint mipMapLevel = 0; mipMapLevel < mipMapCount; mipMapLevel++)
+	{
+		size_t const expectedSize = pImage->GetMipMappedSize(mipMapLevel, 1);
+		size_t const fileSize = TinyDDS_ImageSize(ctx, mipMapLevel);
+		if (expectedSize != fileSize)
+		{
+			LOGF(LogLevel::eERROR, "DDS file %s mipmap %i size error %liu < %liu", fsGetPathAsNativeString(pImage->GetPath()), mipMapLevel, expectedSize, fileSize);
+			TinyDDS_DestroyContext(ctx);
+			return false;
+		}
+	}
+
 	int size = pImage->GetMipMappedSize();
 
 	if (pAllocator)
@@ -835,24 +872,59 @@ bool iLoadDDSFromMemory(Image* pImage,
 	else
 		pImage->SetPixels((unsigned char*)conf_malloc(sizeof(unsigned char) * size), true);
 
-	for (uint mipMapLevel = 0; mipMapLevel < pImage->GetMipMapCount(); mipMapLevel++)
+	if (!pImage->GetPixels())
 	{
-		size_t const expectedSize = pImage->GetMipMappedSize(mipMapLevel, 1);
-		size_t const fileSize = TinyDDS_ImageSize(ctx, mipMapLevel);
-		if (expectedSize != fileSize)
+		TinyDDS_DestroyContext(ctx);
+		return false;
+	}
+
+	// Same file layout tinydds assumes: cubemaps store six full mip chains one after the other,
+	// everything else stores each mip level with all its slices contiguous
+	uint64_t faceStride = 0;
+	if (isCube)
+	{
+		for (uint32_t i = 0; i < mipMapCount; ++i)
+			faceStride += TinyDDS_FaceSize(ctx, i);
+	}
+
+	bool success = true;
+	uint64_t mipOffset = 0;
+	for (uint mipMapLevel = 0; success && mipMapLevel < mipMapCount; mipMapLevel++)
+	{
+		unsigned char* dst = pImage->GetPixels(mipMapLevel, 0);
+		if (isCube)
 		{
-			LOGF(LogLevel::eERROR, "DDS file %s mipmap %i size error %liu < %liu", fsGetPathAsNativeString(pImage->GetPath()), mipMapLevel, expectedSize, fileSize);
-            fsCloseStream(fh);
-			return false;
+			size_t const faceSize = TinyDDS_FaceSize(ctx, mipMapLevel);
+			for (uint32_t face = 0; success && face < 6; ++face)
+				success = iReadSubresource(pStream, firstImagePos + mipOffset + face * faceStride, dst + face * faceSize, faceSize);
+			mipOffset += faceSize;
+		}
+		else
+		{
+			size_t const sliceSize = TinyDDS_ImageSize(ctx, mipMapLevel) / s;
+			for (uint32_t slice = 0; success && slice < s; ++slice)
+				success = iReadSubresource(pStream, firstImagePos + mipOffset + slice * sliceSize, dst + slice * sliceSize, sliceSize);
+			mipOffset += sliceSize * s;
 		}
-		unsigned char *dst = pImage->GetPixels(mipMapLevel, 0);
-		memcpy(dst, TinyDDS_ImageRawData(ctx, mipMapLevel), fileSize);
 	}
 
+	if (!success)
+		LOGF(LogLevel::eERROR, "DDS file %s is truncated", fsGetPathAsNativeString(pImage->GetPath()));
+
 	TinyDDS_DestroyContext(ctx);
-    fsCloseStream(fh);
-    
-	return true;
+	return success;
+}
+
+bool iLoadDDSFromMemory(Image* pImage,
+	const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	if (memory == NULL || memSize == 0)
+		return false;
+
+	FileStream* fh = fsOpenReadOnlyMemory(memory, memSize);
+	bool loaded = iLoadDDSFromStream(pImage, fh, pAllocator, pUserData);
+	fsCloseStream(fh);
+	return loaded;
 }
 
 bool iLoadPVRFromMemory(Image* pImage, const char* memory, uint32_t size, memoryAllocationFunc pAllocator, void* pUserData)
@@ -941,7 +1013,9 @@ bool iLoadPVRFromMemory(Image* pImage, const char* memory, uint32_t size, memory
 }
 
 #ifndef IMAGE_DISABLE_KTX
-bool iLoadKTXFromMemory(Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator /*= NULL*/, void* pUserData /*= NULL*/)
+// Streams KTX pixel data one mip level at a time into the destination returned by pAllocator.
+// Rows padded to 4 bytes by the KTX spec are read row by row and the padding skipped.
+bool iLoadKTXFromStream(Image* pImage, FileStream* pStream, memoryAllocationFunc pAllocator, void* pUserData)
 {
 	TinyKtx_Callbacks callbacks {
 			&tinyktxddsCallbackError,
@@ -952,15 +1026,13 @@ bool iLoadKTXFromMemory(Image* pImage, const char* memory, uint32_t memSize, mem
 			&tinyktxddsCallbackTell
 	};
 
-    FileStream *fh = fsOpenReadOnlyMemory(memory, memSize);
-
-	auto ctx = TinyKtx_CreateContext( &callbacks, (void*)fh);
-	bool headerOkay = TinyKtx_ReadHeader(ctx);
-	if(!headerOkay) {
-        fsCloseStream(fh);
+	TinyKtx_ContextHandle ctx = TinyKtx_CreateContext(&callbacks, (void*)pStream);
+	if (!TinyKtx_ReadHeader(ctx))
+	{
 		TinyKtx_DestroyContext(ctx);
 		return false;
 	}
+	int64_t const firstImagePos = fsGetStreamSeekPosition(pStream);
 
 	uint32_t w = TinyKtx_Width(ctx);
 	uint32_t h = TinyKtx_Height(ctx);
@@ -968,65 +1040,88 @@ bool iLoadKTXFromMemory(Image* pImage, const char* memory, uint32_t memSize, mem
 	uint32_t s = TinyKtx_ArraySlices(ctx);
 	uint32_t mm = TinyKtx_NumberOfMipmaps(ctx);
 	TinyImageFormat fmt = TinyImageFormat_FromTinyKtxFormat(TinyKtx_GetFormat(ctx));
-	if(fmt == TinyImageFormat_UNDEFINED) {
-        fsCloseStream(fh);
+	if(fmt == TinyImageFormat_UNDEFINED)
+	{
 		TinyKtx_DestroyContext(ctx);
 		return false;
 	}
 
-    // TheForge Image uses d = 0 as cubemap marker
-    if(TinyKtx_IsCubemap(ctx)) d = 0;
-    else d = d ? d : 1;
-    s = s ? s : 1;
+	// TheForge Image uses d = 0 as cubemap marker
+	if(TinyKtx_IsCubemap(ctx)) d = 0;
+	else d = d ? d : 1;
+	s = s ? s : 1;
 
 	pImage->RedefineDimensions(fmt, w, h, d, mm, s);
-    pImage->SetMipsAfterSlices(true); // tinyDDS API is mips after slices even if DDS traditionally weren't
+	pImage->SetMipsAfterSlices(true); // tinyDDS API is mips after slices even if DDS traditionally weren't
 
 	int size = pImage->GetMipMappedSize();
 
 	if (pAllocator)
-	{
 		pImage->SetPixels((uint8_t*)pAllocator(pImage, size, pUserData));
-	}
 	else
-	{
 		pImage->SetPixels((uint8_t*)conf_malloc(sizeof(uint8_t) * size), true);
+
+	if (!pImage->GetPixels())
+	{
+		TinyKtx_DestroyContext(ctx);
+		return false;
 	}
-    
-    for (uint mipMapLevel = 0; mipMapLevel < pImage->GetMipMapCount(); mipMapLevel++)
-    {
-        uint8_t const* src = (uint8_t const*) TinyKtx_ImageRawData(ctx, mipMapLevel);
-        uint8_t *dst = pImage->GetPixels(mipMapLevel, 0);
-
-        if(TinyKtx_IsMipMapLevelUnpacked(ctx, mipMapLevel)) {
-            uint32_t const srcStride = TinyKtx_UnpackedRowStride(ctx, mipMapLevel);
-            uint32_t const dstStride = (pImage->GetWidth(mipMapLevel) * TinyImageFormat_BitSizeOfBlock(fmt)) /
-                                        (TinyImageFormat_PixelCountOfBlock(fmt) * 8);
-
-            for (uint32_t ww = 0u; ww < TinyKtx_ArraySlices(ctx); ++ww) {
-                for (uint32_t zz = 0; zz < TinyKtx_Depth(ctx); ++zz) {
-                    for (uint32_t yy = 0; yy < TinyKtx_Height(ctx); ++yy) {
-                        memcpy(dst, src, dstStride);
-                        src += srcStride;
-                        dst += dstStride;
-                    }
-                }
-            }
-        } else {
-            // fast path data is packed we can just copy
-            size_t const expectedSize = pImage->GetMipMappedSize(mipMapLevel, 1);
-            size_t const fileSize = TinyKtx_ImageSize(ctx, mipMapLevel);
-            if (expectedSize != fileSize) {
-                LOGF(LogLevel::eERROR, "DDS file %s mipmap %i size error %liu < %liu", fsGetPathAsNativeString(pImage->GetPath()),mipMapLevel, expectedSize, fileSize);
-                return false;
-            }
-            memcpy(dst, src, fileSize);
-        }
+
+	bool success = true;
+	// Each mip level is prefixed by its uint32 image size and padded to 4 bytes
+	int64_t mipOffset = firstImagePos;
+	for (uint mipMapLevel = 0; success && mipMapLevel < pImage->GetMipMapCount(); mipMapLevel++)
+	{
+		uint32_t const fileSize = TinyKtx_ImageSize(ctx, mipMapLevel);
+		uint8_t* dst = pImage->GetPixels(mipMapLevel, 0);
+
+		if (TinyKtx_IsMipMapLevelUnpacked(ctx, mipMapLevel))
+		{
+			uint32_t const srcStride = TinyKtx_UnpackedRowStride(ctx, mipMapLevel);
+			uint32_t const dstStride = (pImage->GetWidth(mipMapLevel) * TinyImageFormat_BitSizeOfBlock(fmt)) /
+										(TinyImageFormat_PixelCountOfBlock(fmt) * 8);
+			uint32_t const rowCount = s * max(1U, pImage->GetDepth(mipMapLevel)) * pImage->GetHeight(mipMapLevel);
+
+			success = fsSeekStream(pStream, SBO_START_OF_FILE, mipOffset + sizeof(uint32_t));
+			for (uint32_t row = 0; success && row < rowCount; ++row)
+			{
+				success = (uint32_t)fsReadFromStream(pStream, dst, dstStride) == dstStride &&
+						  fsSeekStream(pStream, SBO_CURRENT_POSITION, srcStride - dstStride);
+				dst += dstStride;
+			}
+		}
+		else
+		{
+			// fast path data is packed we can just copy
+			size_t const expectedSize = pImage->GetMipMappedSize(mipMapLevel, 1);
+			if (expectedSize != fileSize)
+			{
+				LOGF(LogLevel::eERROR, "KTX file %s mipmap %i size error %liu < %liu", fsGetPathAsNativeString(pImage->GetPath()), mipMapLevel, expectedSize, (size_t)fileSize);
+				TinyKtx_DestroyContext(ctx);
+				return false;
+			}
+			success = iReadSubresource(pStream, mipOffset + sizeof(uint32_t), dst, fileSize);
+		}
+
+		mipOffset += (fileSize + sizeof(uint32_t) + 3u) & ~3u;
 	}
 
-    fsCloseStream(fh);
+	if (!success)
+		LOGF(LogLevel::eERROR, "KTX file %s is truncated", fsGetPathAsNativeString(pImage->GetPath()));
+
 	TinyKtx_DestroyContext(ctx);
-	return true;
+	return success;
+}
+
+bool iLoadKTXFromMemory(Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator /*= NULL*/, void* pUserData /*= NULL*/)
+{
+	if (memory == NULL || memSize == 0)
+		return false;
+
+	FileStream* fh = fsOpenReadOnlyMemory(memory, memSize);
+	bool loaded = iLoadKTXFromStream(pImage, fh, pAllocator, pUserData);
+	fsCloseStream(fh);
+	return loaded;
 }
 #endif
 
@@ -1219,8 +1314,137 @@ bool Image::iLoadGNFFromMemory(const char* memory, size_t memSize, const bool us
 }
 #endif
 
+//------------------------------------------------------------------------------
+// Set by Image::Init. Loaders that transcode pick their target from the formats the GPU can sample,
+// an empty table allows every format.
+static bool          gSampleableFormats[TinyImageFormat_Count];
+static bool          gHasSampleableFormats = false;
+static ThreadSystem* pImageThreadSystem = NULL;
+// Init and Exit calls may nest, only the outermost pair creates and frees the shared state
+static uint32_t      gImageInitCount = 0;
+
+static inline bool iCanSampleFormat(TinyImageFormat fmt) { return !gHasSampleableFormats || gSampleableFormats[fmt]; }
+
+static void iRunImageTasks(ThreadSystem* pThreadSystem, TaskFunc task, void* pUser, uint32_t count);
+
 //------------------------------------------------------------------------------
 #ifndef IMAGE_DISABLE_GOOGLE_BASIS
+// Read only once constructed, so one codebook created in Image::Init serves every load and thread
+static basist::etc1_global_selector_codebook* pBasisCodebook = NULL;
+
+typedef struct BasisTarget
+{
+	basist::transcoder_texture_format mBasisFormat;
+	TinyImageFormat                   mFormat;
+} BasisTarget;
+
+// In order of preference. The first entry of each list must be a block format iDecodeCompressedImage handles.
+// From ETC1S data BC7 mode 6 is barely better than BC1 at twice the size, so it is only used without BC1.
+static const BasisTarget gBasisOpaqueTargets[] = {
+	{ basist::cTFBC1, TinyImageFormat_DXBC1_RGBA_UNORM },
+	{ basist::cTFBC7_M6_OPAQUE_ONLY, TinyImageFormat_DXBC7_UNORM },
+	{ basist::cTFETC1, TinyImageFormat_ETC2_R8G8B8_UNORM },
+	{ basist::cTFPVRTC1_4_OPAQUE_ONLY, TinyImageFormat_PVRTC1_4BPP_UNORM },
+};
+static const BasisTarget gBasisAlphaTargets[] = {
+	{ basist::cTFBC3, TinyImageFormat_DXBC3_UNORM },
+	{ basist::cTFETC2, TinyImageFormat_ETC2_R8G8B8A8_UNORM },
+};
+static const BasisTarget gBasisNormalMapTargets[] = {
+	{ basist::cTFBC5, TinyImageFormat_DXBC5_UNORM },
+};
+
+// Picks the transcode target for a Basis file. Shared by the loader and the header probe.
+// If the GPU can sample none of the candidates the file is transcoded to the first one and
+// decoded to 8 bit on the CPU, pOutDecodeFormat then holds that intermediate block format.
+static TinyImageFormat iGetBASISTargetFormat(
+	bool isNormalMap, bool hasAlpha, bool isPowerOfTwo, basist::transcoder_texture_format* pOutBasisFormat,
+	TinyImageFormat* pOutDecodeFormat)
+{
+	const BasisTarget* pTargets = gBasisOpaqueTargets;
+	uint32_t           targetCount = sizeof(gBasisOpaqueTargets) / sizeof(gBasisOpaqueTargets[0]);
+	if (isNormalMap)
+	{
+		pTargets = gBasisNormalMapTargets;
+		targetCount = sizeof(gBasisNormalMapTargets) / sizeof(gBasisNormalMapTargets[0]);
+	}
+	else if (hasAlpha)
+	{
+		pTargets = gBasisAlphaTargets;
+		targetCount = sizeof(gBasisAlphaTargets) / sizeof(gBasisAlphaTargets[0]);
+	}
+
+	*pOutDecodeFormat = TinyImageFormat_UNDEFINED;
+	for (uint32_t i = 0; i < targetCount; ++i)
+	{
+		if (pTargets[i].mBasisFormat == basist::cTFPVRTC1_4_OPAQUE_ONLY && !isPowerOfTwo)
+			continue;
+
+		if (iCanSampleFormat(pTargets[i].mFormat))
+		{
+			*pOutBasisFormat = pTargets[i].mBasisFormat;
+			return pTargets[i].mFormat;
+		}
+	}
+
+	*pOutBasisFormat = pTargets[0].mBasisFormat;
+	*pOutDecodeFormat = pTargets[0].mFormat;
+	return isNormalMap ? TinyImageFormat_R8G8_UNORM : TinyImageFormat_R8G8B8A8_UNORM;
+}
+
+typedef struct BasisTranscodeJob
+{
+	const basist::basisu_transcoder*  pDecoder;
+	const uint8_t*                    pData;
+	uint32_t                          mDataSize;
+	Image*                            pImage;
+	basist::transcoder_texture_format mBasisFormat;
+	TinyImageFormat                   mDecodeFormat;
+	tfrg_atomic32_t                   mFailed;
+} BasisTranscodeJob;
+
+// One task per (image, level)
+static void iTranscodeBASISLevelTask(void* pUser, uintptr_t index)
+{
+	BasisTranscodeJob* pJob = (BasisTranscodeJob*)pUser;
+	Image*             pImage = pJob->pImage;
+	uint32_t const     imageIndex = (uint32_t)index / pImage->GetMipMapCount();
+	uint32_t const     levelIndex = (uint32_t)index % pImage->GetMipMapCount();
+
+	basist::basisu_image_level_info levelInfo;
+	if (!pJob->pDecoder->get_image_level_info(pJob->pData, pJob->mDataSize, levelInfo, imageIndex, levelIndex))
+	{
+		LOGF(LogLevel::eERROR, "Failed retrieving image level information (%u %u)!", imageIndex, levelIndex);
+		tfrg_atomic32_store_relaxed(&pJob->mFailed, 1);
+		return;
+	}
+
+	unsigned char* pDst = pImage->GetPixels(levelIndex, imageIndex);
+	unsigned char* pBlocks = pDst;
+	if (pJob->mDecodeFormat != TinyImageFormat_UNDEFINED)
+		pBlocks = (unsigned char*)conf_malloc(levelInfo.m_total_blocks * (TinyImageFormat_BitSizeOfBlock(pJob->mDecodeFormat) / 8));
+
+	// The transcoder's own state is shared, so every task decodes with a private one
+	basist::basisu_transcoder_state state;
+	uint32_t const                  decodeFlags =
+		basist::basisu_transcoder::cDecodeFlagsPVRTCWrapAddressing | basist::basisu_transcoder::cDecodeFlagsBC1ForbidThreeColorBlocks;
+	if (pJob->pDecoder->transcode_image_level(
+			pJob->pData, pJob->mDataSize, imageIndex, levelIndex, pBlocks, levelInfo.m_total_blocks, pJob->mBasisFormat, decodeFlags, 0,
+			&state))
+	{
+		if (pBlocks != pDst)
+			iDecodeCompressedImage(pDst, pBlocks, pImage->GetWidth(levelIndex), pImage->GetHeight(levelIndex), pJob->mDecodeFormat);
+	}
+	else
+	{
+		LOGF(LogLevel::eERROR, "Failed transcoding image level (%u %u)!", imageIndex, levelIndex);
+		tfrg_atomic32_store_relaxed(&pJob->mFailed, 1);
+	}
+
+	if (pBlocks != pDst)
+		conf_free(pBlocks);
+}
+
 //  Loads a Basis data from memory.
 //
 bool iLoadBASISFromMemory(Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator /*= NULL*/, void* pUserData /*= NULL*/)
@@ -1228,26 +1452,22 @@ bool iLoadBASISFromMemory(Image* pImage, const char* memory, uint32_t memSize, m
 	if (memory == NULL || memSize == 0)
 		return false;
 
-	basist::etc1_global_selector_codebook sel_codebook(basist::g_global_selector_cb_size, basist::g_global_selector_cb);
+	const uint8_t* pBasisData = (const uint8_t*)memory;
 
-	eastl::vector<uint8_t> basis_data;
-	basis_data.resize(memSize);
-	memcpy(basis_data.data(), memory, memSize);
-
-	basist::basisu_transcoder decoder(&sel_codebook);
+	basist::basisu_transcoder decoder(pBasisCodebook);
 
 	basist::basisu_file_info fileinfo;
-	if (!decoder.get_file_info(basis_data.data(), (uint32_t)basis_data.size(), fileinfo))
+	if (!decoder.get_file_info(pBasisData, memSize, fileinfo))
 	{
 		LOGF(LogLevel::eERROR, "Failed retrieving Basis file information!");
 		return false;
 	}
 
 	ASSERT(fileinfo.m_total_images == fileinfo.m_image_mipmap_levels.size());
-	ASSERT(fileinfo.m_total_images == decoder.get_total_images(&basis_data[0], (uint32_t)basis_data.size()));
+	ASSERT(fileinfo.m_total_images == decoder.get_total_images(pBasisData, memSize));
 
 	basist::basisu_image_info imageinfo;
-	decoder.get_image_info(basis_data.data(), (uint32_t)basis_data.size(), imageinfo, 0);
+	decoder.get_image_info(pBasisData, memSize, imageinfo, 0);
 
 	uint32_t width = imageinfo.m_width;
 	uint32_t height = imageinfo.m_height;
@@ -1255,39 +1475,30 @@ bool iLoadBASISFromMemory(Image* pImage, const char* memory, uint32_t memSize, m
 	uint32_t mipMapCount = max(1U, fileinfo.m_image_mipmap_levels[0]);
 	uint32_t arrayCount = fileinfo.m_total_images;
 
-	TinyImageFormat imageFormat = TinyImageFormat_UNDEFINED;
-
-	bool isNormalMap;
-
-	if (fileinfo.m_userdata0 == 1)
-		isNormalMap = true;
-	else
-		isNormalMap = false;
-
-	basist::transcoder_texture_format basisTextureFormat;
-
-	if (!isNormalMap)
+	// Every image of the file becomes an array slice with the same mip count
+	for (uint32_t i = 1; i < arrayCount; ++i)
 	{
-		if (!imageinfo.m_alpha_flag)
-		{
-			imageFormat = TinyImageFormat_DXBC1_RGBA_UNORM;
-			basisTextureFormat = basist::transcoder_texture_format::cTFBC1;
-		}
-		else
+		if (fileinfo.m_image_mipmap_levels[i] != fileinfo.m_image_mipmap_levels[0])
 		{
-			imageFormat = TinyImageFormat_DXBC3_UNORM;
-			basisTextureFormat = basist::transcoder_texture_format::cTFBC3;
+			LOGF(LogLevel::eERROR, "Basis images with differing mip counts are not supported!");
+			return false;
 		}
 	}
-	else
-	{
-        imageFormat = TinyImageFormat_DXBC5_UNORM;
-        basisTextureFormat = basist::transcoder_texture_format::cTFBC5;
-	}
+
+	BasisTranscodeJob job = {};
+	job.pDecoder = &decoder;
+	job.pData = pBasisData;
+	job.mDataSize = memSize;
+	job.pImage = pImage;
+
+	TinyImageFormat imageFormat = iGetBASISTargetFormat(
+		fileinfo.m_userdata0 == 1, imageinfo.m_alpha_flag, isPowerOf2(width) && isPowerOf2(height), &job.mBasisFormat,
+		&job.mDecodeFormat);
 
 	pImage->RedefineDimensions(imageFormat, width, height, depth, mipMapCount, arrayCount);
+	pImage->SetMipsAfterSlices(false);
 
-	int size = pImage->GetMipMappedSize();
+	uint32_t size = pImage->GetMipMappedSize(0, mipMapCount) * arrayCount;
 
 	if (pAllocator)
 	{
@@ -1298,76 +1509,123 @@ bool iLoadBASISFromMemory(Image* pImage, const char* memory, uint32_t memSize, m
 		pImage->SetPixels((unsigned char*)conf_malloc(sizeof(unsigned char) * size), true);
 	}
 
-	decoder.start_transcoding(basis_data.data(), (uint32_t)basis_data.size());
-
-
-	for (uint32_t image_index = 0; image_index < fileinfo.m_total_images; image_index++)
+	// Unpacks the codebooks once, the level tasks only read them
+	if (!decoder.start_transcoding(pBasisData, memSize))
 	{
-		for (uint32_t level_index = 0; level_index < fileinfo.m_image_mipmap_levels[image_index]; level_index++)
-		{
-			basist::basisu_image_level_info level_info;
+		LOGF(LogLevel::eERROR, "Failed to start transcoding Basis file!");
+		return false;
+	}
 
-			if (!decoder.get_image_level_info(&basis_data[0], (uint32_t)basis_data.size(), level_info, image_index, level_index))
-			{
-				LOGF(LogLevel::eERROR, "Failed retrieving image level information (%u %u)!\n", image_index, level_index);
-				return false;
-			}
+	iRunImageTasks(pImageThreadSystem, iTranscodeBASISLevelTask, &job, arrayCount * mipMapCount);
 
-			if (basisTextureFormat == basist::cTFPVRTC1_4_OPAQUE_ONLY)
-			{
-				if (!isPowerOf2(level_info.m_width) || !isPowerOf2(level_info.m_height))
-				{
-					LOGF(LogLevel::eWARNING, "Warning: Will not transcode image %u level %u res %ux%u to PVRTC1 (one or more dimension is not a power of 2)\n", image_index, level_index, level_info.m_width, level_info.m_height);
+	return job.mFailed == 0;
+}
+#endif
 
-					// Can't transcode this image level to PVRTC because it's not a pow2 (we're going to support transcoding non-pow2 to the next larger pow2 soon)
-					continue;
-				}
-			}
 
-			if (!decoder.transcode_image_level(&basis_data[0], (uint32_t)basis_data.size(), image_index, level_index, pImage->GetPixels(), (uint32_t)(imageinfo.m_num_blocks_x * imageinfo.m_num_blocks_y), basisTextureFormat, 0))
-			{
-				LOGF(LogLevel::eERROR, "Failed transcoding image level (%u %u)!\n", image_index, level_index);
-				return false;
-			}
-		}
-	}
+//------------------------------------------------------------------------------
+// Sparse virtual texture files.
+// v1: width, height, mipMapCount, pageSize, componentCount followed by the page data.
+// v2: magic, version, width, height, mipMapCount, pageSize, componentCount, pageCount,
+//     uint64 page offsets[pageCount + 2] followed by the page data.
+// Pages are stored by mip level, row major within a level, and are followed by the mip tail.
+//------------------------------------------------------------------------------
+#define SVT_MAGIC MAKE_CHAR4('S', 'V', 'T', ' ')
+#define SVT_VERSION 2
 
-	return true;
+typedef struct SVTHeader
+{
+	uint32_t mVersion;
+	uint32_t mWidth;
+	uint32_t mHeight;
+	uint32_t mMipMapCount;
+	uint32_t mPageSize;
+	uint32_t mComponentCount;
+	uint32_t mPageMipCount;
+	uint32_t mPageCount;
+	// 0 for v1 files, which have no offset table
+	uint64_t mTableOffset;
+	uint64_t mDataOffset;
+} SVTHeader;
+
+// Levels larger than a page are split into pages, the remaining levels form the mip tail
+static uint32_t iGetSVTPageMipCount(uint32_t mipMapCount, uint32_t pageSize)
+{
+	uint32_t const pageMips = (uint32_t)log2f((float)pageSize);
+	return mipMapCount > pageMips ? mipMapCount - pageMips : 0;
 }
-#endif
 
+static uint32_t iGetSVTPageCount(uint32_t width, uint32_t height, uint32_t pageMipCount, uint32_t pageSize)
+{
+	uint32_t pageCount = 0;
+	for (uint32_t i = 0; i < pageMipCount; ++i)
+		pageCount += ((width >> i) / pageSize) * ((height >> i) / pageSize);
+	return pageCount;
+}
 
-bool iLoadSVTFromMemory(Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator /*= NULL*/, void* pUserData /*= NULL*/)
+static bool iReadSVTHeader(FileStream* pStream, SVTHeader* pOutHeader)
 {
-	if (memory == NULL || memSize == 0)
+	uint32_t header[8] = {};
+	if (fsReadFromStream(pStream, header, 5 * sizeof(uint32_t)) != 5 * sizeof(uint32_t))
 		return false;
 
-	eastl::vector<uint8_t> temp_data;
-	temp_data.resize(memSize);
-	memcpy(temp_data.data(), memory, memSize);
-
-	uint width;
-	memcpy(&width, &temp_data[0], sizeof(uint));
+	*pOutHeader = {};
+	if (header[0] == SVT_MAGIC)
+	{
+		if (fsReadFromStream(pStream, header + 5, 3 * sizeof(uint32_t)) != 3 * sizeof(uint32_t))
+			return false;
+		if (header[1] != SVT_VERSION)
+		{
+			LOGF(LogLevel::eERROR, "Unsupported SVT version %u", header[1]);
+			return false;
+		}
 
-	uint height;
-	memcpy(&height, &temp_data[4], sizeof(uint));
+		pOutHeader->mVersion = header[1];
+		pOutHeader->mWidth = header[2];
+		pOutHeader->mHeight = header[3];
+		pOutHeader->mMipMapCount = header[4];
+		pOutHeader->mPageSize = header[5];
+		pOutHeader->mComponentCount = header[6];
+		pOutHeader->mPageCount = header[7];
+		pOutHeader->mTableOffset = sizeof(header);
+		pOutHeader->mDataOffset = pOutHeader->mTableOffset + (pOutHeader->mPageCount + 2) * sizeof(uint64_t);
+	}
+	else
+	{
+		pOutHeader->mVersion = 1;
+		pOutHeader->mWidth = header[0];
+		pOutHeader->mHeight = header[1];
+		pOutHeader->mMipMapCount = header[2];
+		pOutHeader->mPageSize = header[3];
+		pOutHeader->mComponentCount = header[4];
+		pOutHeader->mDataOffset = 5 * sizeof(uint32_t);
+	}
 
-	uint mipMapCount;
-	memcpy(&mipMapCount, &temp_data[8], sizeof(uint));
+	if (!pOutHeader->mWidth || !pOutHeader->mHeight || !pOutHeader->mPageSize)
+		return false;
 
-	uint pageSize;
-	memcpy(&pageSize, &temp_data[12], sizeof(uint));
+	pOutHeader->mPageMipCount = iGetSVTPageMipCount(pOutHeader->mMipMapCount, pOutHeader->mPageSize);
+	uint32_t const pageCount =
+		iGetSVTPageCount(pOutHeader->mWidth, pOutHeader->mHeight, pOutHeader->mPageMipCount, pOutHeader->mPageSize);
+	if (pOutHeader->mVersion == 1)
+		pOutHeader->mPageCount = pageCount;
+	else if (pOutHeader->mPageCount != pageCount)
+		return false;
 
-	uint numberOfComponents;
-	memcpy(&numberOfComponents, &temp_data[16], sizeof(uint));
+	return true;
+}
 
-	if(numberOfComponents == 4)
-		pImage->RedefineDimensions(TinyImageFormat_R8G8B8A8_UNORM, width, height, 1, mipMapCount, 1);
-	else
-		pImage->RedefineDimensions(TinyImageFormat_R8G8B8A8_UNORM, width, height, 1, mipMapCount, 1);
+// Streams the pages and mip tail into the destination returned by pAllocator, in file order
+bool iLoadSVTFromStream(Image* pImage, FileStream* pStream, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	SVTHeader header;
+	if (!iReadSVTHeader(pStream, &header))
+		return false;
 
-	int size = pImage->GetMipMappedSize();
+	//TODO: SVT should support any components somepoint
+	pImage->RedefineDimensions(TinyImageFormat_R8G8B8A8_UNORM, header.mWidth, header.mHeight, 1, header.mMipMapCount, 1);
 
+	uint32_t const size = pImage->GetMipMappedSize();
 	if (pAllocator)
 	{
 		pImage->SetPixels((unsigned char*)pAllocator(pImage, size, pUserData));
@@ -1377,310 +1635,2572 @@ bool iLoadSVTFromMemory(Image* pImage, const char* memory, uint32_t memSize, mem
 		pImage->SetPixels((unsigned char*)conf_malloc(sizeof(unsigned char) * size), true);
 	}
 
-	memcpy(pImage->GetPixels(), &temp_data[20], sizeof(unsigned char) * size);
-	temp_data.set_capacity(0);
+	if (!pImage->GetPixels())
+		return false;
+
+	// The mip tail does not contain the last level
+	ssize_t const fileSize = fsGetStreamFileSize(pStream);
+	uint64_t const dataSize = fileSize > (ssize_t)header.mDataOffset ? min((uint64_t)size, (uint64_t)fileSize - header.mDataOffset) : 0;
+	if (!iReadSubresource(pStream, (int64_t)header.mDataOffset, pImage->GetPixels(), (size_t)dataSize))
+		return false;
+	memset(pImage->GetPixels() + dataSize, 0, size - dataSize);
 
 	return true;
 }
 
-// Image loading
-// struct of table for file format to loading function
-struct ImageLoaderDefinition
+bool iLoadSVTFromMemory(Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator /*= NULL*/, void* pUserData /*= NULL*/)
 {
-	char const* mExtension;
-	Image::ImageLoaderFunction pLoader;
-};
-
-#define MAX_IMAGE_LOADERS 10
-static ImageLoaderDefinition gImageLoaders[MAX_IMAGE_LOADERS];
-uint32_t gImageLoaderCount = 0;
+	if (memory == NULL || memSize == 0)
+		return false;
 
-// One time call to initialize all loaders
-void Image::Init()
-{
-	gImageLoaders[gImageLoaderCount++] = {"dds", iLoadDDSFromMemory};
-	gImageLoaders[gImageLoaderCount++] = {"pvr", iLoadPVRFromMemory};
-#ifndef IMAGE_DISABLE_KTX
-	gImageLoaders[gImageLoaderCount++] = {"ktx", iLoadKTXFromMemory};
-#endif
-#if defined(ORBIS)
-	gImageLoaders[gImageLoaderCount++] = {"gnf", iLoadGNFFromMemory};
-#endif
-#ifndef IMAGE_DISABLE_GOOGLE_BASIS
-	gImageLoaders[gImageLoaderCount++] = {"basis", iLoadBASISFromMemory};
-#endif
-	gImageLoaders[gImageLoaderCount++] = {"svt", iLoadSVTFromMemory};
+	FileStream* fh = fsOpenReadOnlyMemory(memory, memSize);
+	bool loaded = iLoadSVTFromStream(pImage, fh, pAllocator, pUserData);
+	fsCloseStream(fh);
+	return loaded;
 }
 
-void Image::Exit()
+bool Image::OpenSVT(FileStream* pStream, SVTPageReader** ppOutReader)
 {
-}
+	ASSERT(pStream);
+	ASSERT(ppOutReader);
 
-void Image::AddImageLoader(const char* pExtension, ImageLoaderFunction pFunc) {
-	gImageLoaders[gImageLoaderCount++] = { pExtension, pFunc };
-}
+	SVTHeader header;
+	if (!iReadSVTHeader(pStream, &header))
+	{
+		fsCloseStream(pStream);
+		return false;
+	}
 
-bool Image::LoadFromMemory(
-	void const* mem, uint32_t size, char const* extension, memoryAllocationFunc pAllocator, void* pUserData)
-{
-	// try loading the format
-	bool loaded = false;
-	for (uint32_t i = 0; i < gImageLoaderCount; ++i)
+	SVTPageReader* pReader = (SVTPageReader*)conf_calloc(1, sizeof(SVTPageReader));
+	pReader->pStream = pStream;
+	pReader->mWidth = header.mWidth;
+	pReader->mHeight = header.mHeight;
+	pReader->mMipMapCount = header.mMipMapCount;
+	pReader->mPageSize = header.mPageSize;
+	pReader->mComponentCount = header.mComponentCount;
+	pReader->mPageMipCount = header.mPageMipCount;
+	pReader->mPageCount = header.mPageCount;
+	pReader->pPageOffsets = (uint64_t*)conf_malloc(sizeof(uint64_t) * (header.mPageCount + 2));
+	pReader->mStreamMutex.Init();
+
+	ssize_t const fileSize = fsGetStreamFileSize(pStream);
+	if (header.mTableOffset)
 	{
-		ImageLoaderDefinition const& def = gImageLoaders[i];
-		if (stricmp(extension, def.mExtension) == 0)
+		size_t const tableSize = sizeof(uint64_t) * (header.mPageCount + 2);
+		if (!iReadSubresource(pStream, (int64_t)header.mTableOffset, pReader->pPageOffsets, tableSize))
 		{
-			loaded = def.pLoader(this, (char const*)mem, size, pAllocator, pUserData);
-			break;
+			CloseSVT(pReader);
+			return false;
 		}
 	}
-	return loaded;
+	else
+	{
+		// v1 pages all have the same size
+		uint64_t const pageBytes = (uint64_t)header.mPageSize * header.mPageSize * header.mComponentCount;
+		for (uint32_t i = 0; i <= header.mPageCount; ++i)
+			pReader->pPageOffsets[i] = header.mDataOffset + i * pageBytes;
+		pReader->pPageOffsets[header.mPageCount + 1] = (uint64_t)fileSize;
+	}
+
+	if (pReader->pPageOffsets[header.mPageCount + 1] > (uint64_t)fileSize)
+	{
+		LOGF(LogLevel::eERROR, "SVT page table points past the end of the file");
+		CloseSVT(pReader);
+		return false;
+	}
+
+	*ppOutReader = pReader;
+	return true;
 }
 
-bool Image::LoadFromFile(const Path* filePath, memoryAllocationFunc pAllocator, void* pUserData)
+void Image::CloseSVT(SVTPageReader* pReader)
 {
-	// clear current image
-	Clear();
+	if (!pReader)
+		return;
 
-  PathComponent extensionComponent = fsGetPathExtension(filePath);
-	uint32_t loaderIndex = -1;
+	fsCloseStream(pReader->pStream);
+	pReader->mStreamMutex.Destroy();
+	conf_free(pReader->pPageOffsets);
+	conf_free(pReader);
+}
 
-	if (extensionComponent.length != 0) // the string's not empty
+uint32_t Image::GetSVTPageIndex(const SVTPageReader* pReader, uint32_t mipMapLevel, uint32_t x, uint32_t y)
+{
+	if (mipMapLevel >= pReader->mPageMipCount)
+		return UINT32_MAX;
+
+	uint32_t const pagesX = (pReader->mWidth >> mipMapLevel) / pReader->mPageSize;
+	uint32_t const pagesY = (pReader->mHeight >> mipMapLevel) / pReader->mPageSize;
+	if (x >= pagesX || y >= pagesY)
+		return UINT32_MAX;
+
+	return iGetSVTPageCount(pReader->mWidth, pReader->mHeight, mipMapLevel, pReader->mPageSize) + y * pagesX + x;
+}
+
+bool Image::ReadSVTPage(SVTPageReader* pReader, uint32_t pageIndex, void* pDst, uint64_t dstSize)
+{
+	if (pageIndex > pReader->mPageCount)
+		return false;
+
+	uint64_t const offset = pReader->pPageOffsets[pageIndex];
+	uint64_t const size = min(dstSize, pReader->pPageOffsets[pageIndex + 1] - offset);
+
+	MutexLock lock(pReader->mStreamMutex);
+	return iReadSubresource(pReader->pStream, (int64_t)offset, pDst, (size_t)size);
+}
+
+//------------------------------------------------------------------------------
+// Header probes: fill ImageProbeInfo reading only the file header.
+//------------------------------------------------------------------------------
+bool iProbeDDS(FileStream* pStream, ImageProbeInfo* pOutInfo)
+{
+	TinyDDS_Callbacks callbacks {
+			&tinyktxddsCallbackError,
+			&tinyktxddsCallbackAlloc,
+			&tinyktxddsCallbackFree,
+			&tinyktxddsCallbackRead,
+			&tinyktxddsCallbackSeek,
+			&tinyktxddsCallbackTell
+	};
+
+	TinyDDS_ContextHandle ctx = TinyDDS_CreateContext(&callbacks, (void*)pStream);
+	if (!TinyDDS_ReadHeader(ctx))
+	{
+		TinyDDS_DestroyContext(ctx);
+		return false;
+	}
+
+	uint32_t d = TinyDDS_Depth(ctx);
+	uint32_t s = TinyDDS_ArraySlices(ctx);
+	pOutInfo->mWidth = TinyDDS_Width(ctx);
+	pOutInfo->mHeight = TinyDDS_Height(ctx);
+	pOutInfo->mDepth = d ? d : 1;
+	pOutInfo->mMipMapCount = TinyDDS_NumberOfMipmaps(ctx);
+	pOutInfo->mArrayCount = s ? s : 1;
+	pOutInfo->mIsCube = TinyDDS_IsCubemap(ctx);
+	pOutInfo->mFormat = TinyImageFormat_FromTinyDDSFormat(TinyDDS_GetFormat(ctx));
+
+	TinyDDS_DestroyContext(ctx);
+	return pOutInfo->mFormat != TinyImageFormat_UNDEFINED;
+}
+
+#ifndef IMAGE_DISABLE_KTX
+bool iProbeKTX(FileStream* pStream, ImageProbeInfo* pOutInfo)
+{
+	TinyKtx_Callbacks callbacks {
+			&tinyktxddsCallbackError,
+			&tinyktxddsCallbackAlloc,
+			&tinyktxddsCallbackFree,
+			&tinyktxddsCallbackRead,
+			&tinyktxddsCallbackSeek,
+			&tinyktxddsCallbackTell
+	};
+
+	TinyKtx_ContextHandle ctx = TinyKtx_CreateContext(&callbacks, (void*)pStream);
+	if (!TinyKtx_ReadHeader(ctx))
+	{
+		TinyKtx_DestroyContext(ctx);
+		return false;
+	}
+
+	uint32_t d = TinyKtx_Depth(ctx);
+	uint32_t s = TinyKtx_ArraySlices(ctx);
+	pOutInfo->mWidth = TinyKtx_Width(ctx);
+	pOutInfo->mHeight = TinyKtx_Height(ctx);
+	pOutInfo->mDepth = d ? d : 1;
+	pOutInfo->mMipMapCount = TinyKtx_NumberOfMipmaps(ctx);
+	pOutInfo->mArrayCount = s ? s : 1;
+	pOutInfo->mIsCube = TinyKtx_IsCubemap(ctx);
+	pOutInfo->mFormat = TinyImageFormat_FromTinyKtxFormat(TinyKtx_GetFormat(ctx));
+
+	TinyKtx_DestroyContext(ctx);
+	return pOutInfo->mFormat != TinyImageFormat_UNDEFINED;
+}
+#endif
+
+bool iProbePVR(FileStream* pStream, ImageProbeInfo* pOutInfo)
+{
+	PVR_Texture_Header header;
+	if (fsReadFromStream(pStream, &header, sizeof(header)) != sizeof(header))
+		return false;
+
+	if (header.mVersion != gPvrtexV3HeaderVersion || header.mPixelFormat > 3)
+		return false;
+
+	bool const srgb = (header.mColorSpace == 1);
+	bool const isCube = header.mNumFaces > 1;
+	pOutInfo->mWidth = header.mWidth;
+	pOutInfo->mHeight = header.mHeight;
+	pOutInfo->mDepth = isCube ? 1 : header.mDepth;
+	pOutInfo->mMipMapCount = header.mNumMipMaps;
+	pOutInfo->mArrayCount = isCube ? header.mNumSurfaces : header.mNumSurfaces * header.mNumFaces;
+	pOutInfo->mIsCube = isCube;
+	if (header.mPixelFormat < 2)
+		pOutInfo->mFormat = srgb ? TinyImageFormat_PVRTC1_2BPP_SRGB : TinyImageFormat_PVRTC1_2BPP_UNORM;
+	else
+		pOutInfo->mFormat = srgb ? TinyImageFormat_PVRTC1_4BPP_SRGB : TinyImageFormat_PVRTC1_4BPP_UNORM;
+
+	return true;
+}
+
+#ifndef IMAGE_DISABLE_GOOGLE_BASIS
+bool iProbeBASIS(FileStream* pStream, ImageProbeInfo* pOutInfo)
+{
+	basist::basis_file_header header;
+	if (fsReadFromStream(pStream, &header, sizeof(header)) != sizeof(header))
+		return false;
+
+	if (header.m_sig != basist::basis_file_header::cBASISSigValue || header.m_total_images == 0 || header.m_total_slices == 0)
+		return false;
+
+	// The slice table only holds a few bytes per level, read it to count the mips of the first image
+	uint32_t const sliceCount = header.m_total_slices;
+	basist::basis_slice_desc* pSlices = (basist::basis_slice_desc*)conf_malloc(sliceCount * sizeof(basist::basis_slice_desc));
+	bool success = fsSeekStream(pStream, SBO_START_OF_FILE, header.m_slice_desc_file_ofs) &&
+				   fsReadFromStream(pStream, pSlices, sliceCount * sizeof(basist::basis_slice_desc)) == sliceCount * sizeof(basist::basis_slice_desc);
+
+	if (success)
+	{
+		uint32_t mipMapCount = 0;
+		for (uint32_t i = 0; i < sliceCount; ++i)
+		{
+			if (pSlices[i].m_image_index == 0 && !(pSlices[i].m_flags & basist::cSliceDescFlagsIsAlphaData))
+				++mipMapCount;
+		}
+
+		basist::transcoder_texture_format basisTextureFormat;
+		TinyImageFormat                   decodeFormat;
+		pOutInfo->mWidth = pSlices[0].m_orig_width;
+		pOutInfo->mHeight = pSlices[0].m_orig_height;
+		pOutInfo->mDepth = 1;
+		pOutInfo->mMipMapCount = max(1U, mipMapCount);
+		pOutInfo->mArrayCount = header.m_total_images;
+		pOutInfo->mIsCube = false;
+		pOutInfo->mFormat = iGetBASISTargetFormat(
+			header.m_userdata0 == 1, (header.m_flags & basist::cBASISHeaderFlagHasAlphaSlices) != 0,
+			isPowerOf2(pOutInfo->mWidth) && isPowerOf2(pOutInfo->mHeight), &basisTextureFormat, &decodeFormat);
+	}
+
+	conf_free(pSlices);
+	return success;
+}
+#endif
+
+bool iProbeSVT(FileStream* pStream, ImageProbeInfo* pOutInfo)
+{
+	SVTHeader header;
+	if (!iReadSVTHeader(pStream, &header))
+		return false;
+
+	pOutInfo->mWidth = header.mWidth;
+	pOutInfo->mHeight = header.mHeight;
+	pOutInfo->mDepth = 1;
+	pOutInfo->mMipMapCount = header.mMipMapCount;
+	pOutInfo->mArrayCount = 1;
+	pOutInfo->mIsCube = false;
+	pOutInfo->mFormat = TinyImageFormat_R8G8B8A8_UNORM;
+	return true;
+}
+
+#ifndef IMAGE_DISABLE_STB
+//------------------------------------------------------------------------------
+// Source image formats decoded with stb_image. RGB is expanded to RGBA, 16 bit PNGs keep
+// their precision and HDR files decode to float.
+//------------------------------------------------------------------------------
+static int iSTBRead(void* pUser, char* pData, int size) { return (int)fsReadFromStream((FileStream*)pUser, pData, (size_t)size); }
+static void iSTBSkip(void* pUser, int n) { fsSeekStream((FileStream*)pUser, SBO_CURRENT_POSITION, n); }
+static int iSTBEof(void* pUser) { return fsStreamAtEnd((FileStream*)pUser) ? 1 : 0; }
+
+static const stbi_io_callbacks gSTBCallbacks = { iSTBRead, iSTBSkip, iSTBEof };
+
+static TinyImageFormat iGetSTBFormat(int channelCount, bool is16Bit, bool isHDR)
+{
+	static const TinyImageFormat formats8[4] = { TinyImageFormat_R8_UNORM, TinyImageFormat_R8G8_UNORM, TinyImageFormat_R8G8B8A8_UNORM,
+												 TinyImageFormat_R8G8B8A8_UNORM };
+	static const TinyImageFormat formats16[4] = { TinyImageFormat_R16_UNORM, TinyImageFormat_R16G16_UNORM,
+												  TinyImageFormat_R16G16B16A16_UNORM, TinyImageFormat_R16G16B16A16_UNORM };
+	static const TinyImageFormat formats32[4] = { TinyImageFormat_R32_SFLOAT, TinyImageFormat_R32G32_SFLOAT,
+												  TinyImageFormat_R32G32B32A32_SFLOAT, TinyImageFormat_R32G32B32A32_SFLOAT };
+	if (channelCount < 1 || channelCount > 4)
+		return TinyImageFormat_UNDEFINED;
+	return isHDR ? formats32[channelCount - 1] : is16Bit ? formats16[channelCount - 1] : formats8[channelCount - 1];
+}
+
+// This stb_image version has no 16 bit query, read the bit depth from the PNG IHDR chunk instead
+#define STB_PNG_HEADER_SIZE 25
+static bool iIsPNG16Bit(const uint8_t* pHeader, uint32_t size)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	return size >= STB_PNG_HEADER_SIZE && memcmp(pHeader, signature, sizeof(signature)) == 0 && memcmp(pHeader + 12, "IHDR", 4) == 0 &&
+		   pHeader[24] == 16;
+}
+
+static bool iIsPNG16Bit(FileStream* pStream)
+{
+	uint8_t      header[STB_PNG_HEADER_SIZE];
+	size_t const readSize = fsReadFromStream(pStream, header, sizeof(header));
+	return iIsPNG16Bit(header, (uint32_t)readSize);
+}
+
+// Takes ownership of pPixels, which stb_image allocated with conf_malloc
+static bool iSetSTBPixels(
+	Image* pImage, void* pPixels, int width, int height, int channelCount, bool is16Bit, bool isHDR, memoryAllocationFunc pAllocator,
+	void* pUserData)
+{
+	if (!pPixels)
+	{
+		LOGF(LogLevel::eERROR, "stb_image failed to decode the image: %s", stbi_failure_reason());
+		return false;
+	}
+
+	TinyImageFormat const fmt = iGetSTBFormat(channelCount, is16Bit, isHDR);
+	pImage->RedefineDimensions(fmt, width, height, 1, 1, 1);
+	pImage->SetMipsAfterSlices(false);
+
+	if (pAllocator)
+	{
+		uint64_t const size = pImage->GetMipMappedSize(0, 1);
+		void*          pDst = pAllocator(pImage, size, pUserData);
+		if (!pDst)
+		{
+			stbi_image_free(pPixels);
+			return false;
+		}
+		memcpy(pDst, pPixels, size);
+		stbi_image_free(pPixels);
+		pImage->SetPixels((unsigned char*)pDst);
+	}
+	else
+	{
+		pImage->SetPixels((unsigned char*)pPixels, true);
+	}
+	return true;
+}
+
+bool iLoadSTBFromMemory(Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	if (memory == NULL || memSize == 0)
+		return false;
+
+	const stbi_uc* pMemory = (const stbi_uc*)memory;
+	int            width = 0, height = 0, channelCount = 0;
+	if (!stbi_info_from_memory(pMemory, (int)memSize, &width, &height, &channelCount))
+		return false;
+
+	int const  requiredCount = channelCount == 3 ? 4 : channelCount;
+	bool const isHDR = stbi_is_hdr_from_memory(pMemory, (int)memSize) != 0;
+	bool const is16Bit = !isHDR && iIsPNG16Bit(pMemory, memSize);
+
+	void* pPixels = NULL;
+	if (isHDR)
+		pPixels = stbi_loadf_from_memory(pMemory, (int)memSize, &width, &height, &channelCount, requiredCount);
+	else if (is16Bit)
+		pPixels = stbi_load_16_from_memory(pMemory, (int)memSize, &width, &height, &channelCount, requiredCount);
+	else
+		pPixels = stbi_load_from_memory(pMemory, (int)memSize, &width, &height, &channelCount, requiredCount);
+
+	return iSetSTBPixels(pImage, pPixels, width, height, requiredCount, is16Bit, isHDR, pAllocator, pUserData);
+}
+
+bool iLoadSTBFromStream(Image* pImage, FileStream* pStream, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	// every query consumes the start of the stream
+	int width = 0, height = 0, channelCount = 0;
+	if (!stbi_info_from_callbacks(&gSTBCallbacks, pStream, &width, &height, &channelCount))
+		return false;
+	fsSeekStream(pStream, SBO_START_OF_FILE, 0);
+	bool const isHDR = stbi_is_hdr_from_callbacks(&gSTBCallbacks, pStream) != 0;
+	fsSeekStream(pStream, SBO_START_OF_FILE, 0);
+	bool const is16Bit = !isHDR && iIsPNG16Bit(pStream);
+	fsSeekStream(pStream, SBO_START_OF_FILE, 0);
+
+	int const requiredCount = channelCount == 3 ? 4 : channelCount;
+	void*     pPixels = NULL;
+	if (isHDR)
+		pPixels = stbi_loadf_from_callbacks(&gSTBCallbacks, pStream, &width, &height, &channelCount, requiredCount);
+	else if (is16Bit)
+		pPixels = stbi_load_16_from_callbacks(&gSTBCallbacks, pStream, &width, &height, &channelCount, requiredCount);
+	else
+		pPixels = stbi_load_from_callbacks(&gSTBCallbacks, pStream, &width, &height, &channelCount, requiredCount);
+
+	return iSetSTBPixels(pImage, pPixels, width, height, requiredCount, is16Bit, isHDR, pAllocator, pUserData);
+}
+
+//------------------------------------------------------------------------------
+// Image cache: decoded source images stored as DDS, named after a hash of the file contents
+//------------------------------------------------------------------------------
+// Bump when the decoded or compressed output changes so stale entries are no longer found
+#define IMAGE_CACHE_VERSION 2
+
+static Path*         pImageCacheDirectory = NULL;
+static bool          gImageCacheCompress = false;
+static ThreadSystem* pImageCacheThreadSystem = NULL;
+static tfrg_atomic64_t gImageCacheWriteCounter = 0;
+
+// 64 bit content hash, 8 bytes per step
+static uint64_t iHashImageData(const void* pData, uint64_t size, uint64_t seed)
+{
+	const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint8_t* p = (const uint8_t*)pData;
+	uint64_t       h = seed ^ (size * prime1);
+	for (; size >= 8; size -= 8, p += 8)
+	{
+		uint64_t k;
+		memcpy(&k, p, sizeof(k));
+		k *= prime2;
+		k = ((k << 31) | (k >> 33)) * prime1;
+		h ^= k;
+		h = ((h << 27) | (h >> 37)) * prime1 + 0x85EBCA77C2B2AE63ULL;
+	}
+	for (; size > 0; --size, ++p)
+	{
+		h ^= *p * 0x27D4EB2F165667C5ULL;
+		h = ((h << 11) | (h >> 53)) * prime1;
+	}
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= 0x165667B19E3779F9ULL;
+	h ^= h >> 32;
+	return h;
+}
+
+static bool iCanEncodeBlockFormat(TinyImageFormat fmt);
+
+// Format a decoded source image is cached as, and loaded as. The probe reports it from the file header,
+// so it is only a block format that Convert can produce. fileChannelCount is the channel count stored in the file
+static TinyImageFormat iGetImageCacheFormat(TinyImageFormat fmt, int fileChannelCount, uint32_t width, uint32_t height)
+{
+	// BC textures need a top level that is a multiple of the block size
+	if (!pImageCacheDirectory || !gImageCacheCompress || (width & 3) || (height & 3))
+		return fmt;
+
+	TinyImageFormat cachedFormat = fmt;
+	switch (fmt)
+	{
+		case TinyImageFormat_R8_UNORM: cachedFormat = TinyImageFormat_DXBC4_UNORM; break;
+		case TinyImageFormat_R8G8_UNORM: cachedFormat = TinyImageFormat_DXBC5_UNORM; break;
+		// DDS does not tell BC1 RGB and RGBA apart, opaque blocks decode the same either way
+		case TinyImageFormat_R8G8B8A8_UNORM:
+			cachedFormat = fileChannelCount == 4 ? TinyImageFormat_DXBC3_UNORM : TinyImageFormat_DXBC1_RGBA_UNORM;
+			break;
+		default: break;
+	}
+	return iCanEncodeBlockFormat(cachedFormat) && TinyImageFormat_CanDecodeLogicalPixelsF(fmt) ? cachedFormat : fmt;
+}
+
+void Image::SetImageCache(const ImageCacheDesc* pDesc)
+{
+	fsFreePath(pImageCacheDirectory);
+	pImageCacheDirectory = NULL;
+	gImageCacheCompress = false;
+	pImageCacheThreadSystem = NULL;
+	if (!pDesc || !pDesc->pDirectory)
+		return;
+
+	if (!fsDirectoryExists(pDesc->pDirectory) && !fsCreateDirectory(pDesc->pDirectory))
+	{
+		LOGF(LogLevel::eWARNING, "\"%s\": Can't create the image cache directory, the cache is disabled.", fsGetPathAsNativeString(pDesc->pDirectory));
+		return;
+	}
+
+	pImageCacheDirectory = fsCopyPath(pDesc->pDirectory);
+	gImageCacheCompress = pDesc->mCompress;
+	pImageCacheThreadSystem = pDesc->pThreadSystem;
+}
+
+bool Image::LoadCachedImage(const char* data, uint32_t size, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	char fileName[32];
+	snprintf(
+		fileName, sizeof(fileName), "%016llx.dds",
+		(unsigned long long)iHashImageData(data, size, IMAGE_CACHE_VERSION | (gImageCacheCompress ? 0x100 : 0)));
+	PathHandle cachePath = fsAppendPathComponent(pImageCacheDirectory, fileName);
+
+	FileStream* pCached = fsOpenFile(cachePath, FM_READ_BINARY);
+	if (pCached)
+	{
+		bool const loaded = iLoadDDSFromStream(this, pCached, pAllocator, pUserData);
+		fsCloseStream(pCached);
+		if (loaded)
+			return true;
+		LOGF(LogLevel::eWARNING, "\"%s\": Unreadable image cache entry, decoding the source again.", fsGetPathAsNativeString(cachePath));
+	}
+
+	int width = 0, height = 0, fileChannelCount = 0;
+	if (!stbi_info_from_memory((const stbi_uc*)data, (int)size, &width, &height, &fileChannelCount))
+		return false;
+
+	// decode into memory owned by the image so it can be compressed before it is handed over
+	if (!iLoadSTBFromMemory(this, data, size, NULL, NULL))
+		return false;
+
+	// The probe already reported the cached format, an image in any other one would not match it
+	TinyImageFormat const cachedFormat = iGetImageCacheFormat(mFormat, fileChannelCount, mWidth, mHeight);
+	if (cachedFormat != mFormat && !Convert(cachedFormat, pImageCacheThreadSystem))
+	{
+		LOGF(LogLevel::eERROR, "Failed to compress image for the image cache.");
+		return false;
+	}
+
+	// Written under a temporary name and renamed into place, so parallel loads of the same image never read
+	// a partial entry and a crash mid write doesn't leave a truncated one behind
+	char tempFileName[64];
+	snprintf(
+		tempFileName, sizeof(tempFileName), "%s.%llx-%llx.tmp", fileName, (unsigned long long)getUSec(),
+		(unsigned long long)tfrg_atomic64_add_relaxed(&gImageCacheWriteCounter, 1));
+	PathHandle tempPath = fsAppendPathComponent(pImageCacheDirectory, tempFileName);
+	if (!iSaveDDS(tempPath) || !fsRenameFile(tempPath, cachePath))
+	{
+		LOGF(LogLevel::eWARNING, "\"%s\": Failed to write image cache entry.", fsGetPathAsNativeString(cachePath));
+		fsDeleteFile(tempPath);
+	}
+
+	if (pAllocator)
+	{
+		uint64_t const imageSize = GetMipMappedSize(0, mMipMapCount);
+		void*          pDst = pAllocator(this, imageSize, pUserData);
+		if (!pDst)
+			return false;
+		memcpy(pDst, pData, imageSize);
+		conf_free(pData);
+		SetPixels((unsigned char*)pDst);
+	}
+	return true;
+}
+
+bool iProbeSTB(FileStream* pStream, ImageProbeInfo* pOutInfo)
+{
+	int width = 0, height = 0, channelCount = 0;
+	if (!stbi_info_from_callbacks(&gSTBCallbacks, pStream, &width, &height, &channelCount))
+		return false;
+	fsSeekStream(pStream, SBO_START_OF_FILE, 0);
+	bool const isHDR = stbi_is_hdr_from_callbacks(&gSTBCallbacks, pStream) != 0;
+	fsSeekStream(pStream, SBO_START_OF_FILE, 0);
+	bool const is16Bit = !isHDR && iIsPNG16Bit(pStream);
+
+	pOutInfo->mWidth = (uint32_t)width;
+	pOutInfo->mHeight = (uint32_t)height;
+	pOutInfo->mDepth = 1;
+	pOutInfo->mMipMapCount = 1;
+	pOutInfo->mArrayCount = 1;
+	pOutInfo->mIsCube = false;
+	pOutInfo->mFormat = iGetImageCacheFormat(
+		iGetSTBFormat(channelCount == 3 ? 4 : channelCount, is16Bit, isHDR), channelCount, pOutInfo->mWidth, pOutInfo->mHeight);
+	return true;
+}
+#else
+void Image::SetImageCache(const ImageCacheDesc* pDesc)
+{
+	UNREF_PARAM(pDesc);
+	LOGF(LogLevel::eWARNING, "The image cache needs stb_image, it is disabled.");
+}
+#endif
+
+// Image loading
+// Loaders are found through a hash map keyed by extension, and by the signature at the start of the file
+// so files with a missing or wrong extension still load.
+#define IMAGE_EXTENSION_MAX_LENGTH 16
+// mMagicOffset + mMagicSize of a signature can't exceed this
+#define IMAGE_MAGIC_MAX_SIZE 32
+#define IMAGE_MAX_LOADER_CANDIDATES 8
+
+struct ImageLoaderDefinition
+{
+	// lower case
+	char                             mExtension[IMAGE_EXTENSION_MAX_LENGTH];
+	Image::ImageLoaderFunction       pLoader;
+	Image::ImageProbeFunction        pProbe;
+	Image::ImageStreamLoaderFunction pStreamLoader;
+	uint8_t                          mMagic[IMAGE_MAGIC_MAX_SIZE];
+	uint32_t                         mMagicSize;
+	uint32_t                         mMagicOffset;
+	// previously registered loader with the same extension hash, UINT32_MAX ends the list
+	uint32_t                         mNextWithExtension;
+};
+
+static eastl::vector<ImageLoaderDefinition>     gImageLoaders;
+// extension hash -> most recently registered loader
+static eastl::unordered_map<uint32_t, uint32_t> gImageLoaderExtensions;
+// loaders with a signature, most recently registered first
+static eastl::vector<uint32_t>                  gImageMagicLoaders;
+// header bytes needed to test every signature
+static uint32_t                                 gImageMagicReadSize = 0;
+
+static bool iGetImageExtensionKey(const char* extension, char* pOutKey)
+{
+	uint32_t i = 0;
+	for (; extension[i]; ++i)
+	{
+		if (i + 1 >= IMAGE_EXTENSION_MAX_LENGTH)
+			return false;
+		pOutKey[i] = (char)tolower(extension[i]);
+	}
+	pOutKey[i] = '\0';
+	return true;
+}
+
+static uint32_t iHashImageExtension(const char* key)
+{
+	uint32_t hash = 2166136261u;
+	for (; *key; ++key)
+		hash = (hash ^ (uint8_t)*key) * 16777619u;
+	return hash;
+}
+
+// Walks the loaders registered for key starting at index, skipping hash collisions
+static uint32_t iNextImageLoader(uint32_t index, const char* key)
+{
+	while (index != UINT32_MAX && strcmp(gImageLoaders[index].mExtension, key) != 0)
+		index = gImageLoaders[index].mNextWithExtension;
+	return index;
+}
+
+static uint32_t iFindImageLoader(const char* key)
+{
+	eastl::unordered_map<uint32_t, uint32_t>::const_iterator it = gImageLoaderExtensions.find(iHashImageExtension(key));
+	return it != gImageLoaderExtensions.end() ? iNextImageLoader(it->second, key) : UINT32_MAX;
+}
+
+static uint32_t iSniffImageLoader(const uint8_t* pHeader, uint32_t headerSize)
+{
+	for (uint32_t i = 0; i < (uint32_t)gImageMagicLoaders.size(); ++i)
+	{
+		ImageLoaderDefinition const& def = gImageLoaders[gImageMagicLoaders[i]];
+		if (def.mMagicOffset + def.mMagicSize <= headerSize &&
+			memcmp(pHeader + def.mMagicOffset, def.mMagic + def.mMagicOffset, def.mMagicSize) == 0)
+			return gImageMagicLoaders[i];
+	}
+	return UINT32_MAX;
+}
+
+// Appends the loaders registered for key, newest first, that aren't candidates yet
+static uint32_t iAddImageLoaderCandidates(const char* key, uint32_t* pCandidates, uint32_t count)
+{
+	for (uint32_t i = iFindImageLoader(key); i != UINT32_MAX && count < IMAGE_MAX_LOADER_CANDIDATES;
+		 i = iNextImageLoader(gImageLoaders[i].mNextWithExtension, key))
+	{
+		if (eastl::find(pCandidates, pCandidates + count, i) == pCandidates + count)
+			pCandidates[count++] = i;
+	}
+	return count;
+}
+
+// Loaders to try in order: the ones registered for the extension of the header signature, then the ones registered
+// for extension. The signature only picks the format, so a loader registered later for it without a signature is still
+// tried before the built-in one. extension can be NULL. Returns the candidate count
+static uint32_t iGetImageLoaderCandidates(const char* extension, const uint8_t* pHeader, uint32_t headerSize, uint32_t* pOutCandidates)
+{
+	uint32_t       count = 0;
+	uint32_t const sniffed = iSniffImageLoader(pHeader, headerSize);
+	if (sniffed != UINT32_MAX)
+		count = iAddImageLoaderCandidates(gImageLoaders[sniffed].mExtension, pOutCandidates, count);
+
+	char key[IMAGE_EXTENSION_MAX_LENGTH];
+	if (extension && iGetImageExtensionKey(extension, key))
+		count = iAddImageLoaderCandidates(key, pOutCandidates, count);
+	return count;
+}
+
+// File signatures of the built-in loaders
+static const uint8_t ddsMagic[] = { 'D', 'D', 'S', ' ' };
+static const uint8_t pvrMagic[] = { 'P', 'V', 'R', 3 };
+static const uint8_t ktxMagic[] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const uint8_t basisMagic[] = { 's', 'B' };
+static const uint8_t svtMagic[] = { 'S', 'V', 'T', ' ' };
+static const uint8_t pngMagic[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+static const uint8_t jpgMagic[] = { 0xFF, 0xD8, 0xFF };
+static const uint8_t bmpMagic[] = { 'B', 'M' };
+// both #?RADIANCE and #?RGBE
+static const uint8_t hdrMagic[] = { '#', '?' };
+
+// One time call to initialize all loaders
+void Image::Init(const bool* pCanShaderReadFrom, ThreadSystem* pThreadSystem)
+{
+	gHasSampleableFormats = pCanShaderReadFrom != NULL;
+	if (pCanShaderReadFrom)
+		memcpy(gSampleableFormats, pCanShaderReadFrom, sizeof(gSampleableFormats));
+	pImageThreadSystem = pThreadSystem;
+
+	bool const firstInit = gImageInitCount++ == 0;
+#ifndef IMAGE_DISABLE_GOOGLE_BASIS
+	if (firstInit)
+	{
+		basist::basisu_transcoder_init();
+		pBasisCodebook = conf_new(basist::etc1_global_selector_codebook, basist::g_global_selector_cb_size, basist::g_global_selector_cb);
+	}
+#endif
+
+	static const ImageLoaderDesc builtInLoaders[] = {
+		{ "dds", iLoadDDSFromMemory, iProbeDDS, iLoadDDSFromStream, ddsMagic, sizeof(ddsMagic), 0 },
+		{ "pvr", iLoadPVRFromMemory, iProbePVR, NULL, pvrMagic, sizeof(pvrMagic), 0 },
+#ifndef IMAGE_DISABLE_KTX
+		{ "ktx", iLoadKTXFromMemory, iProbeKTX, iLoadKTXFromStream, ktxMagic, sizeof(ktxMagic), 0 },
+#endif
+#if defined(ORBIS)
+		{ "gnf", iLoadGNFFromMemory, NULL, NULL, NULL, 0, 0 },
+#endif
+#ifndef IMAGE_DISABLE_GOOGLE_BASIS
+		{ "basis", iLoadBASISFromMemory, iProbeBASIS, NULL, basisMagic, sizeof(basisMagic), 0 },
+#endif
+		{ "svt", iLoadSVTFromMemory, iProbeSVT, iLoadSVTFromStream, svtMagic, sizeof(svtMagic), 0 },
+#ifndef IMAGE_DISABLE_STB
+		{ "png", iLoadSTBFromMemory, iProbeSTB, iLoadSTBFromStream, pngMagic, sizeof(pngMagic), 0 },
+		{ "jpg", iLoadSTBFromMemory, iProbeSTB, iLoadSTBFromStream, jpgMagic, sizeof(jpgMagic), 0 },
+		{ "jpeg", iLoadSTBFromMemory, iProbeSTB, iLoadSTBFromStream, NULL, 0, 0 },
+		{ "bmp", iLoadSTBFromMemory, iProbeSTB, iLoadSTBFromStream, bmpMagic, sizeof(bmpMagic), 0 },
+		{ "hdr", iLoadSTBFromMemory, iProbeSTB, iLoadSTBFromStream, hdrMagic, sizeof(hdrMagic), 0 },
+		// TGA has no signature
+		{ "tga", iLoadSTBFromMemory, iProbeSTB, iLoadSTBFromStream, NULL, 0, 0 },
+#endif
+	};
+	// Registering again would only add duplicates, a nested Init keeps the registry and any replaced loaders
+	if (!firstInit)
+		return;
+	for (uint32_t i = 0; i < sizeof(builtInLoaders) / sizeof(builtInLoaders[0]); ++i)
+		AddImageLoader(&builtInLoaders[i]);
+}
+
+void Image::Exit()
+{
+	ASSERT(gImageInitCount);
+	if (--gImageInitCount)
+		return;
+
+#ifndef IMAGE_DISABLE_GOOGLE_BASIS
+	conf_delete(pBasisCodebook);
+	pBasisCodebook = NULL;
+#endif
+	pImageThreadSystem = NULL;
+	gHasSampleableFormats = false;
+	gImageLoaders.set_capacity(0);
+	gImageLoaderExtensions.clear(true);
+	gImageMagicLoaders.set_capacity(0);
+	gImageMagicReadSize = 0;
+#ifndef IMAGE_DISABLE_STB
+	SetImageCache(NULL);
+#endif
+}
+
+void Image::AddImageLoader(const ImageLoaderDesc* pDesc)
+{
+	ASSERT(pDesc && pDesc->pExtension && pDesc->pLoader);
+
+	ImageLoaderDefinition def = {};
+	if (!iGetImageExtensionKey(pDesc->pExtension, def.mExtension))
+	{
+		LOGF(LogLevel::eERROR, "Image loader extension \"%s\" is too long.", pDesc->pExtension);
+		return;
+	}
+	if (pDesc->mMagicOffset + pDesc->mMagicSize > IMAGE_MAGIC_MAX_SIZE)
+	{
+		LOGF(LogLevel::eERROR, "Image loader \"%s\": the signature has to be within the first %u bytes.", pDesc->pExtension, IMAGE_MAGIC_MAX_SIZE);
+		return;
+	}
+
+	def.pLoader = pDesc->pLoader;
+	def.pProbe = pDesc->pProbe;
+	def.pStreamLoader = pDesc->pStreamLoader;
+	def.mMagicSize = pDesc->pMagic ? pDesc->mMagicSize : 0;
+	def.mMagicOffset = pDesc->mMagicOffset;
+	if (def.mMagicSize)
+		memcpy(def.mMagic + def.mMagicOffset, pDesc->pMagic, def.mMagicSize);
+
+	uint32_t const index = (uint32_t)gImageLoaders.size();
+	uint32_t const hash = iHashImageExtension(def.mExtension);
+	eastl::unordered_map<uint32_t, uint32_t>::iterator it = gImageLoaderExtensions.find(hash);
+	def.mNextWithExtension = it != gImageLoaderExtensions.end() ? it->second : UINT32_MAX;
+	gImageLoaderExtensions[hash] = index;
+	gImageLoaders.push_back(def);
+
+	if (def.mMagicSize)
+	{
+		gImageMagicLoaders.insert(gImageMagicLoaders.begin(), index);
+		gImageMagicReadSize = max(gImageMagicReadSize, def.mMagicOffset + def.mMagicSize);
+	}
+}
+
+void Image::AddImageLoader(
+	const char* pExtension, ImageLoaderFunction pFunc, ImageProbeFunction pProbeFunc, ImageStreamLoaderFunction pStreamFunc)
+{
+	ImageLoaderDesc desc = {};
+	desc.pExtension = pExtension;
+	desc.pLoader = pFunc;
+	desc.pProbe = pProbeFunc;
+	desc.pStreamLoader = pStreamFunc;
+	AddImageLoader(&desc);
+}
+
+const char* Image::GetImageExtension(const void* pHeader, uint32_t headerSize)
+{
+	uint32_t const index = iSniffImageLoader((const uint8_t*)pHeader, headerSize);
+	return index != UINT32_MAX ? gImageLoaders[index].mExtension : NULL;
+}
+
+// Opens the file the image is read from. Known extensions are used as they are, other paths get the
+// platform default texture extension appended. When that file doesn't exist the path is opened as it is
+// and *pOutExtension is NULL, leaving the loader to the file signature.
+static FileStream* iOpenImageFile(const Path* filePath, PathHandle* pOutLoadFilePath, const char** pOutExtension)
+{
+	PathComponent extensionComponent = fsGetPathExtension(filePath);
+	char          key[IMAGE_EXTENSION_MAX_LENGTH];
+	if (extensionComponent.length != 0 && iGetImageExtensionKey(extensionComponent.buffer, key) && iFindImageLoader(key) != UINT32_MAX)
+	{
+		*pOutLoadFilePath = fsCopyPath(filePath);
+		*pOutExtension = extensionComponent.buffer;
+		return fsOpenFile(*pOutLoadFilePath, FM_READ_BINARY);
+	}
+
+	// For loading basis file, it should have its extension
+#if defined(__ANDROID__)
+	const char* extension = "ktx";
+#elif defined(TARGET_IOS)
+	const char* extension = "ktx";
+#else
+	const char* extension = "dds";
+#endif
+
+	*pOutLoadFilePath = fsAppendPathExtension(filePath, extension);
+	*pOutExtension = extension;
+	FileStream* fh = fsOpenFile(*pOutLoadFilePath, FM_READ_BINARY);
+	if (fh)
+		return fh;
+
+	fh = fsOpenFile(filePath, FM_READ_BINARY);
+	if (fh)
+	{
+		*pOutLoadFilePath = fsCopyPath(filePath);
+		*pOutExtension = NULL;
+	}
+	return fh;
+}
+
+static uint32_t iReadImageHeader(FileStream* fh, uint8_t* pHeader)
+{
+	ssize_t const readSize = fsReadFromStream(fh, pHeader, gImageMagicReadSize);
+	fsSeekStream(fh, SBO_START_OF_FILE, 0);
+	return readSize > 0 ? (uint32_t)readSize : 0;
+}
+
+// Runs the header probes of the loader candidates. *pOutSupported is false when none of them has a probe
+static bool iProbeImageStream(FileStream* fh, const char* extension, ImageProbeInfo* pOutInfo, bool* pOutSupported)
+{
+	uint8_t        header[IMAGE_MAGIC_MAX_SIZE];
+	uint32_t const headerSize = iReadImageHeader(fh, header);
+	uint32_t       candidates[IMAGE_MAX_LOADER_CANDIDATES];
+	uint32_t const candidateCount = iGetImageLoaderCandidates(extension, header, headerSize, candidates);
+
+	bool probed = false;
+	*pOutSupported = false;
+	for (uint32_t i = 0; i < candidateCount && !probed; ++i)
+	{
+		ImageLoaderDefinition const& def = gImageLoaders[candidates[i]];
+		if (def.pProbe)
+		{
+			*pOutSupported = true;
+			fsSeekStream(fh, SBO_START_OF_FILE, 0);
+			*pOutInfo = {};
+			probed = def.pProbe(fh, pOutInfo);
+		}
+	}
+	return probed;
+}
+
+bool Image::ProbeFile(const Path* filePath, ImageProbeInfo* pOutInfo)
+{
+	ASSERT(pOutInfo);
+
+	PathHandle  loadFilePath = NULL;
+	const char* extension = NULL;
+	FileStream* fh = iOpenImageFile(filePath, &loadFilePath, &extension);
+	if (!fh)
+	{
+		LOGF(LogLevel::eERROR, "\"%s\": Image file not found.", fsGetPathAsNativeString(loadFilePath));
+		return false;
+	}
+
+	bool       support = false;
+	bool const probed = iProbeImageStream(fh, extension, pOutInfo, &support);
+	fsCloseStream(fh);
+
+	if (!support)
+		LOGF(LogLevel::eERROR, "Can't probe this file format for image  :  %s", fsGetPathAsNativeString(loadFilePath));
+	else if (!probed)
+		LOGF(LogLevel::eERROR, "\"%s\": Invalid image header.", fsGetPathAsNativeString(loadFilePath));
+
+	return probed;
+}
+
+bool Image::TryProbeFile(const Path* filePath, ImageProbeInfo* pOutInfo)
+{
+	PathHandle  loadFilePath = NULL;
+	const char* extension = NULL;
+	FileStream* fh = iOpenImageFile(filePath, &loadFilePath, &extension);
+	if (!fh)
+		return false;
+
+	bool       support = false;
+	bool const probed = iProbeImageStream(fh, extension, pOutInfo, &support);
+	fsCloseStream(fh);
+	return probed;
+}
+
+bool Image::TryProbeMemory(void const* mem, uint32_t size, char const* extension, ImageProbeInfo* pOutInfo)
+{
+	FileStream* fh = fsOpenReadOnlyMemory(mem, size);
+	if (!fh)
+		return false;
+
+	bool       support = false;
+	bool const probed = iProbeImageStream(fh, extension, pOutInfo, &support);
+	fsCloseStream(fh);
+	return probed;
+}
+
+bool Image::LoadFromMemory(
+	void const* mem, uint32_t size, char const* extension, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	uint32_t       candidates[IMAGE_MAX_LOADER_CANDIDATES];
+	uint32_t const candidateCount = iGetImageLoaderCandidates(extension, (const uint8_t*)mem, size, candidates);
+
+#ifndef IMAGE_DISABLE_STB
+	if (pImageCacheDirectory && candidateCount && gImageLoaders[candidates[0]].pLoader == iLoadSTBFromMemory)
+		return LoadCachedImage((char const*)mem, size, pAllocator, pUserData);
+#endif
+
+	// try loading the format
+	bool loaded = false;
+	for (uint32_t i = 0; i < candidateCount && !loaded; ++i)
+		loaded = gImageLoaders[candidates[i]].pLoader(this, (char const*)mem, size, pAllocator, pUserData);
+	return loaded;
+}
+
+bool Image::LoadFromFile(const Path* filePath, memoryAllocationFunc pAllocator, void* pUserData)
+{
+	// clear current image
+	Clear();
+
+	PathHandle  loadFilePath = NULL;
+	const char* extension = NULL;
+	FileStream* fh = iOpenImageFile(filePath, &loadFilePath, &extension);
+	
+	if (!fh)
+	{
+		LOGF(LogLevel::eERROR, "\"%s\": Image file not found.", fsGetPathAsNativeString(loadFilePath));
+		return false;
+	}
+	
+    ssize_t length = fsGetStreamFileSize(fh);
+	if (length <= 0)
+	{
+		LOGF(LogLevel::eERROR, "\"%s\": Image is an empty file.", fsGetPathAsNativeString(loadFilePath));
+        fsCloseStream(fh);
+		return false;
+	}
+
+	uint8_t        header[IMAGE_MAGIC_MAX_SIZE];
+	uint32_t const headerSize = iReadImageHeader(fh, header);
+	uint32_t       candidates[IMAGE_MAX_LOADER_CANDIDATES];
+	uint32_t const candidateCount = iGetImageLoaderCandidates(extension, header, headerSize, candidates);
+	
+	// try loading the format
+	bool loaded = false;
+	bool support = candidateCount > 0;
+	bool cached = false;
+	char* data = NULL;
+#ifndef IMAGE_DISABLE_STB
+	// the whole file is needed for the content hash
+	if (pImageCacheDirectory && candidateCount && gImageLoaders[candidates[0]].pLoader == iLoadSTBFromMemory)
+	{
+		cached = true;
+		data = (char*)conf_malloc(length * sizeof(char));
+		fsReadFromStream(fh, data, length);
+		loaded = LoadCachedImage(data, (uint32_t)length, pAllocator, pUserData);
+	}
+#endif
+	for (uint32_t i = 0; i < candidateCount && !cached && !loaded; i++)
+	{
+		ImageLoaderDefinition const& def = gImageLoaders[candidates[i]];
+		if (def.pStreamLoader)
+		{
+			// read straight from the file into the destination memory
+			fsSeekStream(fh, SBO_START_OF_FILE, 0);
+			loaded = def.pStreamLoader(this, fh, pAllocator, pUserData);
+		}
+		else
+		{
+			// load file into memory once, shared by all candidate loaders
+			if (!data)
+			{
+				data = (char*)conf_malloc(length * sizeof(char));
+				fsSeekStream(fh, SBO_START_OF_FILE, 0);
+				fsReadFromStream(fh, data, length);
+			}
+			loaded = def.pLoader(this, data, (uint32_t)length, pAllocator, pUserData);
+		}
+	}
+	fsCloseStream(fh);
+
+	if (!support)
+	{
+		LOGF(LogLevel::eERROR, "Can't load this file format for image  :  %s", fsGetPathAsNativeString(loadFilePath));
+	}
+	else
+	{
+		mLoadFilePath = loadFilePath;
+	}
+	// cleanup the compressed data
+	if (data)
+		conf_free(data);
+
+	return loaded;
+}
+
+//------------------------------------------------------------------------------
+// Row codec: decodes / encodes rows of pixels to float4 with correct rounding.
+// tinyimageformat truncates on encode and its float to sRGB encode is unusable,
+// so sRGB formats are encoded through their UNORM sibling after our own conversion.
+//------------------------------------------------------------------------------
+typedef struct ImageRowCodec
+{
+	TinyImageFormat mDecodeFormat;
+	TinyImageFormat mEncodeFormat;
+	// apply sRGB -> linear to RGB after decoding
+	bool            mLinearize;
+	// apply linear -> sRGB to RGB before encoding
+	bool            mDelinearize;
+	bool            mSigned;
+	float           mBias[4];
+	float           mMin[4];
+	float           mMax[4];
+} ImageRowCodec;
+
+static TinyImageFormat iGetSrgbEncodeFormat(TinyImageFormat fmt)
+{
+	switch (fmt)
+	{
+		case TinyImageFormat_R8_SRGB: return TinyImageFormat_R8_UNORM;
+		case TinyImageFormat_R8G8_SRGB: return TinyImageFormat_R8G8_UNORM;
+		case TinyImageFormat_R8G8B8_SRGB: return TinyImageFormat_R8G8B8_UNORM;
+		case TinyImageFormat_B8G8R8_SRGB: return TinyImageFormat_B8G8R8_UNORM;
+		case TinyImageFormat_R8G8B8A8_SRGB: return TinyImageFormat_R8G8B8A8_UNORM;
+		case TinyImageFormat_B8G8R8A8_SRGB: return TinyImageFormat_B8G8R8A8_UNORM;
+		default: return TinyImageFormat_UNDEFINED;
+	}
+}
+
+static inline float iSrgbToLinear(float v)
+{
+	return (v <= 0.04045f) ? v * (1.0f / 12.92f) : powf((v + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+static inline float iLinearToSrgb(float v)
+{
+	v = clamp(v, 0.0f, 1.0f);
+	return (v < 0.0031308f) ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+}
+
+// srgb treats the color channels of UNORM formats as sRGB encoded. Returns false if the format can't be processed
+static bool iInitRowCodec(TinyImageFormat fmt, bool srgb, ImageRowCodec* pCodec)
+{
+	*pCodec = {};
+	pCodec->mDecodeFormat = fmt;
+	pCodec->mEncodeFormat = fmt;
+
+	if (TinyImageFormat_IsSRGB(fmt))
+	{
+		pCodec->mEncodeFormat = iGetSrgbEncodeFormat(fmt);
+		pCodec->mDelinearize = true;
+	}
+	else if (srgb && TinyImageFormat_IsNormalised(fmt) && !TinyImageFormat_IsSigned(fmt))
+	{
+		pCodec->mLinearize = true;
+		pCodec->mDelinearize = true;
+	}
+
+	if (!TinyImageFormat_CanDecodeLogicalPixelsF(pCodec->mDecodeFormat) ||
+		!TinyImageFormat_CanEncodeLogicalPixelsF(pCodec->mEncodeFormat))
+		return false;
+
+	TinyImageFormat const encodeFmt = pCodec->mEncodeFormat;
+	bool const isFloat = TinyImageFormat_IsFloat(encodeFmt);
+	bool const isNormalised = TinyImageFormat_IsNormalised(encodeFmt);
+	pCodec->mSigned = TinyImageFormat_IsSigned(encodeFmt);
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		uint32_t const bits = TinyImageFormat_ChannelBitWidth(encodeFmt, (TinyImageFormat_LogicalChannel)c);
+		pCodec->mMin[c] = -FLT_MAX;
+		pCodec->mMax[c] = FLT_MAX;
+		if (bits == 0 || isFloat)
+			continue;
+
+		double const maxValue = ldexp(1.0, bits - (pCodec->mSigned ? 1 : 0)) - 1.0;
+		if (isNormalised)
+		{
+			pCodec->mBias[c] = (float)(0.5 / maxValue);
+			pCodec->mMin[c] = pCodec->mSigned ? -1.0f : 0.0f;
+			pCodec->mMax[c] = 1.0f;
+		}
+		else
+		{
+			pCodec->mBias[c] = 0.5f;
+			pCodec->mMin[c] = pCodec->mSigned ? (float)(-maxValue - 1.0) : 0.0f;
+			pCodec->mMax[c] = (float)maxValue;
+		}
+	}
+
+	return true;
+}
+
+static void iDecodeRow(const ImageRowCodec* pCodec, const void* pSrc, uint32_t width, float* pOut)
+{
+	TinyImageFormat_DecodeInput input = {};
+	input.pixel = pSrc;
+	TinyImageFormat_DecodeLogicalPixelsF(pCodec->mDecodeFormat, &input, width, pOut);
+
+	if (pCodec->mLinearize)
+	{
+		for (uint32_t i = 0; i < width; ++i, pOut += 4)
+		{
+			pOut[0] = iSrgbToLinear(pOut[0]);
+			pOut[1] = iSrgbToLinear(pOut[1]);
+			pOut[2] = iSrgbToLinear(pOut[2]);
+		}
+	}
+}
+
+// pIn is used as scratch and modified
+static void iEncodeRow(const ImageRowCodec* pCodec, float* pIn, uint32_t width, void* pDst)
+{
+	float* pPixel = pIn;
+	for (uint32_t i = 0; i < width; ++i, pPixel += 4)
+	{
+		if (pCodec->mDelinearize)
+		{
+			pPixel[0] = iLinearToSrgb(pPixel[0]);
+			pPixel[1] = iLinearToSrgb(pPixel[1]);
+			pPixel[2] = iLinearToSrgb(pPixel[2]);
+		}
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			float v = pPixel[c];
+			v += (pCodec->mSigned && v < 0.0f) ? -pCodec->mBias[c] : pCodec->mBias[c];
+			pPixel[c] = clamp(v, pCodec->mMin[c], pCodec->mMax[c]);
+		}
+	}
+
+	TinyImageFormat_EncodeOutput output = {};
+	output.pixel = pDst;
+	TinyImageFormat_EncodeLogicalPixelsF(pCodec->mEncodeFormat, pIn, width, &output);
+}
+
+//------------------------------------------------------------------------------
+// Multi threaded helpers
+//------------------------------------------------------------------------------
+typedef struct ImageTaskGroup
+{
+	TaskFunc        pTask;
+	void*           pUser;
+	tfrg_atomic32_t mRemaining;
+} ImageTaskGroup;
+
+static void iImageGroupTask(void* pUser, uintptr_t index)
+{
+	ImageTaskGroup* pGroup = (ImageTaskGroup*)pUser;
+	pGroup->pTask(pGroup->pUser, index);
+	tfrg_atomic32_add_relaxed(&pGroup->mRemaining, (uint32_t)-1);
+}
+
+// Runs task for [0, count) on pThreadSystem if given, inline otherwise. The calling thread helps until all work is done.
+// Only this group is waited on, so it is safe to call from a task already running on pThreadSystem.
+static void iRunImageTasks(ThreadSystem* pThreadSystem, TaskFunc task, void* pUser, uint32_t count)
+{
+	if (!pThreadSystem || count < 2)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			task(pUser, i);
+		return;
+	}
+
+	ImageTaskGroup group = { task, pUser, count };
+	addThreadSystemRangeTask(pThreadSystem, iImageGroupTask, &group, count);
+	while (tfrg_atomic32_load_acquire(&group.mRemaining) != 0)
+	{
+		if (!assistThreadSystem(pThreadSystem))
+			Thread::Sleep(0);
+	}
+}
+
+// Pixels of one array slice / cube face of a mip level, independent of how slices and mips are laid out
+// Same as iGetLayerPixels as a byte offset, for the image layout with its pixels stored as fmt
+static uint64_t iGetLayerOffset(const Image* pImage, uint32_t mipMapLevel, uint32_t layer, TinyImageFormat fmt)
+{
+	uint32_t const faceCount = pImage->IsCube() ? 6 : 1;
+	uint64_t const layerSize = pImage->GetArraySliceSize(mipMapLevel, fmt);
+	uint64_t const mipOffset = pImage->GetMipMappedSize(0, mipMapLevel, fmt);
+	if (pImage->AreMipsAfterSlices())
+		return mipOffset + layer * layerSize;
+
+	uint64_t const sliceSize = pImage->GetMipMappedSize(0, pImage->GetMipMapCount(), fmt);
+	return sliceSize * (layer / faceCount) + mipOffset + (layer % faceCount) * layerSize;
+}
+
+static unsigned char* iGetLayerPixels(const Image* pImage, uint32_t mipMapLevel, uint32_t layer)
+{
+	return pImage->GetPixels() + iGetLayerOffset(pImage, mipMapLevel, layer, pImage->GetFormat());
+}
+
+//------------------------------------------------------------------------------
+// SIMD row kernels
+//------------------------------------------------------------------------------
+// pDst += w * pSrc for count floats
+static void iMulAddRow(float* pDst, const float* pSrc, float w, uint32_t count)
+{
+	uint32_t i = 0;
+#if defined(IMAGE_SIMD_SSE2)
+	__m128 const weight = _mm_set1_ps(w);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(pDst + i, _mm_add_ps(_mm_loadu_ps(pDst + i), _mm_mul_ps(_mm_loadu_ps(pSrc + i), weight)));
+#elif defined(IMAGE_SIMD_NEON)
+	for (; i + 4 <= count; i += 4)
+		vst1q_f32(pDst + i, vmlaq_n_f32(vld1q_f32(pDst + i), vld1q_f32(pSrc + i), w));
+#endif
+	for (; i < count; ++i)
+		pDst[i] += w * pSrc[i];
+}
+
+// Exact 2x2 box of a four channel 8 bit row pair, rounded to nearest
+static void iDownsampleRowRGBA8(uint8_t* pDst, const uint8_t* pRow0, const uint8_t* pRow1, uint32_t dstWidth)
+{
+	uint32_t x = 0;
+#if defined(IMAGE_SIMD_AVX2)
+	__m256i const zero256 = _mm256_setzero_si256();
+	__m256i const two256 = _mm256_set1_epi16(2);
+	for (; x + 8 <= dstWidth; x += 8)
+	{
+		__m256i a0 = _mm256_loadu_si256((const __m256i*)(pRow0 + x * 8));
+		__m256i a1 = _mm256_loadu_si256((const __m256i*)(pRow0 + x * 8 + 32));
+		__m256i b0 = _mm256_loadu_si256((const __m256i*)(pRow1 + x * 8));
+		__m256i b1 = _mm256_loadu_si256((const __m256i*)(pRow1 + x * 8 + 32));
+		__m256i s0 = _mm256_add_epi16(_mm256_unpacklo_epi8(a0, zero256), _mm256_unpacklo_epi8(b0, zero256));
+		__m256i s1 = _mm256_add_epi16(_mm256_unpackhi_epi8(a0, zero256), _mm256_unpackhi_epi8(b0, zero256));
+		__m256i s2 = _mm256_add_epi16(_mm256_unpacklo_epi8(a1, zero256), _mm256_unpacklo_epi8(b1, zero256));
+		__m256i s3 = _mm256_add_epi16(_mm256_unpackhi_epi8(a1, zero256), _mm256_unpackhi_epi8(b1, zero256));
+		__m256i h0 = _mm256_add_epi16(_mm256_unpacklo_epi64(s0, s1), _mm256_unpackhi_epi64(s0, s1));
+		__m256i h1 = _mm256_add_epi16(_mm256_unpacklo_epi64(s2, s3), _mm256_unpackhi_epi64(s2, s3));
+		h0 = _mm256_srli_epi16(_mm256_add_epi16(h0, two256), 2);
+		h1 = _mm256_srli_epi16(_mm256_add_epi16(h1, two256), 2);
+		// packus works per 128 bit lane, restore pixel order afterwards
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(h0, h1), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)(pDst + x * 4), packed);
+	}
+#endif
+#if defined(IMAGE_SIMD_SSE2)
+	__m128i const zero = _mm_setzero_si128();
+	__m128i const two = _mm_set1_epi16(2);
+	for (; x + 4 <= dstWidth; x += 4)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(pRow0 + x * 8));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(pRow0 + x * 8 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i*)(pRow1 + x * 8));
+		__m128i b1 = _mm_loadu_si128((const __m128i*)(pRow1 + x * 8 + 16));
+		// vertical sums, two source pixels per register
+		__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+		__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+		__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+		__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+		// horizontal sums of neighbouring pixels
+		__m128i h0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+		__m128i h1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+		h0 = _mm_srli_epi16(_mm_add_epi16(h0, two), 2);
+		h1 = _mm_srli_epi16(_mm_add_epi16(h1, two), 2);
+		_mm_storeu_si128((__m128i*)(pDst + x * 4), _mm_packus_epi16(h0, h1));
+	}
+#elif defined(IMAGE_SIMD_NEON)
+	for (; x + 4 <= dstWidth; x += 4)
+	{
+		uint8x16_t a0 = vld1q_u8(pRow0 + x * 8);
+		uint8x16_t a1 = vld1q_u8(pRow0 + x * 8 + 16);
+		uint8x16_t b0 = vld1q_u8(pRow1 + x * 8);
+		uint8x16_t b1 = vld1q_u8(pRow1 + x * 8 + 16);
+		uint16x8_t s0 = vaddl_u8(vget_low_u8(a0), vget_low_u8(b0));
+		uint16x8_t s1 = vaddl_u8(vget_high_u8(a0), vget_high_u8(b0));
+		uint16x8_t s2 = vaddl_u8(vget_low_u8(a1), vget_low_u8(b1));
+		uint16x8_t s3 = vaddl_u8(vget_high_u8(a1), vget_high_u8(b1));
+		uint16x8_t h0 = vaddq_u16(vcombine_u16(vget_low_u16(s0), vget_low_u16(s1)), vcombine_u16(vget_high_u16(s0), vget_high_u16(s1)));
+		uint16x8_t h1 = vaddq_u16(vcombine_u16(vget_low_u16(s2), vget_low_u16(s3)), vcombine_u16(vget_high_u16(s2), vget_high_u16(s3)));
+		vst1q_u8(pDst + x * 4, vcombine_u8(vrshrn_n_u16(h0, 2), vrshrn_n_u16(h1, 2)));
+	}
+#endif
+	for (; x < dstWidth; ++x)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			uint32_t sum = pRow0[x * 8 + c] + pRow0[x * 8 + 4 + c] + pRow1[x * 8 + c] + pRow1[x * 8 + 4 + c];
+			pDst[x * 4 + c] = (uint8_t)((sum + 2) >> 2);
+		}
+	}
+}
+
+// Exact 2x2 box of a four channel 32 bit float row pair
+static void iDownsampleRowRGBA32F(float* pDst, const float* pRow0, const float* pRow1, uint32_t dstWidth)
+{
+	uint32_t x = 0;
+#if defined(IMAGE_SIMD_SSE2)
+	__m128 const quarter = _mm_set1_ps(0.25f);
+	for (; x < dstWidth; ++x)
+	{
+		__m128 top = _mm_add_ps(_mm_loadu_ps(pRow0 + x * 8), _mm_loadu_ps(pRow0 + x * 8 + 4));
+		__m128 bottom = _mm_add_ps(_mm_loadu_ps(pRow1 + x * 8), _mm_loadu_ps(pRow1 + x * 8 + 4));
+		_mm_storeu_ps(pDst + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+	}
+#elif defined(IMAGE_SIMD_NEON)
+	for (; x < dstWidth; ++x)
+	{
+		float32x4_t top = vaddq_f32(vld1q_f32(pRow0 + x * 8), vld1q_f32(pRow0 + x * 8 + 4));
+		float32x4_t bottom = vaddq_f32(vld1q_f32(pRow1 + x * 8), vld1q_f32(pRow1 + x * 8 + 4));
+		vst1q_f32(pDst + x * 4, vmulq_n_f32(vaddq_f32(top, bottom), 0.25f));
+	}
+#endif
+	for (; x < dstWidth; ++x)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			pDst[x * 4 + c] = (pRow0[x * 8 + c] + pRow0[x * 8 + 4 + c] + pRow1[x * 8 + c] + pRow1[x * 8 + 4 + c]) * 0.25f;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Mip map generation
+//------------------------------------------------------------------------------
+#define MIPMAP_BAND_ROWS 16
+#define MIPMAP_KAISER_ALPHA 4.0f
+
+static float iSinc(float x)
+{
+	if (fabsf(x) < 1e-5f)
+		return 1.0f;
+	x *= PI;
+	return sinf(x) / x;
+}
+
+// Zeroth order modified Bessel function of the first kind
+static float iBesselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	float const halfX = x * 0.5f;
+	for (uint32_t k = 1; k < 32; ++k)
+	{
+		term *= halfX / (float)k;
+		float const t = term * term;
+		sum += t;
+		if (t < sum * 1e-7f)
+			break;
+	}
+	return sum;
+}
+
+static float iMipFilterRadius(MipMapFilter filter)
+{
+	return (filter == MIPMAP_FILTER_BOX) ? 0.5f : 3.0f;
+}
+
+// t is the distance to the destination texel center in destination texels
+static float iMipFilterWeight(MipMapFilter filter, float t)
+{
+	t = fabsf(t);
+	switch (filter)
+	{
+		case MIPMAP_FILTER_KAISER:
+		{
+			if (t >= 3.0f)
+				return 0.0f;
+			float const r = t / 3.0f;
+			return iSinc(t) * iBesselI0(MIPMAP_KAISER_ALPHA * sqrtf(1.0f - r * r)) / iBesselI0(MIPMAP_KAISER_ALPHA);
+		}
+		case MIPMAP_FILTER_LANCZOS:
+			return (t >= 3.0f) ? 0.0f : iSinc(t) * iSinc(t / 3.0f);
+		default:
+			return (t <= 0.5f) ? 1.0f : 0.0f;
+	}
+}
+
+// Source taps and normalized weights of every destination texel along one axis, clamped to the edge
+typedef struct MipFilterAxis
+{
+	eastl::vector<uint32_t> mTapOffsets;
+	eastl::vector<uint32_t> mIndices;
+	eastl::vector<float>    mWeights;
+} MipFilterAxis;
+
+static void iBuildFilterAxis(MipMapFilter filter, uint32_t srcSize, uint32_t dstSize, MipFilterAxis* pAxis)
+{
+	pAxis->mTapOffsets.clear();
+	pAxis->mIndices.clear();
+	pAxis->mWeights.clear();
+
+	float const scale = (float)srcSize / (float)dstSize;
+	float const radius = iMipFilterRadius(filter) * max(scale, 1.0f);
+
+	for (uint32_t i = 0; i < dstSize; ++i)
+	{
+		uint32_t const first = (uint32_t)pAxis->mIndices.size();
+		pAxis->mTapOffsets.push_back(first);
+
+		float const center = ((float)i + 0.5f) * scale - 0.5f;
+		int32_t const begin = (int32_t)ceilf(center - radius);
+		int32_t const end = (int32_t)floorf(center + radius);
+		float sum = 0.0f;
+		for (int32_t s = begin; s <= end; ++s)
+		{
+			float const w = iMipFilterWeight(filter, ((float)s - center) / max(scale, 1.0f));
+			if (w == 0.0f)
+				continue;
+
+			uint32_t const index = (uint32_t)clamp(s, 0, (int32_t)srcSize - 1);
+			// taps clamped to the same edge texel are merged
+			if (pAxis->mIndices.size() > first && pAxis->mIndices.back() == index)
+				pAxis->mWeights.back() += w;
+			else
+			{
+				pAxis->mIndices.push_back(index);
+				pAxis->mWeights.push_back(w);
+			}
+			sum += w;
+		}
+
+		if (pAxis->mIndices.size() == first)
+		{
+			pAxis->mIndices.push_back((uint32_t)clamp((int32_t)(center + 0.5f), 0, (int32_t)srcSize - 1));
+			pAxis->mWeights.push_back(1.0f);
+			sum = 1.0f;
+		}
+
+		for (uint32_t t = first; t < (uint32_t)pAxis->mIndices.size(); ++t)
+			pAxis->mWeights[t] /= sum;
+	}
+	pAxis->mTapOffsets.push_back((uint32_t)pAxis->mIndices.size());
+}
+
+typedef struct MipLevelGenerator
+{
+	Image*               pImage;
+	const ImageRowCodec* pCodec;
+	uint32_t             mLevel;
+	uint32_t             mBandCount;
+	MipFilterAxis        mAxisX;
+	MipFilterAxis        mAxisY;
+	MipFilterAxis        mAxisZ;
+	// 0 = generic filter, 1 = RGBA8 box, 2 = RGBA32F box
+	uint32_t             mFastBox;
+} MipLevelGenerator;
+
+// One task generates MIPMAP_BAND_ROWS destination rows of one depth slice of one layer
+static void iGenerateMipBandTask(void* pUser, uintptr_t index)
+{
+	MipLevelGenerator* pGen = (MipLevelGenerator*)pUser;
+	const Image*       pImage = pGen->pImage;
+	uint32_t const     level = pGen->mLevel;
+
+	uint32_t const srcW = pImage->GetWidth(level - 1);
+	uint32_t const srcH = pImage->GetHeight(level - 1);
+	uint32_t const dstW = pImage->GetWidth(level);
+	uint32_t const dstH = pImage->GetHeight(level);
+	uint32_t const dstD = pImage->GetDepth(level);
+
+	uint32_t const bandsPerLayer = dstD * pGen->mBandCount;
+	uint32_t const layer = (uint32_t)index / bandsPerLayer;
+	uint32_t const z = ((uint32_t)index % bandsPerLayer) / pGen->mBandCount;
+	uint32_t const y0 = ((uint32_t)index % pGen->mBandCount) * MIPMAP_BAND_ROWS;
+	uint32_t const y1 = min(y0 + MIPMAP_BAND_ROWS, dstH);
+
+	uint32_t const pixelSize = TinyImageFormat_BitSizeOfBlock(pImage->GetFormat()) / 8;
+	uint32_t const srcRowPitch = srcW * pixelSize;
+	uint32_t const srcSlicePitch = srcRowPitch * srcH;
+	uint32_t const dstRowPitch = dstW * pixelSize;
+
+	const uint8_t* pSrc = iGetLayerPixels(pImage, level - 1, layer);
+	uint8_t*       pDst = iGetLayerPixels(pImage, level, layer) + (z * dstH + y0) * dstRowPitch;
+
+	if (pGen->mFastBox)
+	{
+		for (uint32_t y = y0; y < y1; ++y, pDst += dstRowPitch)
+		{
+			const uint8_t* pRow0 = pSrc + (2 * y) * srcRowPitch;
+			if (pGen->mFastBox == 1)
+				iDownsampleRowRGBA8(pDst, pRow0, pRow0 + srcRowPitch, dstW);
+			else
+				iDownsampleRowRGBA32F((float*)pDst, (const float*)pRow0, (const float*)(pRow0 + srcRowPitch), dstW);
+		}
+		return;
+	}
+
+	const MipFilterAxis& axisX = pGen->mAxisX;
+	const MipFilterAxis& axisY = pGen->mAxisY;
+	const MipFilterAxis& axisZ = pGen->mAxisZ;
+
+	// source rows touched by this band
+	uint32_t rowMin = srcH;
+	uint32_t rowMax = 0;
+	for (uint32_t t = axisY.mTapOffsets[y0]; t < axisY.mTapOffsets[y1]; ++t)
+	{
+		rowMin = min(rowMin, axisY.mIndices[t]);
+		rowMax = max(rowMax, axisY.mIndices[t]);
+	}
+	uint32_t const rowCount = rowMax - rowMin + 1;
+
+	float* pRow = (float*)conf_malloc(sizeof(float) * 4 * srcW);
+	float* pFiltered = (float*)conf_malloc(sizeof(float) * 4 * dstW * rowCount);
+	float* pAccum = (float*)conf_calloc(4 * dstW * (y1 - y0), sizeof(float));
+
+	for (uint32_t tz = axisZ.mTapOffsets[z]; tz < axisZ.mTapOffsets[z + 1]; ++tz)
+	{
+		const uint8_t* pSrcSlice = pSrc + axisZ.mIndices[tz] * srcSlicePitch;
+		float const    wz = axisZ.mWeights[tz];
+
+		// horizontal pass
+		for (uint32_t r = 0; r < rowCount; ++r)
+		{
+			iDecodeRow(pGen->pCodec, pSrcSlice + (rowMin + r) * srcRowPitch, srcW, pRow);
+
+			float* pOut = pFiltered + r * dstW * 4;
+			memset(pOut, 0, sizeof(float) * 4 * dstW);
+			for (uint32_t x = 0; x < dstW; ++x, pOut += 4)
+			{
+				for (uint32_t t = axisX.mTapOffsets[x]; t < axisX.mTapOffsets[x + 1]; ++t)
+					iMulAddRow(pOut, pRow + axisX.mIndices[t] * 4, axisX.mWeights[t], 4);
+			}
+		}
+
+		// vertical pass
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			float* pOut = pAccum + (y - y0) * dstW * 4;
+			for (uint32_t t = axisY.mTapOffsets[y]; t < axisY.mTapOffsets[y + 1]; ++t)
+				iMulAddRow(pOut, pFiltered + (axisY.mIndices[t] - rowMin) * dstW * 4, wz * axisY.mWeights[t], dstW * 4);
+		}
+	}
+
+	for (uint32_t y = y0; y < y1; ++y, pDst += dstRowPitch)
+		iEncodeRow(pGen->pCodec, pAccum + (y - y0) * dstW * 4, dstW, pDst);
+
+	conf_free(pAccum);
+	conf_free(pFiltered);
+	conf_free(pRow);
+}
+
+typedef struct AlphaCoverageJob
+{
+	Image*               pImage;
+	const ImageRowCodec* pCodec;
+	uint32_t             mLevel;
+	float                mReference;
+	// per layer fraction of texels above mReference in the top level
+	float*               pCoverage;
+} AlphaCoverageJob;
+
+#define ALPHA_COVERAGE_BINS 256
+
+// Level 0 records the coverage of every layer, other levels rescale alpha to match it
+static void iAlphaCoverageTask(void* pUser, uintptr_t layer)
+{
+	AlphaCoverageJob* pJob = (AlphaCoverageJob*)pUser;
+	Image*            pImage = pJob->pImage;
+	uint32_t const    level = pJob->mLevel;
+	uint32_t const    width = pImage->GetWidth(level);
+	uint32_t const    rowCount = pImage->GetHeight(level) * pImage->GetDepth(level);
+	uint32_t const    rowPitch = width * (TinyImageFormat_BitSizeOfBlock(pImage->GetFormat()) / 8);
+	uint8_t*          pPixels = iGetLayerPixels(pImage, level, (uint32_t)layer);
+
+	float*   pRow = (float*)conf_malloc(sizeof(float) * 4 * width);
+	uint32_t histogram[ALPHA_COVERAGE_BINS] = {};
+	for (uint32_t r = 0; r < rowCount; ++r)
+	{
+		iDecodeRow(pJob->pCodec, pPixels + r * rowPitch, width, pRow);
+		for (uint32_t x = 0; x < width; ++x)
+			++histogram[(uint32_t)(clamp(pRow[x * 4 + 3], 0.0f, 1.0f) * (ALPHA_COVERAGE_BINS - 1) + 0.5f)];
+	}
+
+	uint32_t const texelCount = width * rowCount;
+	uint32_t const refBin = (uint32_t)(pJob->mReference * (ALPHA_COVERAGE_BINS - 1) + 0.5f);
+	if (level == 0)
+	{
+		uint32_t covered = 0;
+		for (uint32_t b = refBin + 1; b < ALPHA_COVERAGE_BINS; ++b)
+			covered += histogram[b];
+		pJob->pCoverage[layer] = (float)covered / (float)texelCount;
+		conf_free(pRow);
+		return;
+	}
+
+	// find the alpha value above which the same fraction of texels lies as in the top level
+	uint32_t const target = (uint32_t)(pJob->pCoverage[layer] * texelCount + 0.5f);
+	uint32_t       covered = 0;
+	uint32_t       bin = ALPHA_COVERAGE_BINS - 1;
+	for (; bin > 0; --bin)
+	{
+		covered += histogram[bin];
+		if (covered >= target)
+			break;
+	}
+
+	float const threshold = max(((float)bin - 0.5f) / (float)(ALPHA_COVERAGE_BINS - 1), 1.0f / (ALPHA_COVERAGE_BINS - 1));
+	float const scale = pJob->mReference / threshold;
+	if (target != 0 && fabsf(scale - 1.0f) > 1e-3f)
+	{
+		for (uint32_t r = 0; r < rowCount; ++r)
+		{
+			iDecodeRow(pJob->pCodec, pPixels + r * rowPitch, width, pRow);
+			for (uint32_t x = 0; x < width; ++x)
+				pRow[x * 4 + 3] = min(pRow[x * 4 + 3] * scale, 1.0f);
+			iEncodeRow(pJob->pCodec, pRow, width, pPixels + r * rowPitch);
+		}
+	}
+
+	conf_free(pRow);
+}
+
+bool Image::GenerateMipMaps(const uint32_t mipMaps, const MipMapGenerationDesc* pDesc)
+{
+	if (TinyImageFormat_IsCompressed(mFormat))
+		return false;
+	if (!mWidth || !mHeight)
+		return false;
+
+	MipMapGenerationDesc desc = {};
+	if (pDesc)
+		desc = *pDesc;
+
+	ImageRowCodec codec;
+	if (!iInitRowCodec(mFormat, desc.mSrgb, &codec))
+		return false;
+
+	uint32_t const layerCount = mArrayCount * (IsCube() ? 6 : 1);
+	uint actualMipMaps = min(mipMaps, GetMipMapCountFromDimensions());
+
+	if (mMipMapCount != actualMipMaps)
+	{
+		// Only the top level survives, copy every layer of it to the new allocation
+		eastl::vector<unsigned char*> oldLayers(layerCount);
+		for (uint32_t layer = 0; layer < layerCount; ++layer)
+			oldLayers[layer] = iGetLayerPixels(this, 0, layer);
+
+		unsigned char* pOldData = pData;
+		uint32_t const layerSize = GetArraySliceSize(0);
+
+		mMipMapCount = actualMipMaps;
+		uint32_t const size = GetMipMappedSize(0, mMipMapCount) * (mMipsAfterSlices ? 1 : mArrayCount);
+		pData = (ubyte*)conf_malloc(sizeof(ubyte) * size);
+
+		for (uint32_t layer = 0; layer < layerCount; ++layer)
+			memcpy(iGetLayerPixels(this, 0, layer), oldLayers[layer], layerSize);
+
+		if (mOwnsMemory)
+			conf_free(pOldData);
+		mOwnsMemory = true;
+	}
+
+	bool const alphaCoverage = desc.mAlphaCoverageReference > 0.0f &&
+							   TinyImageFormat_ChannelBitWidth(mFormat, TinyImageFormat_LC_Alpha) > 0;
+	eastl::vector<float> coverage(alphaCoverage ? layerCount : 0);
+	AlphaCoverageJob coverageJob = { this, &codec, 0, desc.mAlphaCoverageReference, coverage.data() };
+	if (alphaCoverage)
+		iRunImageTasks(desc.pThreadSystem, iAlphaCoverageTask, &coverageJob, layerCount);
+
+	uint32_t const channelCount = TinyImageFormat_ChannelCount(mFormat);
+	uint32_t const redWidth = TinyImageFormat_ChannelBitWidth(mFormat, TinyImageFormat_LC_Red);
+	bool const     homogenousRGBA = TinyImageFormat_IsHomogenous(mFormat) && channelCount == 4 && !codec.mLinearize &&
+							  !codec.mDelinearize && !TinyImageFormat_IsSigned(mFormat);
+
+	MipLevelGenerator gen;
+	gen.pImage = this;
+	gen.pCodec = &codec;
+
+	for (uint32_t level = 1; level < mMipMapCount; ++level)
+	{
+		uint32_t const srcW = GetWidth(level - 1);
+		uint32_t const srcH = GetHeight(level - 1);
+		uint32_t const dstW = GetWidth(level);
+		uint32_t const dstH = GetHeight(level);
+		uint32_t const dstD = GetDepth(level);
+
+		gen.mLevel = level;
+		gen.mBandCount = (dstH + MIPMAP_BAND_ROWS - 1) / MIPMAP_BAND_ROWS;
+		gen.mFastBox = 0;
+		if (desc.mFilter == MIPMAP_FILTER_BOX && homogenousRGBA && srcW == 2 * dstW && srcH == 2 * dstH && GetDepth(level - 1) == 1)
+		{
+			if (redWidth == 8 && !TinyImageFormat_IsFloat(mFormat))
+				gen.mFastBox = 1;
+			else if (redWidth == 32 && TinyImageFormat_IsFloat(mFormat))
+				gen.mFastBox = 2;
+		}
+
+		if (!gen.mFastBox)
+		{
+			iBuildFilterAxis(desc.mFilter, srcW, dstW, &gen.mAxisX);
+			iBuildFilterAxis(desc.mFilter, srcH, dstH, &gen.mAxisY);
+			iBuildFilterAxis(desc.mFilter, GetDepth(level - 1), dstD, &gen.mAxisZ);
+		}
+
+		iRunImageTasks(desc.pThreadSystem, iGenerateMipBandTask, &gen, layerCount * dstD * gen.mBandCount);
+
+		if (alphaCoverage)
+		{
+			coverageJob.mLevel = level;
+			iRunImageTasks(desc.pThreadSystem, iAlphaCoverageTask, &coverageJob, layerCount);
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Format conversion
+//------------------------------------------------------------------------------
+// Pixels are converted in tiles small enough for the float4 scratch to stay in cache
+#define CONVERT_TILE_PIXELS 4096
+#define CONVERT_TILES_PER_TASK 16
+
+typedef enum ImageConvertPath
+{
+	IMAGE_CONVERT_GENERIC = 0,
+	// RGBA8 <-> BGRA8
+	IMAGE_CONVERT_SWIZZLE_RB,
+	// 8 bit sRGB <-> UNORM of the same layout
+	IMAGE_CONVERT_BYTE_LUT,
+	IMAGE_CONVERT_HALF_TO_FLOAT,
+	IMAGE_CONVERT_FLOAT_TO_HALF,
+} ImageConvertPath;
+
+typedef struct ImageConvertJob
+{
+	const uint8_t*   pSrc;
+	uint8_t*         pDst;
+	uint64_t         mPixelCount;
+	uint32_t         mSrcBits;
+	uint32_t         mDstBits;
+	ImageConvertPath mPath;
+	uint32_t         mChannelCount;
+	ImageRowCodec    mDecodeCodec;
+	ImageRowCodec    mEncodeCodec;
+	uint8_t          mLut[256];
+} ImageConvertJob;
+
+static uint32_t iGetHalfFloatChannelCount(TinyImageFormat fmt, uint32_t* pFloatChannelCount)
+{
+	switch (fmt)
+	{
+		case TinyImageFormat_R16_SFLOAT: return 1;
+		case TinyImageFormat_R16G16_SFLOAT: return 2;
+		case TinyImageFormat_R16G16B16_SFLOAT: return 3;
+		case TinyImageFormat_R16G16B16A16_SFLOAT: return 4;
+		case TinyImageFormat_R32_SFLOAT: *pFloatChannelCount = 1; return 0;
+		case TinyImageFormat_R32G32_SFLOAT: *pFloatChannelCount = 2; return 0;
+		case TinyImageFormat_R32G32B32_SFLOAT: *pFloatChannelCount = 3; return 0;
+		case TinyImageFormat_R32G32B32A32_SFLOAT: *pFloatChannelCount = 4; return 0;
+		default: return 0;
+	}
+}
+
+static ImageConvertPath iSelectConvertPath(TinyImageFormat srcFormat, TinyImageFormat dstFormat, ImageConvertJob* pJob)
+{
+	if ((srcFormat == TinyImageFormat_R8G8B8A8_UNORM && dstFormat == TinyImageFormat_B8G8R8A8_UNORM) ||
+		(srcFormat == TinyImageFormat_B8G8R8A8_UNORM && dstFormat == TinyImageFormat_R8G8B8A8_UNORM) ||
+		(srcFormat == TinyImageFormat_R8G8B8A8_SRGB && dstFormat == TinyImageFormat_B8G8R8A8_SRGB) ||
+		(srcFormat == TinyImageFormat_B8G8R8A8_SRGB && dstFormat == TinyImageFormat_R8G8B8A8_SRGB))
+		return IMAGE_CONVERT_SWIZZLE_RB;
+
+	bool const toLinear = iGetSrgbEncodeFormat(srcFormat) == dstFormat;
+	bool const toSrgb = iGetSrgbEncodeFormat(dstFormat) == srcFormat;
+	if (toLinear || toSrgb)
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			float const v = toLinear ? iSrgbToLinear(i / 255.0f) : iLinearToSrgb(i / 255.0f);
+			pJob->mLut[i] = (uint8_t)(clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+		// alpha stays linear
+		pJob->mChannelCount = TinyImageFormat_ChannelCount(srcFormat);
+		return IMAGE_CONVERT_BYTE_LUT;
+	}
+
+	uint32_t srcFloatChannels = 0;
+	uint32_t dstFloatChannels = 0;
+	uint32_t const srcHalfChannels = iGetHalfFloatChannelCount(srcFormat, &srcFloatChannels);
+	uint32_t const dstHalfChannels = iGetHalfFloatChannelCount(dstFormat, &dstFloatChannels);
+	if (srcHalfChannels && srcHalfChannels == dstFloatChannels)
+	{
+		pJob->mChannelCount = srcHalfChannels;
+		return IMAGE_CONVERT_HALF_TO_FLOAT;
+	}
+	if (dstHalfChannels && dstHalfChannels == srcFloatChannels)
+	{
+		pJob->mChannelCount = dstHalfChannels;
+		return IMAGE_CONVERT_FLOAT_TO_HALF;
+	}
+
+	return IMAGE_CONVERT_GENERIC;
+}
+
+static void iSwizzleRB(uint32_t* pDst, const uint32_t* pSrc, uint32_t count)
+{
+	uint32_t i = 0;
+#if defined(IMAGE_SIMD_SSE2)
+	__m128i const rbMask = _mm_set1_epi32(0x00FF00FF);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(pSrc + i));
+		__m128i rb = _mm_and_si128(p, rbMask);
+		__m128i ga = _mm_andnot_si128(rbMask, p);
+		rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+		_mm_storeu_si128((__m128i*)(pDst + i), _mm_or_si128(rb, ga));
+	}
+#elif defined(IMAGE_SIMD_NEON)
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16x4_t p = vld4q_u8((const uint8_t*)(pSrc + i));
+		uint8x16_t   r = p.val[0];
+		p.val[0] = p.val[2];
+		p.val[2] = r;
+		vst4q_u8((uint8_t*)(pDst + i), p);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		uint32_t const p = pSrc[i];
+		uint32_t const rb = p & 0x00FF00FF;
+		pDst[i] = (p & 0xFF00FF00) | (rb << 16) | (rb >> 16);
+	}
+}
+
+static void iHalfToFloat(float* pDst, const uint16_t* pSrc, uint32_t count)
+{
+	uint32_t i = 0;
+#if defined(IMAGE_SIMD_AVX2) && defined(__F16C__)
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(pDst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pSrc + i))));
+#endif
+	for (; i < count; ++i)
+		pDst[i] = TinyImageFormat_HalfAsUintToFloat(pSrc[i]);
+}
+
+static void iConvertTask(void* pUser, uintptr_t index)
+{
+	ImageConvertJob* pJob = (ImageConvertJob*)pUser;
+	uint64_t const   first = (uint64_t)index * CONVERT_TILES_PER_TASK * CONVERT_TILE_PIXELS;
+	uint64_t const   last = min(first + (uint64_t)CONVERT_TILES_PER_TASK * CONVERT_TILE_PIXELS, pJob->mPixelCount);
+
+	float* pScratch = NULL;
+	if (pJob->mPath == IMAGE_CONVERT_GENERIC)
+		pScratch = (float*)conf_malloc(sizeof(float) * 4 * CONVERT_TILE_PIXELS);
+
+	for (uint64_t tile = first; tile < last; tile += CONVERT_TILE_PIXELS)
+	{
+		uint32_t const count = (uint32_t)min((uint64_t)CONVERT_TILE_PIXELS, last - tile);
+		// tiles start on a multiple of 8 pixels so the offsets are whole bytes for any bit size
+		const uint8_t* pSrc = pJob->pSrc + tile * pJob->mSrcBits / 8;
+		uint8_t*       pDst = pJob->pDst + tile * pJob->mDstBits / 8;
+
+		switch (pJob->mPath)
+		{
+			case IMAGE_CONVERT_SWIZZLE_RB:
+				iSwizzleRB((uint32_t*)pDst, (const uint32_t*)pSrc, count);
+				break;
+			case IMAGE_CONVERT_BYTE_LUT:
+			{
+				uint32_t const channelCount = pJob->mChannelCount;
+				uint32_t const colorChannels = channelCount == 4 ? 3 : channelCount;
+				for (uint32_t i = 0; i < count; ++i, pSrc += channelCount, pDst += channelCount)
+				{
+					for (uint32_t c = 0; c < colorChannels; ++c)
+						pDst[c] = pJob->mLut[pSrc[c]];
+					if (channelCount == 4)
+						pDst[3] = pSrc[3];
+				}
+				break;
+			}
+			case IMAGE_CONVERT_HALF_TO_FLOAT:
+				iHalfToFloat((float*)pDst, (const uint16_t*)pSrc, count * pJob->mChannelCount);
+				break;
+			case IMAGE_CONVERT_FLOAT_TO_HALF:
+			{
+				const float* pIn = (const float*)pSrc;
+				uint16_t*    pOut = (uint16_t*)pDst;
+				for (uint32_t i = 0; i < count * pJob->mChannelCount; ++i)
+					pOut[i] = TinyImageFormat_FloatToHalfAsUint(pIn[i]);
+				break;
+			}
+			default:
+				iDecodeRow(&pJob->mDecodeCodec, pSrc, count, pScratch);
+				iEncodeRow(&pJob->mEncodeCodec, pScratch, count, pDst);
+				break;
+		}
+	}
+
+	if (pScratch)
+		conf_free(pScratch);
+}
+
+//------------------------------------------------------------------------------
+// Block compression
+//------------------------------------------------------------------------------
+// Block rows encoded per task
+#define COMPRESS_BAND_BLOCK_ROWS 4
+// Endpoint refinement passes of the BC1 / BC7 encoders
+#define COMPRESS_REFINE_PASSES 2
+
+static const uint32_t gBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static bool iCanEncodeBlockFormat(TinyImageFormat fmt)
+{
+	switch (fmt)
+	{
+		case TinyImageFormat_DXBC1_RGB_UNORM:
+		case TinyImageFormat_DXBC1_RGB_SRGB:
+		case TinyImageFormat_DXBC1_RGBA_UNORM:
+		case TinyImageFormat_DXBC1_RGBA_SRGB:
+		case TinyImageFormat_DXBC3_UNORM:
+		case TinyImageFormat_DXBC3_SRGB:
+		case TinyImageFormat_DXBC4_UNORM:
+		case TinyImageFormat_DXBC5_UNORM:
+		case TinyImageFormat_DXBC7_UNORM:
+		case TinyImageFormat_DXBC7_SRGB: return true;
+		default: return false;
+	}
+}
+
+// Writes the index of the closest palette entry for each of the 16 pixels. Palettes are stored
+// per channel and padded to a multiple of 4 entries with values that are never picked.
+static void iSelectBlockIndices(const float (*pPixels)[4], const float (*pPalette)[16], uint32_t paletteCount, uint8_t* pOutIndices)
+{
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const float* p = pPixels[i];
+		float        bestError = FLT_MAX;
+		uint32_t     best = 0;
+#if defined(IMAGE_SIMD_SSE2)
+		__m128 const r = _mm_set1_ps(p[0]);
+		__m128 const g = _mm_set1_ps(p[1]);
+		__m128 const b = _mm_set1_ps(p[2]);
+		__m128 const a = _mm_set1_ps(p[3]);
+		for (uint32_t e = 0; e < paletteCount; e += 4)
+		{
+			__m128 dr = _mm_sub_ps(_mm_loadu_ps(pPalette[0] + e), r);
+			__m128 dg = _mm_sub_ps(_mm_loadu_ps(pPalette[1] + e), g);
+			__m128 db = _mm_sub_ps(_mm_loadu_ps(pPalette[2] + e), b);
+			__m128 da = _mm_sub_ps(_mm_loadu_ps(pPalette[3] + e), a);
+			__m128 error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+			float errors[4];
+			_mm_storeu_ps(errors, error);
+			for (uint32_t k = 0; k < 4; ++k)
+			{
+				if (errors[k] < bestError)
+				{
+					bestError = errors[k];
+					best = e + k;
+				}
+			}
+		}
+#else
+		for (uint32_t e = 0; e < paletteCount; ++e)
+		{
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+				error += (pPalette[c][e] - p[c]) * (pPalette[c][e] - p[c]);
+			if (error < bestError)
+			{
+				bestError = error;
+				best = e;
+			}
+		}
+#endif
+		pOutIndices[i] = (uint8_t)best;
+	}
+}
+
+// Fits a line through the block colors (the first channelCount channels) by power iteration on the
+// covariance matrix and returns the extreme points of the projected pixels. Pixels with a zero weight are ignored.
+static void iFitBlockEndpoints(const float (*pPixels)[4], const float* pWeights, uint32_t channelCount, float* pOutE0, float* pOutE1)
+{
+	float mean[4] = {};
+	float totalWeight = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < channelCount; ++c)
+			mean[c] += pWeights[i] * pPixels[i][c];
+		totalWeight += pWeights[i];
+	}
+	for (uint32_t c = 0; c < channelCount; ++c)
+		mean[c] /= totalWeight;
+
+	float cov[4][4] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float d[4] = {};
+		for (uint32_t c = 0; c < channelCount; ++c)
+			d[c] = pPixels[i][c] - mean[c];
+		for (uint32_t y = 0; y < channelCount; ++y)
+			for (uint32_t x = 0; x < channelCount; ++x)
+				cov[y][x] += pWeights[i] * d[y] * d[x];
+	}
+
+	// start from the row of the largest variance so the iteration can't start orthogonal to the axis
+	uint32_t maxRow = 0;
+	for (uint32_t c = 1; c < channelCount; ++c)
+		maxRow = cov[c][c] > cov[maxRow][maxRow] ? c : maxRow;
+	float axis[4] = {};
+	for (uint32_t c = 0; c < channelCount; ++c)
+		axis[c] = cov[maxRow][c];
+
+	for (uint32_t iteration = 0; iteration < 8; ++iteration)
 	{
-		for (int i = 0; i < (int)gImageLoaderCount; i++)
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t y = 0; y < channelCount; ++y)
 		{
-			if (stricmp(extensionComponent.buffer, gImageLoaders[i].mExtension) == 0)
-			{
-				loaderIndex = i;
-				break;
-			}
+			for (uint32_t x = 0; x < channelCount; ++x)
+				next[y] += cov[y][x] * axis[x];
+			length = max(length, fabsf(next[y]));
 		}
+		if (length < 1e-6f)
+			break;
+		for (uint32_t c = 0; c < channelCount; ++c)
+			axis[c] = next[c] / length;
+	}
 
-    if (loaderIndex == -1)
-    {
-       extensionComponent.buffer = NULL;
-       extensionComponent.length = 0;
-    }
+	float lengthSq = 0.0f;
+	for (uint32_t c = 0; c < channelCount; ++c)
+		lengthSq += axis[c] * axis[c];
+
+	float tMin = 0.0f;
+	float tMax = 0.0f;
+	if (lengthSq > 1e-12f)
+	{
+		tMin = FLT_MAX;
+		tMax = -FLT_MAX;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			if (pWeights[i] == 0.0f)
+				continue;
+			float t = 0.0f;
+			for (uint32_t c = 0; c < channelCount; ++c)
+				t += (pPixels[i][c] - mean[c]) * axis[c];
+			t /= lengthSq;
+			tMin = min(tMin, t);
+			tMax = max(tMax, t);
+		}
 	}
 
-    const char *extension;
-    
-    PathHandle loadFilePath = NULL;
-	// For loading basis file, it should have its extension
-	if (extensionComponent.length == 0)
+	for (uint32_t c = 0; c < 4; ++c)
 	{
-#if defined(__ANDROID__)
-		extension = "ktx";
-#elif defined(TARGET_IOS)
-		extension = "ktx";
-#elif defined(__linux__)
-		extension = "dds";
-#elif defined(__APPLE__)
-		extension = "dds";
-#else
-		extension = "dds";
-#endif
+		pOutE0[c] = c < channelCount ? mean[c] + tMin * axis[c] : 0.0f;
+		pOutE1[c] = c < channelCount ? mean[c] + tMax * axis[c] : 0.0f;
+	}
+}
 
-        loadFilePath = fsAppendPathExtension(filePath, extension);
-    } else {
-        extension = extensionComponent.buffer;
-        loadFilePath = fsCopyPath(filePath);
-    }
-		
-    FileStream* fh = fsOpenFile(loadFilePath, FM_READ_BINARY);
-	
-	if (!fh)
+// Least squares endpoints for the interpolation factors pT chosen by the last index selection.
+// Returns false if the system is degenerate, which keeps the current endpoints.
+static bool iRefineBlockEndpoints(
+	const float (*pPixels)[4], const float* pT, const float* pWeights, uint32_t channelCount, float* pE0, float* pE1)
+{
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	float x[4] = {}, y[4] = {};
+	for (uint32_t i = 0; i < 16; ++i)
 	{
-		LOGF(LogLevel::eERROR, "\"%s\": Image file not found.", fsGetPathAsNativeString(loadFilePath));
+		float const w = pWeights[i];
+		float const t = pT[i];
+		float const s = 1.0f - t;
+		a += w * s * s;
+		b += w * s * t;
+		c += w * t * t;
+		for (uint32_t ch = 0; ch < channelCount; ++ch)
+		{
+			x[ch] += w * s * pPixels[i][ch];
+			y[ch] += w * t * pPixels[i][ch];
+		}
+	}
+
+	float const det = a * c - b * b;
+	if (fabsf(det) < 1e-6f)
 		return false;
+
+	for (uint32_t ch = 0; ch < channelCount; ++ch)
+	{
+		pE0[ch] = clamp((c * x[ch] - b * y[ch]) / det, 0.0f, 255.0f);
+		pE1[ch] = clamp((a * y[ch] - b * x[ch]) / det, 0.0f, 255.0f);
 	}
-	
-	// load file into memory
-	
-    ssize_t length = fsGetStreamFileSize(fh);
-	if (length <= 0)
+	return true;
+}
+
+static inline uint16_t iPack565(const float* c)
+{
+	uint32_t const r = (uint32_t)(clamp(c[0], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	uint32_t const g = (uint32_t)(clamp(c[1], 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+	uint32_t const b = (uint32_t)(clamp(c[2], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static inline void iUnpack565(uint16_t c, uint32_t* pOut)
+{
+	uint32_t const r = (c >> 11) & 0x1F;
+	uint32_t const g = (c >> 5) & 0x3F;
+	uint32_t const b = c & 0x1F;
+	pOut[0] = (r << 3) | (r >> 2);
+	pOut[1] = (g << 2) | (g >> 4);
+	pOut[2] = (b << 3) | (b >> 2);
+}
+
+// Builds the palette of a BC1 block as decoded by the GPU, the transparent entry is never matched
+static void iGetBC1Palette(uint16_t c0, uint16_t c1, float (*pOutPalette)[16], float* pOutT)
+{
+	uint32_t e0[3], e1[3];
+	iUnpack565(c0, e0);
+	iUnpack565(c1, e1);
+	bool const fourColors = c0 > c1;
+	for (uint32_t ch = 0; ch < 3; ++ch)
 	{
-		LOGF(LogLevel::eERROR, "\"%s\": Image is an empty file.", fsGetPathAsNativeString(loadFilePath));
-        fsCloseStream(fh);
-		return false;
+		pOutPalette[ch][0] = (float)e0[ch];
+		pOutPalette[ch][1] = (float)e1[ch];
+		pOutPalette[ch][2] = (float)(fourColors ? (2 * e0[ch] + e1[ch]) / 3 : (e0[ch] + e1[ch]) / 2);
+		pOutPalette[ch][3] = fourColors ? (float)((e0[ch] + 2 * e1[ch]) / 3) : 1e18f;
 	}
-	
-	// read and close file.
-	char* data = (char*)conf_malloc(length * sizeof(char));
-    fsReadFromStream(fh, data, length);
-    fsCloseStream(fh);
+	pOutPalette[3][0] = pOutPalette[3][1] = pOutPalette[3][2] = pOutPalette[3][3] = 0.0f;
 
-	// try loading the format
-	bool loaded = false;
-	bool support = false;
-	for (int i = 0; i < (int)gImageLoaderCount; i++)
+	pOutT[0] = 0.0f;
+	pOutT[1] = 1.0f;
+	pOutT[2] = fourColors ? 1.0f / 3.0f : 0.5f;
+	pOutT[3] = fourColors ? 2.0f / 3.0f : 1.0f;
+}
+
+// pPixels holds 16 RGBA pixels in [0, 255]. With punchThroughAlpha pixels with alpha below 128 are
+// encoded transparent using the three color mode.
+static void iEncodeBC1Block(const float (*pPixels)[4], bool punchThroughAlpha, uint8_t* pOut)
+{
+	float    colors[16][4];
+	float    weights[16];
+	bool     transparent[16];
+	uint32_t opaqueCount = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		transparent[i] = punchThroughAlpha && pPixels[i][3] < 127.5f;
+		weights[i] = transparent[i] ? 0.0f : 1.0f;
+		opaqueCount += transparent[i] ? 0 : 1;
+		colors[i][0] = pPixels[i][0];
+		colors[i][1] = pPixels[i][1];
+		colors[i][2] = pPixels[i][2];
+		colors[i][3] = 0.0f;
+	}
+	bool const threeColors = opaqueCount < 16;
+
+	uint16_t c0 = 0;
+	uint16_t c1 = 0;
+	uint8_t  indices[16] = {};
+	if (opaqueCount > 0)
 	{
-		if (stricmp(extension, gImageLoaders[i].mExtension) == 0)
+		float e0[4], e1[4];
+		iFitBlockEndpoints(colors, weights, 3, e0, e1);
+
+		for (uint32_t pass = 0; pass <= COMPRESS_REFINE_PASSES; ++pass)
 		{
-			support = true;
-			loaded = gImageLoaders[i].pLoader(this, data, (uint32_t)length, pAllocator, pUserData);
-			if (loaded)
+			c0 = iPack565(e0);
+			c1 = iPack565(e1);
+			// the endpoint order selects the mode
+			if ((c0 < c1) != threeColors && c0 != c1)
 			{
-				break;
+				uint16_t const c = c0;
+				c0 = c1;
+				c1 = c;
+				for (uint32_t ch = 0; ch < 3; ++ch)
+				{
+					float const e = e0[ch];
+					e0[ch] = e1[ch];
+					e1[ch] = e;
+				}
 			}
+
+			float palette[4][16];
+			float paletteT[4];
+			iGetBC1Palette(c0, c1, palette, paletteT);
+			// with equal endpoints the block decodes in three color mode, index 3 would be black
+			uint32_t const paletteCount = c0 == c1 ? 1 : 4;
+			for (uint32_t e = paletteCount; e < 4; ++e)
+				palette[0][e] = palette[1][e] = palette[2][e] = 1e18f;
+			iSelectBlockIndices(colors, palette, 4, indices);
+
+			if (pass == COMPRESS_REFINE_PASSES)
+				break;
+
+			float t[16];
+			for (uint32_t i = 0; i < 16; ++i)
+				t[i] = paletteT[indices[i]];
+			if (!iRefineBlockEndpoints(colors, t, weights, 3, e0, e1))
+				break;
 		}
 	}
-	if (!support)
-	{
-		LOGF(LogLevel::eERROR, "Can't load this file format for image  :  %s", fsGetPathAsNativeString(loadFilePath));
-	}
 	else
 	{
-		mLoadFilePath = loadFilePath;
+		c0 = c1 = 0;
 	}
-	// cleanup the compressed data
-	conf_free(data);
 
-	return loaded;
+	uint32_t indexBits = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+		indexBits |= (uint32_t)(transparent[i] ? 3 : indices[i]) << (2 * i);
+
+	pOut[0] = (uint8_t)(c0 & 0xFF);
+	pOut[1] = (uint8_t)(c0 >> 8);
+	pOut[2] = (uint8_t)(c1 & 0xFF);
+	pOut[3] = (uint8_t)(c1 >> 8);
+	memcpy(pOut + 4, &indexBits, sizeof(indexBits));
 }
 
-bool Image::Convert(const TinyImageFormat newFormat)
+// Single channel block in the eight value mode, used for BC3 alpha, BC4 and BC5
+static void iEncodeBC4Block(const float (*pPixels)[4], uint32_t channel, uint8_t* pOut)
 {
-	// TODO add RGBE8 to tiny image format
-	if(!TinyImageFormat_CanDecodeLogicalPixelsF(mFormat)) return false;
-	if(!TinyImageFormat_CanEncodeLogicalPixelsF(newFormat)) return false;
+	float minValue = 255.0f;
+	float maxValue = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		minValue = min(minValue, pPixels[i][channel]);
+		maxValue = max(maxValue, pPixels[i][channel]);
+	}
+
+	uint32_t const a0 = (uint32_t)(clamp(maxValue, 0.0f, 255.0f) + 0.5f);
+	uint32_t const a1 = (uint32_t)(clamp(minValue, 0.0f, 255.0f) + 0.5f);
+
+	uint64_t bits = (uint64_t)a0 | ((uint64_t)a1 << 8);
+	if (a0 > a1)
+	{
+		// palette order is a0, a1 then six steps from a0 towards a1
+		static const uint8_t stepToIndex[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+		float const           scale = 7.0f / (float)(a0 - a1);
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			float const    v = clamp(pPixels[i][channel], (float)a1, (float)a0);
+			uint32_t const step = (uint32_t)(((float)a0 - v) * scale + 0.5f);
+			bits |= (uint64_t)stepToIndex[min(step, 7U)] << (16 + 3 * i);
+		}
+	}
+	memcpy(pOut, &bits, sizeof(bits));
+}
 
-	int pixelCount = GetNumberOfPixels(0, mMipMapCount);
+static void iWriteBlockBits(uint8_t* pOut, uint32_t* pBit, uint32_t value, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i, ++*pBit)
+	{
+		if ((value >> i) & 1)
+			pOut[*pBit >> 3] |= (uint8_t)(1 << (*pBit & 7));
+	}
+}
 
-	ubyte* newPixels;
-	newPixels = (unsigned char*)conf_malloc(sizeof(unsigned char) * GetMipMappedSize(0, mMipMapCount));
+// Quantizes an endpoint to 7 bits per channel plus the shared p bit with the smaller error
+static void iQuantizeBC7Endpoint(const float* e, uint32_t* pOutValues, uint32_t* pOutPBit)
+{
+	float bestError = FLT_MAX;
+	for (uint32_t p = 0; p < 2; ++p)
+	{
+		uint32_t values[4];
+		float    error = 0.0f;
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			float const q = clamp((e[c] - (float)p) * 0.5f + 0.5f, 0.0f, 127.0f);
+			values[c] = (uint32_t)q;
+			float const d = (float)((values[c] << 1) | p) - e[c];
+			error += d * d;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			*pOutPBit = p;
+			memcpy(pOutValues, values, sizeof(values));
+		}
+	}
+}
 
-	TinyImageFormat_DecodeInput input{};
-	input.pixel = pData;
-	TinyImageFormat_EncodeOutput output{};
-	output.pixel = newPixels;
+// BC7 mode 6: one subset, RGBA endpoints and 4 bit indices
+static void iEncodeBC7Block(const float (*pPixels)[4], uint8_t* pOut)
+{
+	static const float weights[16] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+									   1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+	float e0[4], e1[4];
+	iFitBlockEndpoints(pPixels, weights, 4, e0, e1);
+
+	uint32_t q0[4], q1[4], p0 = 0, p1 = 0;
+	uint8_t  indices[16];
+	for (uint32_t pass = 0; pass <= COMPRESS_REFINE_PASSES; ++pass)
+	{
+		iQuantizeBC7Endpoint(e0, q0, &p0);
+		iQuantizeBC7Endpoint(e1, q1, &p1);
 
-	float* tmp = (float*)conf_malloc(sizeof(float) * 4 * pixelCount);
+		float palette[4][16];
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			uint32_t const v0 = (q0[c] << 1) | p0;
+			uint32_t const v1 = (q1[c] << 1) | p1;
+			for (uint32_t e = 0; e < 16; ++e)
+				palette[c][e] = (float)(((64 - gBC7Weights4[e]) * v0 + gBC7Weights4[e] * v1 + 32) >> 6);
+		}
+		iSelectBlockIndices(pPixels, palette, 16, indices);
 
-	TinyImageFormat_DecodeLogicalPixelsF(mFormat, &input, pixelCount, tmp);
-	TinyImageFormat_EncodeLogicalPixelsF(newFormat, tmp, pixelCount, &output);
+		if (pass == COMPRESS_REFINE_PASSES)
+			break;
 
-	conf_free(tmp);
+		float t[16];
+		for (uint32_t i = 0; i < 16; ++i)
+			t[i] = gBC7Weights4[indices[i]] / 64.0f;
+		if (!iRefineBlockEndpoints(pPixels, t, weights, 4, e0, e1))
+			break;
+	}
 
-	conf_free(pData);
-	pData = newPixels;
-	mFormat = newFormat;
+	// the anchor index is stored without its top bit
+	if (indices[0] & 8)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			uint32_t const q = q0[c];
+			q0[c] = q1[c];
+			q1[c] = q;
+		}
+		uint32_t const p = p0;
+		p0 = p1;
+		p1 = p;
+		for (uint32_t i = 0; i < 16; ++i)
+			indices[i] = (uint8_t)(15 - indices[i]);
+	}
 
-	return true;
+	memset(pOut, 0, 16);
+	uint32_t bit = 0;
+	iWriteBlockBits(pOut, &bit, 1 << 6, 7);
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		iWriteBlockBits(pOut, &bit, q0[c], 7);
+		iWriteBlockBits(pOut, &bit, q1[c], 7);
+	}
+	iWriteBlockBits(pOut, &bit, p0, 1);
+	iWriteBlockBits(pOut, &bit, p1, 1);
+	for (uint32_t i = 0; i < 16; ++i)
+		iWriteBlockBits(pOut, &bit, indices[i], i == 0 ? 3 : 4);
 }
 
-template <typename T>
-void buildMipMap(T* dst, const T* src, const uint w, const uint h, const uint d, const uint c)
+static void iEncodeBlock(TinyImageFormat fmt, const float (*pPixels)[4], uint8_t* pOut)
 {
-	uint xOff = (w < 2) ? 0 : c;
-	uint yOff = (h < 2) ? 0 : c * w;
-	uint zOff = (d < 2) ? 0 : c * w * h;
+	switch (fmt)
+	{
+		case TinyImageFormat_DXBC1_RGB_UNORM:
+		case TinyImageFormat_DXBC1_RGB_SRGB: iEncodeBC1Block(pPixels, false, pOut); break;
+		case TinyImageFormat_DXBC1_RGBA_UNORM:
+		case TinyImageFormat_DXBC1_RGBA_SRGB: iEncodeBC1Block(pPixels, true, pOut); break;
+		case TinyImageFormat_DXBC3_UNORM:
+		case TinyImageFormat_DXBC3_SRGB:
+			iEncodeBC4Block(pPixels, 3, pOut);
+			iEncodeBC1Block(pPixels, false, pOut + 8);
+			break;
+		case TinyImageFormat_DXBC4_UNORM: iEncodeBC4Block(pPixels, 0, pOut); break;
+		case TinyImageFormat_DXBC5_UNORM:
+			iEncodeBC4Block(pPixels, 0, pOut);
+			iEncodeBC4Block(pPixels, 1, pOut + 8);
+			break;
+		case TinyImageFormat_DXBC7_UNORM:
+		case TinyImageFormat_DXBC7_SRGB: iEncodeBC7Block(pPixels, pOut); break;
+		default: ASSERT(false); break;
+	}
+}
 
-	for (uint z = 0; z < d; z += 2)
+// One 2D surface: a depth slice of one layer of one mip level
+typedef struct ImageCompressSurface
+{
+	const uint8_t* pSrc;
+	uint8_t*       pDst;
+	uint32_t       mWidth;
+	uint32_t       mHeight;
+	uint32_t       mFirstTask;
+} ImageCompressSurface;
+
+typedef struct ImageCompressJob
+{
+	ImageCompressSurface* pSurfaces;
+	uint32_t              mSurfaceCount;
+	TinyImageFormat       mDstFormat;
+	uint32_t              mSrcBits;
+	uint32_t              mBlockBytes;
+	ImageRowCodec         mDecodeCodec;
+	ImageRowCodec         mEncodeCodec;
+} ImageCompressJob;
+
+static void iCompressBandTask(void* pUser, uintptr_t index)
+{
+	ImageCompressJob* pJob = (ImageCompressJob*)pUser;
+	uint32_t          surfaceIndex = 0;
+	while (surfaceIndex + 1 < pJob->mSurfaceCount && pJob->pSurfaces[surfaceIndex + 1].mFirstTask <= index)
+		++surfaceIndex;
+	const ImageCompressSurface* pSurface = &pJob->pSurfaces[surfaceIndex];
+
+	uint32_t const width = pSurface->mWidth;
+	uint32_t const height = pSurface->mHeight;
+	uint32_t const blocksX = (width + 3) / 4;
+	uint32_t const blocksY = (height + 3) / 4;
+	uint32_t const firstBlockRow = ((uint32_t)index - pSurface->mFirstTask) * COMPRESS_BAND_BLOCK_ROWS;
+	uint32_t const lastBlockRow = min(firstBlockRow + COMPRESS_BAND_BLOCK_ROWS, blocksY);
+	uint64_t const srcRowPitch = (uint64_t)width * pJob->mSrcBits / 8;
+
+	// four rows of pixels, quantized to 8 bit through the encode codec so sRGB targets get sRGB values
+	float*   pRows = (float*)conf_malloc(sizeof(float) * 4 * width * 4);
+	uint8_t* pRowBytes = (uint8_t*)conf_malloc(4 * width * 4);
+
+	for (uint32_t by = firstBlockRow; by < lastBlockRow; ++by)
 	{
-		for (uint y = 0; y < h; y += 2)
+		for (uint32_t r = 0; r < 4; ++r)
+		{
+			// edge blocks repeat the last row
+			uint32_t const y = min(by * 4 + r, height - 1);
+			float*         pRow = pRows + r * width * 4;
+			iDecodeRow(&pJob->mDecodeCodec, pSurface->pSrc + y * srcRowPitch, width, pRow);
+			iEncodeRow(&pJob->mEncodeCodec, pRow, width, pRowBytes + r * width * 4);
+		}
+
+		uint8_t* pDst = pSurface->pDst + (uint64_t)by * blocksX * pJob->mBlockBytes;
+		for (uint32_t bx = 0; bx < blocksX; ++bx, pDst += pJob->mBlockBytes)
 		{
-			for (uint x = 0; x < w; x += 2)
+			float block[16][4];
+			for (uint32_t i = 0; i < 16; ++i)
 			{
-				for (uint i = 0; i < c; i++)
-				{
-					*dst++ = (src[0] + src[xOff] + src[yOff] + src[yOff + xOff] + src[zOff] + src[zOff + xOff] + src[zOff + yOff] +
-							  src[zOff + yOff + xOff]) /
-							 8;
-					src++;
-				}
-				src += xOff;
+				uint32_t const x = min(bx * 4 + (i & 3), width - 1);
+				const uint8_t* pPixel = pRowBytes + ((i >> 2) * width + x) * 4;
+				for (uint32_t c = 0; c < 4; ++c)
+					block[i][c] = (float)pPixel[c];
 			}
-			src += yOff;
+			iEncodeBlock(pJob->mDstFormat, block, pDst);
 		}
-		src += zOff;
 	}
+
+	conf_free(pRowBytes);
+	conf_free(pRows);
 }
 
-bool Image::GenerateMipMaps(const uint32_t mipMaps)
+// Encodes every layer and mip level of pImage into newly allocated pDst
+static bool iCompressImage(const Image* pImage, TinyImageFormat dstFormat, ThreadSystem* pThreadSystem, uint8_t* pDst)
 {
-	if (TinyImageFormat_IsCompressed(mFormat))
-		return false;
-	if (!(mWidth) || !isPowerOf2(mHeight) || !isPowerOf2(mDepth))
+	TinyImageFormat const srcFormat = pImage->GetFormat();
+
+	ImageCompressJob job = {};
+	job.mDstFormat = dstFormat;
+	job.mSrcBits = TinyImageFormat_BitSizeOfBlock(srcFormat);
+	job.mBlockBytes = TinyImageFormat_BitSizeOfBlock(dstFormat) / 8;
+	job.mDecodeCodec.mDecodeFormat = srcFormat;
+	if (!iInitRowCodec(TinyImageFormat_IsSRGB(dstFormat) ? TinyImageFormat_R8G8B8A8_SRGB : TinyImageFormat_R8G8B8A8_UNORM, false, &job.mEncodeCodec))
 		return false;
+	// sRGB to sRGB keeps the encoded values instead of a round trip through linear
+	if (TinyImageFormat_IsSRGB(srcFormat) && TinyImageFormat_IsSRGB(dstFormat) && iGetSrgbEncodeFormat(srcFormat) != TinyImageFormat_UNDEFINED)
+	{
+		job.mDecodeCodec.mDecodeFormat = iGetSrgbEncodeFormat(srcFormat);
+		job.mEncodeCodec.mDelinearize = false;
+	}
 
-	uint actualMipMaps = min(mipMaps, GetMipMapCountFromDimensions());
+	uint32_t const layerCount = pImage->GetArrayCount() * (pImage->IsCube() ? 6 : 1);
+	uint32_t       surfaceCount = 0;
+	for (uint32_t level = 0; level < pImage->GetMipMapCount(); ++level)
+		surfaceCount += layerCount * max(1U, pImage->GetDepth(level));
 
-	if (mMipMapCount != actualMipMaps)
+	job.pSurfaces = (ImageCompressSurface*)conf_malloc(surfaceCount * sizeof(ImageCompressSurface));
+	uint32_t taskCount = 0;
+	for (uint32_t level = 0; level < pImage->GetMipMapCount(); ++level)
 	{
-		int size = GetMipMappedSize(0, actualMipMaps);
-		if (mArrayCount > 1)
+		uint32_t const width = pImage->GetWidth(level);
+		uint32_t const height = pImage->GetHeight(level);
+		uint32_t const depth = max(1U, pImage->GetDepth(level));
+		uint64_t const srcSliceSize = (uint64_t)width * height * job.mSrcBits / 8;
+		uint64_t const dstSliceSize = (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * job.mBlockBytes;
+		uint32_t const bandCount = ((height + 3) / 4 + COMPRESS_BAND_BLOCK_ROWS - 1) / COMPRESS_BAND_BLOCK_ROWS;
+		for (uint32_t layer = 0; layer < layerCount; ++layer)
 		{
-			ubyte* newPixels = (ubyte*)conf_malloc(sizeof(ubyte) * size * mArrayCount);
-
-			// Copy top mipmap of all array slices to new location
-			int firstMipSize = GetMipMappedSize(0, 1);
-			int oldSize = GetMipMappedSize(0, mMipMapCount);
-
-			for (uint i = 0; i < mArrayCount; i++)
+			const uint8_t* pSrc = iGetLayerPixels(pImage, level, layer);
+			uint8_t*       pLayerDst = pDst + iGetLayerOffset(pImage, level, layer, dstFormat);
+			for (uint32_t z = 0; z < depth; ++z)
 			{
-				memcpy(newPixels + i * size, pData + i * oldSize, firstMipSize);
+				ImageCompressSurface* pSurface = &job.pSurfaces[job.mSurfaceCount++];
+				pSurface->pSrc = pSrc + z * srcSliceSize;
+				pSurface->pDst = pLayerDst + z * dstSliceSize;
+				pSurface->mWidth = width;
+				pSurface->mHeight = height;
+				pSurface->mFirstTask = taskCount;
+				taskCount += bandCount;
 			}
-
-			conf_free(pData);
-			pData = newPixels;
-		}
-		else
-		{
-			pData = (ubyte*)conf_realloc(pData, size);
 		}
-		mMipMapCount = actualMipMaps;
 	}
 
-	int nChannels = TinyImageFormat_ChannelCount(mFormat);
+	iRunImageTasks(pThreadSystem, iCompressBandTask, &job, taskCount);
+
+	conf_free(job.pSurfaces);
+	return true;
+}
 
-	int n = IsCube() ? 6 : 1;
+bool Image::Convert(const TinyImageFormat newFormat, ThreadSystem* pThreadSystem)
+{
+	// TODO add RGBE8 to tiny image format
+	if (TinyImageFormat_IsCompressed(mFormat))
+		return false;
 
-	for (uint arraySlice = 0; arraySlice < mArrayCount; arraySlice++)
+	if (TinyImageFormat_IsCompressed(newFormat))
 	{
-		ubyte* src = GetPixels(0, arraySlice);
-		ubyte* dst = GetPixels(1, arraySlice);
+		if (!iCanEncodeBlockFormat(newFormat) || !TinyImageFormat_CanDecodeLogicalPixelsF(mFormat))
+			return false;
 
-		for (uint level = 1; level < mMipMapCount; level++)
+		uint32_t const sliceCount = mMipsAfterSlices ? 1 : mArrayCount;
+		uint8_t*       pCompressed = (uint8_t*)conf_malloc((uint64_t)GetMipMappedSize(0, mMipMapCount, newFormat) * sliceCount);
+		if (!iCompressImage(this, newFormat, pThreadSystem, pCompressed))
 		{
-			int w = GetWidth(level - 1);
-			int h = GetHeight(level - 1);
-			int d = GetDepth(level - 1);
+			conf_free(pCompressed);
+			return false;
+		}
 
-			uint32_t srcSize = GetMipMappedSize(level - 1, 1) / n;
-			uint32_t dstSize = GetMipMappedSize(level, 1) / n;
+		if (mOwnsMemory)
+			conf_free(pData);
+		pData = pCompressed;
+		mOwnsMemory = true;
+		mFormat = newFormat;
+		return true;
+	}
 
-			for (int i = 0; i < n; i++)
-			{
-				// only homogoenous is supported via this method
-				// TODO use decode/encode for the others
-				// TODO check these methods work for SNORM
-				if(TinyImageFormat_IsHomogenous(mFormat)) {
-					uint32 redChanWidth = TinyImageFormat_ChannelBitWidth(mFormat, TinyImageFormat_LC_Red);
-					if (redChanWidth == 32 && TinyImageFormat_IsFloat(mFormat))
-					{
-						buildMipMap((float*)dst, (float*)src, w, h, d, nChannels);
-					}
-					else if (redChanWidth == 32)
-					{
-						buildMipMap((uint32_t*)dst, (uint32_t*)src, w, h, d, nChannels);
-					}
-					else if (redChanWidth == 16)
-					{
-						buildMipMap((uint16_t*)dst, (uint16_t*)src, w, h, d, nChannels);
-					}
-					else if (redChanWidth == 8)
-					{
-						buildMipMap((uint8_t*)dst, (uint8_t*)src, w, h, d, nChannels);
-					}
-					// TODO fall back to to be written generic downsizer
-				}
-				src += srcSize;
-				dst += dstSize;
-			}
+	if (newFormat == mFormat)
+		return true;
+
+	ImageConvertJob* pJob = (ImageConvertJob*)conf_calloc(1, sizeof(ImageConvertJob));
+	pJob->mPath = iSelectConvertPath(mFormat, newFormat, pJob);
+	if (pJob->mPath == IMAGE_CONVERT_GENERIC)
+	{
+		// only the decode half of the source codec is used
+		pJob->mDecodeCodec.mDecodeFormat = mFormat;
+		if (!TinyImageFormat_CanDecodeLogicalPixelsF(mFormat) || !iInitRowCodec(newFormat, false, &pJob->mEncodeCodec))
+		{
+			conf_free(pJob);
+			return false;
 		}
 	}
 
+	uint32_t const sliceCount = mMipsAfterSlices ? 1 : mArrayCount;
+	uint64_t const srcSize = (uint64_t)GetMipMappedSize(0, mMipMapCount) * sliceCount;
+	uint64_t const dstSize = (uint64_t)GetMipMappedSize(0, mMipMapCount, newFormat) * sliceCount;
+
+	pJob->mSrcBits = TinyImageFormat_BitSizeOfBlock(mFormat);
+	pJob->mDstBits = TinyImageFormat_BitSizeOfBlock(newFormat);
+	pJob->mPixelCount = srcSize * 8 / pJob->mSrcBits;
+	pJob->pSrc = pData;
+	// Every tile is read completely before it is written, so equally sized formats convert in place
+	pJob->pDst = (mOwnsMemory && pJob->mSrcBits == pJob->mDstBits) ? pData : (uint8_t*)conf_malloc(dstSize);
+
+	uint64_t const pixelsPerTask = (uint64_t)CONVERT_TILES_PER_TASK * CONVERT_TILE_PIXELS;
+	iRunImageTasks(pThreadSystem, iConvertTask, pJob, (uint32_t)((pJob->mPixelCount + pixelsPerTask - 1) / pixelsPerTask));
+
+	if (pJob->pDst != pData)
+	{
+		if (mOwnsMemory)
+			conf_free(pData);
+		pData = pJob->pDst;
+		mOwnsMemory = true;
+	}
+	mFormat = newFormat;
+
+	conf_free(pJob);
 	return true;
 }
 
@@ -1703,6 +4223,13 @@ bool Image::iSaveDDS(const Path* filePath) {
 		return convertAndSaveImage(*this, &Image::iSaveKTX, filePath);
 #endif
 
+	// the writer takes one contiguous block per mip level
+	if (!mMipsAfterSlices && mArrayCount > 1)
+	{
+		LOGF(LogLevel::eERROR, "DDS saving of array images needs the mips after slices layout");
+		return false;
+	}
+
     FileStream* fh = fsOpenFile(filePath, FM_WRITE_BINARY);
 
 	if (!fh)
@@ -1714,7 +4241,7 @@ bool Image::iSaveDDS(const Path* filePath) {
 	memset(mipmaps, 0, sizeof(void const*) * TINYDDS_MAX_MIPMAPLEVELS);
 
 	for (unsigned int i = 0; i < mMipMapCount; ++i) {
-		mipmapsizes[i] = (uint32_t)Image_GetMipMappedSize(mWidth, mHeight, mDepth, mMipMapCount, mFormat);
+		mipmapsizes[i] = (uint32_t)GetMipMappedSize(i, 1);
 		mipmaps[i] = GetPixels(i);
 	}
 
@@ -1748,6 +4275,13 @@ bool Image::iSaveKTX(const Path* filePath) {
 	if (fmt == TKTX_UNDEFINED)
 		return convertAndSaveImage(*this, &Image::iSaveKTX, filePath);
     
+	// the writer takes one contiguous block per mip level
+	if (!mMipsAfterSlices && mArrayCount > 1)
+	{
+		LOGF(LogLevel::eERROR, "KTX saving of array images needs the mips after slices layout");
+		return false;
+	}
+
     FileStream* fh = fsOpenFile(filePath, FM_WRITE_BINARY);
     
 	if (!fh)
@@ -1759,7 +4293,7 @@ bool Image::iSaveKTX(const Path* filePath) {
 	memset(mipmaps, 0, sizeof(void const*) * TINYKTX_MAX_MIPMAPLEVELS);
 
 	for (unsigned int i = 0; i < mMipMapCount; ++i) {
-		mipmapsizes[i] = (uint32_t)Image_GetMipMappedSize(mWidth, mHeight, mDepth, mMipMapCount, mFormat);
+		mipmapsizes[i] = (uint32_t)GetMipMappedSize(i, 1);
 		mipmaps[i] = GetPixels(i);
 	}
 
@@ -1895,22 +4429,89 @@ bool Image::iSaveJPG(const Path* filePath)
 }
 #endif
 
-bool Image::iSaveSVT(const Path* filePath, uint pageSize)
+// Upper bound for the page rows tiled in parallel before they are written out
+#define SVT_WRITE_BATCH_BYTES (32u << 20)
+
+typedef struct SVTPageTilingJob
 {
-	if (mFormat != TinyImageFormat::TinyImageFormat_R8G8B8A8_UNORM)
+	const uint8_t* pMip;
+	uint8_t*       pBatch;
+	uint32_t       mMipWidth;
+	uint32_t       mPageSize;
+	uint32_t       mPagesX;
+	uint32_t       mFirstPageRow;
+} SVTPageTilingJob;
+
+// Reorders one row of pages from linear mip rows into consecutive pages
+static void iTileSVTPageRowTask(void* pUser, uintptr_t index)
+{
+	SVTPageTilingJob* pJob = (SVTPageTilingJob*)pUser;
+	uint32_t const    pageSize = pJob->mPageSize;
+	uint64_t const    pageLineBytes = (uint64_t)pageSize * 4;
+	// Columns past the last whole page aren't stored, so source and batch rows differ in size for such widths
+	const uint8_t*    pSrc = pJob->pMip + (pJob->mFirstPageRow + index) * pageSize * pJob->mMipWidth * 4;
+	uint8_t*          pDst = pJob->pBatch + index * pJob->mPagesX * pageSize * pageLineBytes;
+
+	for (uint32_t x = 0; x < pJob->mPagesX; ++x)
 	{
-		// uncompress/convert
-		if (!Convert(TinyImageFormat::TinyImageFormat_R8G8B8A8_UNORM))
-			return false;
+		for (uint32_t y = 0; y < pageSize; ++y)
+			memcpy(pDst + (x * pageSize + y) * pageLineBytes, pSrc + (uint64_t)y * pJob->mMipWidth * 4 + x * pageLineBytes, pageLineBytes);
+	}
+}
+
+typedef struct SVTDownsampleJob
+{
+	const uint8_t* pSrc;
+	uint8_t*       pDst;
+	uint32_t       mSrcWidth;
+	uint32_t       mSrcHeight;
+	uint32_t       mDstWidth;
+	uint32_t       mDstHeight;
+} SVTDownsampleJob;
+
+// 2x2 box filter of MIPMAP_BAND_ROWS destination rows
+static void iDownsampleSVTBandTask(void* pUser, uintptr_t index)
+{
+	SVTDownsampleJob* pJob = (SVTDownsampleJob*)pUser;
+	uint32_t const    y0 = (uint32_t)index * MIPMAP_BAND_ROWS;
+	uint32_t const    y1 = min(y0 + MIPMAP_BAND_ROWS, pJob->mDstHeight);
+	uint64_t const    srcPitch = (uint64_t)pJob->mSrcWidth * 4;
+	// The destination is half the source rounded down, so an odd width drops its last column like the row clamp drops the last row
+	bool const        wideSource = pJob->mSrcWidth >= 2;
+
+	for (uint32_t y = y0; y < y1; ++y)
+	{
+		const uint8_t* pRow0 = pJob->pSrc + min(2 * y, pJob->mSrcHeight - 1) * srcPitch;
+		const uint8_t* pRow1 = pJob->pSrc + min(2 * y + 1, pJob->mSrcHeight - 1) * srcPitch;
+		uint8_t*       pDst = pJob->pDst + (uint64_t)y * pJob->mDstWidth * 4;
+		if (wideSource)
+		{
+			iDownsampleRowRGBA8(pDst, pRow0, pRow1, pJob->mDstWidth);
+			continue;
+		}
+
+		// one texel wide source
+		for (uint32_t c = 0; c < 4; ++c)
+			pDst[c] = (uint8_t)((pRow0[c] + pRow1[c] + 1) >> 1);
 	}
+}
 
-	if (mMipMapCount == 1)
+// Mip levels are produced one at a time and their pages are written as soon as they are tiled.
+// Besides the image itself at most two levels and one batch of page rows are held in memory.
+bool Image::iSaveSVT(const Path* filePath, uint pageSize, ThreadSystem* pThreadSystem)
+{
+	if (mFormat != TinyImageFormat::TinyImageFormat_R8G8B8A8_UNORM)
 	{
-		if (!GenerateMipMaps((uint)log2f((float)min(mWidth, mHeight))))
+		// uncompress/convert
+		if (!Convert(TinyImageFormat::TinyImageFormat_R8G8B8A8_UNORM, pThreadSystem))
 			return false;
 	}
 
-	const char *fileName = fsGetPathAsNativeString(filePath);
+	// Missing levels are downsampled while writing instead of growing the image
+	bool const generateMips = mMipMapCount == 1;
+	uint const mipMapCount = generateMips ? (uint)log2f((float)min(mWidth, mHeight)) : mMipMapCount;
+	if (mipMapCount < 2 || !pageSize)
+		return false;
 
 	FileStream* fh = fsOpenFile(filePath, FM_WRITE_BINARY);
 
@@ -1920,158 +4521,109 @@ bool Image::iSaveSVT(const Path* filePath, uint pageSize)
 	//TODO: SVT should support any components somepoint
 	const uint numberOfComponents = 4;
 
-	//Header
-
-	fsWriteToStream(fh, &mWidth, sizeof(uint));
-	fsWriteToStream(fh, &mHeight, sizeof(uint));
-
-	//mip count
-	fsWriteToStream(fh, &mMipMapCount, sizeof(uint));
-
-	//Page size
-	fsWriteToStream(fh, &pageSize, sizeof(uint));
-
-	//number of components
-	fsWriteToStream(fh, &numberOfComponents, sizeof(uint));
-
-	uint mipPageCount = mMipMapCount - (uint)log2f((float)pageSize);
-
-	// Allocate Pages
-	unsigned char** mipLevelPixels = (unsigned char**)conf_calloc(mMipMapCount, sizeof(unsigned char*));
-	unsigned char*** pagePixels = (unsigned char***)conf_calloc(mipPageCount + 1, sizeof(unsigned char**));
-
-	uint* mipSizes = (uint*)conf_calloc(mMipMapCount, sizeof(uint));
-
-	for (uint i = 0; i < mMipMapCount; ++i)
-	{
-		uint mipSize = (mWidth >> i) * (mHeight >> i) * numberOfComponents;
-		mipSizes[i] = mipSize;
-		mipLevelPixels[i] = (unsigned char*)conf_calloc(mipSize, sizeof(unsigned char));
-		memcpy(mipLevelPixels[i], GetPixels(i), mipSize * sizeof(unsigned char));
-	}
+	uint mipPageCount = iGetSVTPageMipCount(mipMapCount, pageSize);
+	uint pageCount = iGetSVTPageCount(mWidth, mHeight, mipPageCount, pageSize);
 
-	// Store Mip data
-	for (uint i = 0; i < mipPageCount; ++i)
+	//Header
+	uint32_t header[8] = { SVT_MAGIC, SVT_VERSION, mWidth, mHeight, mipMapCount, pageSize, numberOfComponents, pageCount };
+	bool success = fsWriteToStream(fh, header, sizeof(header)) == sizeof(header);
+
+	//Page offsets, the last two entries bound the mip tail
+	eastl::vector<uint64_t> pageOffsets(pageCount + 2);
+	uint64_t offset = sizeof(header) + pageOffsets.size() * sizeof(uint64_t);
+	for (uint i = 0; i <= pageCount; ++i, offset += pageSize * pageSize * numberOfComponents)
+		pageOffsets[i] = offset;
+	pageOffsets[pageCount + 1] = pageOffsets[pageCount];
+	for (uint i = mipPageCount; i + 1 < mipMapCount; ++i)
+		pageOffsets[pageCount + 1] += (uint64_t)(mWidth >> i) * (mHeight >> i) * numberOfComponents;
+	success = success && fsWriteToStream(fh, pageOffsets.data(), pageOffsets.size() * sizeof(uint64_t)) ==
+							 pageOffsets.size() * sizeof(uint64_t);
+
+	uint8_t* pBatch = NULL;
+	size_t   batchSize = 0;
+	uint8_t* pLevel = NULL;
+	uint8_t* pNextLevel = NULL;
+	const uint8_t* pMip = GetPixels(0);
+
+	// The last level is not part of the mip tail
+	for (uint i = 0; success && i + 1 < mipMapCount; ++i)
 	{
-		uint xOffset = mWidth >> i;
-		uint yOffset = mHeight >> i;
-
-		// width and height in tiles
-		uint tileWidth = xOffset / pageSize;
-		uint tileHeight = yOffset / pageSize;
+		uint32_t const mipWidth = mWidth >> i;
+		uint32_t const mipHeight = mHeight >> i;
 
-		uint xMipOffset = 0;
-		uint yMipOffset = 0;
-		uint pageIndex = 0;
-
-		uint rowLength = xOffset * numberOfComponents;
-
-		pagePixels[i] = (unsigned char**)conf_calloc(tileWidth * tileHeight, sizeof(unsigned char*));
-
-		for (uint j = 0; j < tileHeight; ++j)
+		if (i < mipPageCount)
 		{
-			for (uint k = 0; k < tileWidth; ++k)
+			SVTPageTilingJob tiling = {};
+			tiling.pMip = pMip;
+			tiling.mMipWidth = mipWidth;
+			tiling.mPageSize = pageSize;
+			tiling.mPagesX = mipWidth / pageSize;
+
+			uint32_t const pageRows = mipHeight / pageSize;
+			uint64_t const pageRowBytes = (uint64_t)tiling.mPagesX * pageSize * pageSize * numberOfComponents;
+			uint32_t const batchRows = max(1u, min(pageRows, (uint32_t)(SVT_WRITE_BATCH_BYTES / max(pageRowBytes, (uint64_t)1))));
+			// Rows round down differently per level, so a later level can need a larger batch
+			if (pageRowBytes * batchRows > batchSize)
 			{
-				pagePixels[i][pageIndex] = (unsigned char*)conf_calloc(pageSize * pageSize, sizeof(unsigned char) * numberOfComponents);
-
-				for (uint y = 0; y < pageSize; ++y)
-				{
-					for (uint x = 0; x < pageSize; ++x)
-					{
-						uint mipPageIndex = (y * pageSize + x) * numberOfComponents;
-						uint mipIndex = rowLength * (y + yMipOffset) + (numberOfComponents)*(x + xMipOffset);
-
-						pagePixels[i][pageIndex][mipPageIndex + 0] = mipLevelPixels[i][mipIndex + 0];
-						pagePixels[i][pageIndex][mipPageIndex + 1] = mipLevelPixels[i][mipIndex + 1];
-						pagePixels[i][pageIndex][mipPageIndex + 2] = mipLevelPixels[i][mipIndex + 2];
-						pagePixels[i][pageIndex][mipPageIndex + 3] = mipLevelPixels[i][mipIndex + 3];
-					}
-				}
-
-				xMipOffset += pageSize;
-				pageIndex += 1;
+				batchSize = (size_t)(pageRowBytes * batchRows);
+				if (pBatch)
+					conf_free(pBatch);
+				pBatch = (uint8_t*)conf_malloc(batchSize);
 			}
+			tiling.pBatch = pBatch;
 
-			xMipOffset = 0;
-			yMipOffset += pageSize;
-		}
-	}
-
-	uint mipTailPageSize = 0;
-
-	pagePixels[mipPageCount] = (unsigned char**)conf_calloc(1, sizeof(unsigned char*));
-
-	// Calculate mip tail size
-	for (uint i = mipPageCount; i < mMipMapCount - 1; ++i)
-	{
-		uint mipSize = mipSizes[i];
-		mipTailPageSize += mipSize;
-	}
-
-	pagePixels[mipPageCount][0] = (unsigned char*)conf_calloc(mipTailPageSize, sizeof(unsigned char));
-
-	// Store mip tail data
-	uint mipTailPageWrites = 0;
-	for (uint i = mipPageCount; i < mMipMapCount - 1; ++i)
-	{
-		uint mipSize = mipSizes[i];
-
-		for (uint j = 0; j < mipSize; ++j)
-		{
-			pagePixels[mipPageCount][0][mipTailPageWrites++] = mipLevelPixels[i][j];
+			for (uint32_t row = 0; success && row < pageRows; row += batchRows)
+			{
+				uint32_t const rowCount = min(batchRows, pageRows - row);
+				tiling.mFirstPageRow = row;
+				iRunImageTasks(pThreadSystem, iTileSVTPageRowTask, &tiling, rowCount);
+				size_t const batchBytes = (size_t)(pageRowBytes * rowCount);
+				success = fsWriteToStream(fh, pBatch, batchBytes) == batchBytes;
+			}
 		}
-	}
-
-	// Write mip data
-	for (uint i = 0; i < mipPageCount; ++i)
-	{
-		// width and height in tiles
-		uint mipWidth = (mWidth >> i) / pageSize;
-		uint mipHeight = (mHeight >> i) / pageSize;
-
-		for (uint j = 0; j < mipWidth * mipHeight; ++j)
+		else
 		{
-			fsWriteToStream(fh, pagePixels[i][j], pageSize * pageSize * numberOfComponents * sizeof(char));
+			// Mip tail levels are stored linearly
+			size_t const mipSize = (size_t)mipWidth * mipHeight * numberOfComponents;
+			success = fsWriteToStream(fh, pMip, mipSize) == mipSize;
 		}
-	}
-
-	// Write mip tail data
-	fsWriteToStream(fh, pagePixels[mipPageCount][0], mipTailPageSize * sizeof(char));
 
-	// free memory
-	conf_free(mipSizes);
-
-	for (uint i = 0; i < mipPageCount; ++i)
-	{
-		// width and height in tiles
-		uint mipWidth = (mWidth >> i) / pageSize;
-		uint mipHeight = (mHeight >> i) / pageSize;
-		uint pageIndex = 0;
+		if (i + 2 >= mipMapCount)
+			break;
 
-		for (uint j = 0; j < mipHeight; ++j)
+		if (!generateMips)
 		{
-			for (uint k = 0; k < mipWidth; ++k)
-			{
-				conf_free(pagePixels[i][pageIndex]);
-				pageIndex += 1;
-			}
+			pMip = GetPixels(i + 1);
+			continue;
 		}
 
-		conf_free(pagePixels[i]);
+		SVTDownsampleJob downsample = {};
+		downsample.pSrc = pMip;
+		downsample.mSrcWidth = mipWidth;
+		downsample.mSrcHeight = mipHeight;
+		downsample.mDstWidth = max(mipWidth >> 1, 1u);
+		downsample.mDstHeight = max(mipHeight >> 1, 1u);
+		// The two buffers alternate, an earlier level is always large enough for a later one
+		if (!pNextLevel)
+			pNextLevel = (uint8_t*)conf_malloc((size_t)downsample.mDstWidth * downsample.mDstHeight * numberOfComponents);
+		downsample.pDst = pNextLevel;
+		iRunImageTasks(
+			pThreadSystem, iDownsampleSVTBandTask, &downsample, (downsample.mDstHeight + MIPMAP_BAND_ROWS - 1) / MIPMAP_BAND_ROWS);
+
+		eastl::swap(pLevel, pNextLevel);
+		pMip = pLevel;
 	}
-	conf_free(pagePixels[mipPageCount][0]);
-	conf_free(pagePixels[mipPageCount]);
-	conf_free(pagePixels);
 
-	for (uint i = 0; i < mMipMapCount; ++i)
-	{
-		conf_free(mipLevelPixels[i]);
-	}
-	conf_free(mipLevelPixels);
+	if (pBatch)
+		conf_free(pBatch);
+	if (pLevel)
+		conf_free(pLevel);
+	if (pNextLevel)
+		conf_free(pNextLevel);
 
 	fsCloseStream(fh);
 
-	return true;
+	return success;
 }
 
 struct ImageSaverDefinition
@@ -32,6 +32,7 @@ static_assert(false, "Image.h can only be included by ResourceLoader.cpp and Ima
 #include "../../ThirdParty/OpenSource/tinyimageformat/tinyimageformat_base.h"
 #include "../../ThirdParty/OpenSource/tinyimageformat/tinyimageformat_query.h"
 #include "../Interfaces/IFileSystem.h"
+#include "../Interfaces/IThread.h"
 #include "../../ThirdParty/OpenSource/EASTL/string.h"
 
 #ifndef IMAGE_DISABLE_GOOGLE_BASIS
@@ -49,6 +50,74 @@ static_assert(false, "Image.h can only be included by ResourceLoader.cpp and Ima
 
 typedef void* (*memoryAllocationFunc)(class Image* pImage, uint64_t memoryRequirement, void* pUserData);
 
+struct ThreadSystem;
+
+typedef enum MipMapFilter
+{
+	MIPMAP_FILTER_BOX = 0,
+	/// Kaiser windowed sinc, 3 texel radius
+	MIPMAP_FILTER_KAISER,
+	/// Lanczos3, 3 texel radius
+	MIPMAP_FILTER_LANCZOS,
+} MipMapFilter;
+
+typedef struct MipMapGenerationDesc
+{
+	MipMapFilter  mFilter;
+	/// Filter the color channels in linear space. sRGB formats are always filtered in linear space,
+	/// this also treats the color channels of UNORM formats as sRGB encoded
+	bool          mSrgb;
+	/// When > 0 the alpha of every mip level is rescaled so the fraction of texels with
+	/// alpha above this reference matches the top level (alpha tested foliage, fences)
+	float         mAlphaCoverageReference;
+	/// Optional. Work is split over array slices, cube faces and row bands
+	ThreadSystem* pThreadSystem;
+} MipMapGenerationDesc;
+
+/// Image description read from a file header without touching the pixel data.
+/// mDepth is 1 for non volume images, cubemaps report mIsCube and six faces per array slice.
+typedef struct ImageProbeInfo
+{
+	uint32_t        mWidth;
+	uint32_t        mHeight;
+	uint32_t        mDepth;
+	uint32_t        mMipMapCount;
+	uint32_t        mArrayCount;
+	TinyImageFormat mFormat;
+	bool            mIsCube;
+} ImageProbeInfo;
+
+/// Page table of a sparse virtual texture (.svt) file. Only the table is kept in memory,
+/// pages are read from the stream on demand. Pages are ordered by mip level, then row major.
+typedef struct SVTPageReader
+{
+	FileStream* pStream;
+	/// mPageCount + 2 entries, page i is [pPageOffsets[i], pPageOffsets[i + 1]). Page mPageCount is the mip tail
+	uint64_t*   pPageOffsets;
+	Mutex       mStreamMutex;
+	uint32_t    mWidth;
+	uint32_t    mHeight;
+	uint32_t    mMipMapCount;
+	uint32_t    mPageSize;
+	uint32_t    mComponentCount;
+	/// Number of mip levels split into pages, the rest are stored in the mip tail
+	uint32_t    mPageMipCount;
+	uint32_t    mPageCount;
+} SVTPageReader;
+
+/// On-disk cache for images decoded from PNG, JPG, TGA, BMP and HDR sources. Entries are DDS
+/// files named after a hash of the source file contents, so edited sources never hit stale entries.
+typedef struct ImageCacheDesc
+{
+	const Path*   pDirectory;
+	/// Store 8 bit images BC compressed (BC1/BC3/BC4/BC5) when the dimensions are multiples of 4
+	bool          mCompress;
+	/// Optional. Used for compressing cache misses
+	ThreadSystem* pThreadSystem;
+} ImageCacheDesc;
+
+struct ImageLoaderDesc;
+
 class Image
 {
 private:
@@ -70,9 +139,15 @@ private:
     //load image
     bool LoadFromFile(
                       const Path* filePath, memoryAllocationFunc pAllocator = NULL, void* pUserData = NULL);
+    // extension can be NULL, the loader is then picked by the signature alone
     bool LoadFromMemory(
                         void const* mem, uint32_t size, char const* extension, memoryAllocationFunc pAllocator = NULL,
                         void* pUserData = NULL);
+	bool LoadCachedImage(const char* data, uint32_t size, memoryAllocationFunc pAllocator, void* pUserData);
+	// Silent counterparts of ProbeFile for LoadFromFile and LoadFromMemory sources. False if the source
+	// is missing, its format has no header probe or the header is invalid
+	static bool TryProbeFile(const Path* filePath, ImageProbeInfo* pOutInfo);
+	static bool TryProbeMemory(void const* mem, uint32_t size, char const* extension, ImageProbeInfo* pOutInfo);
 
 public:
 
@@ -124,8 +199,11 @@ public:
 	bool                 Uncompress();
 	bool                 Unpack();
 
-	bool                 Convert(const TinyImageFormat newFormat);
-	bool                 GenerateMipMaps(const uint32_t mipMaps = ALL_MIPLEVELS);
+	// Converts in cache sized tiles, on pThreadSystem when given. Uncompressed images can also be
+	// encoded to BC1, BC3, BC4, BC5 and BC7 (mode 6 only)
+	bool                 Convert(const TinyImageFormat newFormat, ThreadSystem* pThreadSystem = NULL);
+	// Defaults to a single threaded box filter when pDesc is NULL
+	bool                 GenerateMipMaps(const uint32_t mipMaps = ALL_MIPLEVELS, const MipMapGenerationDesc* pDesc = NULL);
 
 	bool                 iSwap(const int c0, const int c1);
 
@@ -137,7 +215,8 @@ public:
 	bool                 iSavePNG(const Path* filePath);
 	bool                 iSaveHDR(const Path* filePath);
 	bool                 iSaveJPG(const Path* filePath);
-	bool                 iSaveSVT(const Path* filePath, uint pageSize = 128);
+	// Streams pages to disk as they are produced, tiling and mip generation run on pThreadSystem when given
+	bool                 iSaveSVT(const Path* filePath, uint pageSize = 128, ThreadSystem* pThreadSystem = NULL);
 	bool                 Save(const Path* filePath);
 
 protected:
@@ -155,15 +234,63 @@ protected:
 	// mipmaps * (w*h*d*s) with s being constant for all mipmaps
 	bool				 mMipsAfterSlices;
 	
-	static void Init();
+	// pCanShaderReadFrom (TinyImageFormat_Count entries) limits the formats transcoding loaders pick, NULL allows all.
+	// pThreadSystem is used to spread the work of a single load.
+	// Calls may nest, every Init needs a matching Exit and the last Exit releases the loaders and shared state.
+	static void Init(const bool* pCanShaderReadFrom = NULL, ThreadSystem* pThreadSystem = NULL);
 	static void Exit();
 
 public:
 	typedef bool (*ImageLoaderFunction)(
 		Image* pImage, const char* memory, uint32_t memSize, memoryAllocationFunc pAllocator, void* pUserData);
-	static void AddImageLoader(const char* pExtension, ImageLoaderFunction pFunc);
+	// Reads only the header from pStream (positioned at the start of the file)
+	typedef bool (*ImageProbeFunction)(FileStream* pStream, ImageProbeInfo* pOutInfo);
+	// Reads pixel data from pStream straight into the pAllocator destination. Preferred by LoadFromFile
+	// as it avoids loading the whole file into memory first
+	typedef bool (*ImageStreamLoaderFunction)(
+		Image* pImage, FileStream* pStream, memoryAllocationFunc pAllocator, void* pUserData);
+	// Loaders registered later are tried first, so built-in loaders can be replaced. A file whose signature matches
+	// a built-in loader goes to the newest loader of that extension, a replacement doesn't need the signature. Call after Init
+	static void AddImageLoader(const ImageLoaderDesc* pDesc);
+	static void AddImageLoader(
+		const char* pExtension, ImageLoaderFunction pFunc, ImageProbeFunction pProbeFunc = NULL,
+		ImageStreamLoaderFunction pStreamFunc = NULL);
+	// Extension of the loader whose signature matches pHeader, NULL if none does
+	static const char* GetImageExtension(const void* pHeader, uint32_t headerSize);
+
+	// Enables the decoded image cache, NULL disables it. Not thread safe with loads in flight
+	static void SetImageCache(const ImageCacheDesc* pDesc);
+
+	// Fills pOutInfo from the file header only. Extension resolution matches LoadFromFile.
+	static bool ProbeFile(const Path* filePath, ImageProbeInfo* pOutInfo);
+
+	// Sparse virtual texture page access. The reader takes ownership of pStream, which can be a
+	// file or a read only memory stream over a mapped file, and closes it on failure
+	static bool     OpenSVT(FileStream* pStream, SVTPageReader** ppOutReader);
+	static void     CloseSVT(SVTPageReader* pReader);
+	// Index of page (x, y) of mipMapLevel, UINT32_MAX for levels in the mip tail
+	static uint32_t GetSVTPageIndex(const SVTPageReader* pReader, uint32_t mipMapLevel, uint32_t x, uint32_t y);
+	// pageIndex == mPageCount reads the mip tail. Thread safe
+	static bool     ReadSVTPage(SVTPageReader* pReader, uint32_t pageIndex, void* pDst, uint64_t dstSize);
 };
 
+/// Image loader registration. The signature decides the loader before the extension does,
+/// so files with a wrong or missing extension and memory blobs without one still load.
+typedef struct ImageLoaderDesc
+{
+	/// Without the dot, matched case insensitively
+	const char*                      pExtension;
+	Image::ImageLoaderFunction       pLoader;
+	/// Optional
+	Image::ImageProbeFunction        pProbe;
+	/// Optional
+	Image::ImageStreamLoaderFunction pStreamLoader;
+	/// Optional. mMagicSize bytes expected at mMagicOffset, which have to be within the first 32 bytes
+	const void*                      pMagic;
+	uint32_t                         mMagicSize;
+	uint32_t                         mMagicOffset;
+} ImageLoaderDesc;
+
 static inline uint32_t calculateMipMapLevels(uint32_t width, uint32_t height)
 {
 	if (width == 0 || height == 0)
@@ -179,6 +179,11 @@ bool fsCreateDirectory(const Path* directoryPath);
 /// Deletes the file at `path`. Returns true if the file was successfully deleted.
 bool fsDeleteFile(const Path* path);
 
+/// Moves the file at `sourcePath` to `destinationPath`, replacing any file that exists there. Both paths must be on the same
+/// file system. Within a directory readers see either the old file or the complete new one.
+/// Returns true if the file was successfully moved.
+bool fsRenameFile(const Path* sourcePath, const Path* destinationPath);
+
 /// Returns true if a file (including directories) exists at `path`.
 bool fsFileExists(const Path* path);
 
@@ -425,6 +430,10 @@ typedef enum FileWatcherEventMask {
 /// The return value must have `fsFreeFileWatcher` called to free it.
 FileWatcher* fsCreateFileWatcher(const Path* path, FileWatcherEventMask eventMask, FileWatcherCallback callback);
 
+/// Adds the directory at `path` to `fileWatcher`, which then reports its changes with the same event mask and callback.
+/// Returns false if the directory couldn't be watched or if the platform's watchers only support a single path.
+bool fsAddFileWatcherPath(FileWatcher* fileWatcher, const Path* path);
+
 /// Invalidates and frees `fileWatcher.
 void fsFreeFileWatcher(FileWatcher* fileWatcher);
 
@@ -464,6 +473,14 @@ void fsFreeFileSystem(FileSystem* fileSystem);
 /// Returns true if the file system is read-only.
 bool fsFileSystemIsReadOnly(const FileSystem* fileSystem);
 
+/// Enables or disables caching of `fsFileExists`, `fsDirectoryExists`, `fsGetCreationTime` and `fsGetLastModifiedTime`
+/// results for `fileSystem`. Cached entries are invalidated through a FileWatcher on their parent directory.
+/// Returns false if `fileSystem` does not support metadata caching.
+///
+/// NOTE: This call is not thread-safe. It is the application's responsibility to ensure that
+/// no queries to the file system are occurring at the time of this call.
+bool fsSetFileMetadataCacheEnabled(FileSystem* fileSystem, bool enabled);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
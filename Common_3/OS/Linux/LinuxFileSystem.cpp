@@ -24,6 +24,8 @@
 
 #ifdef __linux__
 
+#include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+
 #include "../FileSystem/UnixFileSystem.h"
 #include "../Interfaces/ILog.h"
 #include "../Interfaces/IOperatingSystem.h"
@@ -60,6 +62,7 @@ struct LinuxFileSystem: public UnixFileSystem
 		bool ret = sendfile64(dest, source, 0, stat_source.st_size) != -1;
 		close(source);
 		close(dest);
+		InvalidateMetadata(destinationPath);
 		return ret;
 	}
 
@@ -201,40 +204,30 @@ void fsShowSaveFileDialog(
 
 struct FileWatcher
 {
-	Path*               mWatchDir;
-	uint32_t            mNotifyFilter;
-	FileWatcherCallback mCallback;
-	ThreadDesc          mThreadDesc;
-	ThreadHandle        mThread;
-	volatile int        mRun;
+	/// Watched directories keyed by their inotify watch descriptor. Guarded by mMutex.
+	eastl::unordered_map<int, Path*> mWatchDirs;
+	Mutex                            mMutex;
+	uint32_t                         mNotifyFilter;
+	FileWatcherCallback              mCallback;
+	ThreadDesc                       mThreadDesc;
+	ThreadHandle                     mThread;
+	int                              mNotifyFd;
+	volatile int                     mRun;
 };
 
 static void fswThreadFunc(void* data)
 {
 	FileWatcher* fs = (FileWatcher*)data;
 
-	int  fd, wd;
-	char buffer[4096];
-
-	fd = inotify_init();
-	if (fd < 0)
-	{
-		return;
-	}
+	int  fd = fs->mNotifyFd;
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
 
-	wd = inotify_add_watch(fd, fsGetPathAsNativeString(fs->mWatchDir), fs->mNotifyFilter);
-
-	if (wd < 0)
-	{
-		close(fd);
-		return;
-	}
-
-	fd_set         rfds;
-	struct timeval tv = { 0, 128 << 10 };
+	fd_set rfds;
 
 	while (fs->mRun)
 	{
+		// select may modify the timeout, so it has to be reset on every iteration.
+		struct timeval tv = { 0, 128 << 10 };
 		FD_ZERO(&rfds);
 		FD_SET(fd, &rfds);
 		int retval = select(FD_SETSIZE, &rfds, 0, 0, &tv);
@@ -257,45 +250,86 @@ static void fswThreadFunc(void* data)
 		while (offset < length)
 		{
 			struct inotify_event* event = (struct inotify_event*)(buffer + offset);
-			if (event->len)
+			offset += sizeof(struct inotify_event) + event->len;
+
+			// Copy the path out so that the callback runs without the lock held; it may add paths itself.
+			Path* path = NULL;
 			{
-				Path* path = fsAppendPathComponent(fs->mWatchDir, event->name);
-				if (event->mask & IN_MODIFY)
-				{
-					fs->mCallback(path, FWE_MODIFIED);
-				}
-				if (event->mask & (IN_ACCESS | IN_OPEN))
+				MutexLock lock(fs->mMutex);
+				eastl::unordered_map<int, Path*>::iterator it = fs->mWatchDirs.find(event->wd);
+				if (it == fs->mWatchDirs.end())
 				{
-					fs->mCallback(path, FWE_ACCESSED);
+					continue;
 				}
-				if (event->mask & (IN_MOVED_TO | IN_CREATE))
-				{
-					fs->mCallback(path, FWE_CREATED);
-				}
-				if (event->mask & (IN_MOVED_FROM | IN_DELETE))
+
+				if (event->mask & IN_IGNORED)
 				{
-					fs->mCallback(path, FWE_DELETED);
+					// The watch was removed, either explicitly or because the directory is gone.
+					fsFreePath(it->second);
+					fs->mWatchDirs.erase(it);
+					continue;
 				}
-				fsFreePath(path);
+
+				// Events without a name refer to the watched directory itself.
+				path = event->len ? fsAppendPathComponent(it->second, event->name) : fsCopyPath(it->second);
 			}
-			offset += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & (IN_MODIFY | IN_ATTRIB))
+			{
+				fs->mCallback(path, FWE_MODIFIED);
+			}
+			if (event->mask & (IN_ACCESS | IN_OPEN))
+			{
+				fs->mCallback(path, FWE_ACCESSED);
+			}
+			if (event->mask & (IN_MOVED_TO | IN_CREATE))
+			{
+				fs->mCallback(path, FWE_CREATED);
+			}
+			if (event->mask & (IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF))
+			{
+				fs->mCallback(path, FWE_DELETED);
+			}
+			if (event->mask & IN_MOVE_SELF)
+			{
+				// The watch would keep following the directory to its new location, where its events would be misreported.
+				inotify_rm_watch(fd, event->wd);
+			}
+			fsFreePath(path);
 		}
 	}
-	inotify_rm_watch(fd, wd);
-
-	close(fd);
 };
 
-FileWatcher* fsCreateFileWatcher(const Path* path, FileWatcherEventMask eventMask, FileWatcherCallback callback)
+bool fsAddFileWatcherPath(FileWatcher* fileWatcher, const Path* path)
 {
-	FileWatcher* watcher = conf_new(FileWatcher);
-	watcher->mWatchDir = fsCopyPath(path);
+	MutexLock lock(fileWatcher->mMutex);
+	int       wd = inotify_add_watch(fileWatcher->mNotifyFd, fsGetPathAsNativeString(path), fileWatcher->mNotifyFilter);
+	if (wd < 0)
+	{
+		return false;
+	}
 
+	// inotify returns the existing descriptor when a directory is added twice.
+	eastl::unordered_map<int, Path*>::iterator it = fileWatcher->mWatchDirs.find(wd);
+	if (it != fileWatcher->mWatchDirs.end())
+	{
+		fsFreePath(it->second);
+		it->second = fsCopyPath(path);
+	}
+	else
+	{
+		fileWatcher->mWatchDirs.insert(eastl::make_pair(wd, fsCopyPath(path)));
+	}
+	return true;
+}
+
+FileWatcher* fsCreateFileWatcher(const Path* path, FileWatcherEventMask eventMask, FileWatcherCallback callback)
+{
 	uint32_t notifyFilter = 0;
 
 	if (eventMask & FWE_MODIFIED)
 	{
-		notifyFilter |= IN_MODIFY;
+		notifyFilter |= IN_MODIFY | IN_ATTRIB;
 	}
 	if (eventMask & FWE_ACCESSED)
 	{
@@ -307,24 +341,49 @@ FileWatcher* fsCreateFileWatcher(const Path* path, FileWatcherEventMask eventMas
 	}
 	if (eventMask & FWE_DELETED)
 	{
-		notifyFilter |= IN_DELETE | IN_MOVED_FROM;
+		notifyFilter |= IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF;
+	}
+
+	int fd = inotify_init();
+	if (fd < 0)
+	{
+		return NULL;
 	}
 
+	FileWatcher* watcher = conf_new(FileWatcher);
+	watcher->mMutex.Init();
 	watcher->mNotifyFilter = notifyFilter;
 	watcher->mCallback = callback;
+	watcher->mNotifyFd = fd;
 	watcher->mRun = 1;
 
+	// Register the watch before returning so that no change made after this call is missed.
+	if (!fsAddFileWatcherPath(watcher, path))
+	{
+		close(fd);
+		watcher->mMutex.Destroy();
+		conf_delete(watcher);
+		return NULL;
+	}
+
 	watcher->mThreadDesc.pFunc = fswThreadFunc;
 	watcher->mThreadDesc.pData = watcher;
 
 	watcher->mThread = create_thread(&watcher->mThreadDesc);
+	return watcher;
 }
 
 void fsFreeFileWatcher(FileWatcher* fileWatcher)
 {
 	fileWatcher->mRun = 0;
-	fsFreePath(fileWatcher->mWatchDir);
 	destroy_thread(fileWatcher->mThread);
+	for (eastl::unordered_map<int, Path*>::iterator it = fileWatcher->mWatchDirs.begin(); it != fileWatcher->mWatchDirs.end(); ++it)
+	{
+		inotify_rm_watch(fileWatcher->mNotifyFd, it->first);
+		fsFreePath(it->second);
+	}
+	close(fileWatcher->mNotifyFd);
+	fileWatcher->mMutex.Destroy();
 	conf_delete(fileWatcher);
 }
 
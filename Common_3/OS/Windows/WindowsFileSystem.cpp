@@ -159,6 +159,15 @@ struct WindowsFileSystem: public FileSystem
 		return withUTF16Path<bool>(path, [](const wchar_t* pathStr) { return ::DeleteFileW(pathStr) ? true : false; });
 	}
 
+	bool RenameFile(const Path* sourcePath, const Path* destinationPath) const override
+	{
+		return withUTF16Path<bool>(sourcePath, [destinationPath](const wchar_t* source) {
+			return withUTF16Path<bool>(destinationPath, [source](const wchar_t* destination) {
+				return ::MoveFileExW(source, destination, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? true : false;
+			});
+		});
+	}
+
 	bool FileExists(const Path* path) const override
 	{
 		return withUTF16Path<bool>(path, [](const wchar_t* pathStr) {
@@ -583,4 +592,10 @@ void fsFreeFileWatcher(FileWatcher* fileWatcher)
 	conf_delete(fileWatcher);
 }
 
+bool fsAddFileWatcherPath(FileWatcher* fileWatcher, const Path* path)
+{
+	// Each watcher waits on a single directory handle.
+	return false;
+}
+
 #endif
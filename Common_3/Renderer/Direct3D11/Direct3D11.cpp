@@ -160,6 +160,7 @@ eastl::unordered_map<Cmd*, eastl::vector<CachedCmd> >         gCachedCmds;
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "version.lib")
 
 #define SAFE_FREE(p_var)  \
 	if (p_var)            \
@@ -1513,6 +1514,37 @@ void removeSampler(Renderer* pRenderer, Sampler* pSampler)
 /************************************************************************/
 // Shader Functions
 /************************************************************************/
+// Identifies the compiler compileShader uses: the version of the d3dcompiler DLL D3DCompile2 resolves to
+void getShaderCompilerVersion(Renderer* pRenderer, ShaderTarget shaderTarget, char* pVersion, uint32_t versionSize)
+{
+	UNREF_PARAM(pRenderer);
+	UNREF_PARAM(shaderTarget);
+	eastl::string version;
+	version.sprintf("fxc %u", (uint32_t)D3D_COMPILER_VERSION);
+
+	HMODULE module = NULL;
+	WCHAR   modulePath[MAX_PATH] = {};
+	DWORD   versionInfoSize = 0;
+	if (GetModuleHandleExW(
+			GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)&D3DCompile2, &module) &&
+		GetModuleFileNameW(module, modulePath, MAX_PATH) && (versionInfoSize = GetFileVersionInfoSizeW(modulePath, NULL)) != 0)
+	{
+		eastl::vector<char> versionInfo(versionInfoSize);
+		VS_FIXEDFILEINFO*   pFileInfo = NULL;
+		UINT                fileInfoSize = 0;
+		if (GetFileVersionInfoW(modulePath, 0, versionInfoSize, versionInfo.data()) &&
+			VerQueryValueW(versionInfo.data(), L"\\", (void**)&pFileInfo, &fileInfoSize) && fileInfoSize >= sizeof(VS_FIXEDFILEINFO))
+		{
+			version.append_sprintf(
+				" %u.%u.%u.%u", HIWORD(pFileInfo->dwFileVersionMS), LOWORD(pFileInfo->dwFileVersionMS),
+				HIWORD(pFileInfo->dwFileVersionLS), LOWORD(pFileInfo->dwFileVersionLS));
+		}
+	}
+
+	strncpy(pVersion, version.c_str(), versionSize);
+	pVersion[versionSize - 1] = '\0';
+}
+
 void compileShader(
 	Renderer* pRenderer, ShaderTarget shaderTarget, ShaderStage stage, const Path* filePath, uint32_t codeSize, const char* code,
 	uint32_t macroCount, ShaderMacro* pMacros, void* (*allocator)(size_t a, const char *f, int l, const char *sf), uint32_t* pByteCodeSize, char** ppByteCode, const char* pEntryPoint)
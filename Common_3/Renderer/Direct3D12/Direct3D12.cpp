@@ -208,6 +208,7 @@ const D3D12_COMMAND_QUEUE_PRIORITY gDx12QueuePriorityTranslator[QueuePriority::M
 #pragma comment(lib, "d3d12.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "version.lib")
 #endif
 
 #define SAFE_FREE(p_var)  \
@@ -3036,8 +3037,8 @@ void removeTexture(Renderer* pRenderer, Texture* pTexture)
 	if (pTexture->mRemovePageCount)
 		removeBuffer(pRenderer, pTexture->mRemovePageCount);
 
-	if (pTexture->mVirtualImageData)
-		conf_free(pTexture->mVirtualImageData);
+	if (pTexture->mVirtualPageSource.pfnRelease)
+		pTexture->mVirtualPageSource.pfnRelease(pTexture->mVirtualPageSource.pUserData);
 
 	SAFE_FREE((wchar_t*)pTexture->mDesc.pDebugName);
 	SAFE_FREE(pTexture->pDxUAVDescriptors);
@@ -3228,6 +3229,98 @@ static inline eastl::string convertBlobToString(BlobType* pBlob)
 	return eastl::string(infoLog.data());
 }
 
+#ifndef _DURANGO
+// Appends the file version of a loaded module, the same compiler DLL can ship with different SDKs and drivers
+static bool appendModuleFileVersion(HMODULE module, eastl::string* pVersion)
+{
+	WCHAR modulePath[MAX_PATH] = {};
+	if (!module || !GetModuleFileNameW(module, modulePath, MAX_PATH))
+		return false;
+
+	DWORD versionInfoSize = GetFileVersionInfoSizeW(modulePath, NULL);
+	if (!versionInfoSize)
+		return false;
+
+	eastl::vector<char> versionInfo(versionInfoSize);
+	VS_FIXEDFILEINFO*   pFileInfo = NULL;
+	UINT                fileInfoSize = 0;
+	if (!GetFileVersionInfoW(modulePath, 0, versionInfoSize, versionInfo.data()) ||
+		!VerQueryValueW(versionInfo.data(), L"\\", (void**)&pFileInfo, &fileInfoSize) || fileInfoSize < sizeof(VS_FIXEDFILEINFO))
+		return false;
+
+	pVersion->append_sprintf(
+		" %u.%u.%u.%u", HIWORD(pFileInfo->dwFileVersionMS), LOWORD(pFileInfo->dwFileVersionMS), HIWORD(pFileInfo->dwFileVersionLS),
+		LOWORD(pFileInfo->dwFileVersionLS));
+	return true;
+}
+#endif
+
+// Identifies the compiler compileShader uses for shaderTarget: DXC for shader model 6 and up, FXC below
+void getShaderCompilerVersion(Renderer* pRenderer, ShaderTarget shaderTarget, char* pVersion, uint32_t versionSize)
+{
+	UNREF_PARAM(pRenderer);
+	eastl::string version;
+#ifndef _DURANGO
+	if (shaderTarget >= shader_target_6_0)
+	{
+		version = "dxc";
+		IDxcCompiler*     pCompiler = NULL;
+		IDxcVersionInfo*  pVersionInfo = NULL;
+		IDxcVersionInfo2* pVersionInfo2 = NULL;
+		UINT32            major = 0, minor = 0, flags = 0;
+		if (SUCCEEDED(gDxcDllHelper.CreateInstance(CLSID_DxcCompiler, &pCompiler)) &&
+			SUCCEEDED(pCompiler->QueryInterface(__uuidof(IDxcVersionInfo), (void**)&pVersionInfo)) &&
+			SUCCEEDED(pVersionInfo->GetVersion(&major, &minor)) && SUCCEEDED(pVersionInfo->GetFlags(&flags)))
+		{
+			version.append_sprintf(" %u.%u flags %u", major, minor, flags);
+		}
+		else
+		{
+			version += " unknown";
+		}
+
+		// Builds of the same version differ by commit, which only newer compilers report
+		UINT32 commitCount = 0;
+		char*  pCommitHash = NULL;
+		if (pCompiler && SUCCEEDED(pCompiler->QueryInterface(__uuidof(IDxcVersionInfo2), (void**)&pVersionInfo2)) &&
+			SUCCEEDED(pVersionInfo2->GetCommitInfo(&commitCount, &pCommitHash)))
+		{
+			version.append_sprintf(" commit %u %s", commitCount, pCommitHash ? pCommitHash : "");
+			CoTaskMemFree(pCommitHash);
+		}
+		appendModuleFileVersion(GetModuleHandleW(L"dxcompiler.dll"), &version);
+
+		if (pVersionInfo2)
+			pVersionInfo2->Release();
+		if (pVersionInfo)
+			pVersionInfo->Release();
+		if (pCompiler)
+			pCompiler->Release();
+	}
+	else
+#endif
+	{
+		version = "fxc";
+#ifdef D3D_COMPILER_VERSION
+		version.append_sprintf(" %u", (uint32_t)D3D_COMPILER_VERSION);
+#endif
+#ifdef _XDK_VER
+		// The console compiler is part of the XDK
+		version.append_sprintf(" xdk %u", (uint32_t)_XDK_VER);
+#endif
+#ifndef _DURANGO
+		// The module D3DCompile resolves to, which is the DLL the import library bound
+		HMODULE module = NULL;
+		GetModuleHandleExW(
+			GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)&D3DCompile, &module);
+		appendModuleFileVersion(module, &version);
+#endif
+	}
+
+	strncpy(pVersion, version.c_str(), versionSize);
+	pVersion[versionSize - 1] = '\0';
+}
+
 void compileShader(
 	Renderer* pRenderer, ShaderTarget shaderTarget, ShaderStage stage, const Path* filePath, uint32_t codeSize, const char* code,
 	uint32_t macroCount, ShaderMacro* pMacros, void* (*allocator)(size_t a, const char *f, int l, const char *sf), uint32_t* pByteCodeSize, char** ppByteCode,
@@ -6309,15 +6402,16 @@ void fillVirtualTexture(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture, Fence
 
 		if (allocateVirtualPage(pRenderer, pTexture, *pPage))
 		{
-			void* pData = (void*)((unsigned char*)pTexture->mVirtualImageData + (pageIndex * pPage->size));
-
 			map = !pPage->pIntermediateBuffer->pCpuMappedAddress;
 			if (map)
 			{
 				mapBuffer(pRenderer, pPage->pIntermediateBuffer, NULL);
 			}
 
-			memcpy(pPage->pIntermediateBuffer->pCpuMappedAddress, pData, pPage->size);
+			// Page pixels are read straight into the staging buffer
+			const VirtualTexturePageSource* pSource = &pTexture->mVirtualPageSource;
+			if (!pSource->pfnReadPage(pSource->pUserData, pageIndex, pPage->pIntermediateBuffer->pCpuMappedAddress, pPage->size))
+				LOGF(LogLevel::eWARNING, "Failed to read virtual texture page %u", pageIndex);
 
 			
 			D3D12_TILED_RESOURCE_COORDINATE startCoord;
@@ -6406,8 +6500,6 @@ void fillVirtualTextureLevel(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture,
 		{
 			if (allocateVirtualPage(pRenderer, pTexture, *pPage))
 			{
-				void* pData = (void*)((unsigned char*)pTexture->mVirtualImageData + (pageIndex * (uint32_t)pPage->size));
-
 				//CPU to GPU
 				bool map = !pPage->pIntermediateBuffer->pCpuMappedAddress;
 				if (map)
@@ -6415,7 +6507,9 @@ void fillVirtualTextureLevel(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture,
 					mapBuffer(pRenderer, pPage->pIntermediateBuffer, NULL);
 				}
 
-				memcpy(pPage->pIntermediateBuffer->pCpuMappedAddress, pData, pPage->size);				
+				const VirtualTexturePageSource* pSource = &pTexture->mVirtualPageSource;
+				if (!pSource->pfnReadPage(pSource->pUserData, pageIndex, pPage->pIntermediateBuffer->pCpuMappedAddress, pPage->size))
+					LOGF(LogLevel::eWARNING, "Failed to read virtual texture page %u", pageIndex);
 
 				D3D12_TILED_RESOURCE_COORDINATE startCoord;
 				startCoord.X = pPage->offset.X / (uint)pTexture->mSparseVirtualTexturePageWidth;
@@ -6477,22 +6571,14 @@ void fillVirtualTextureLevel(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture,
 	tileCounts.set_capacity(0);
 }
 
-void addVirtualTexture(Renderer * pRenderer, const TextureDesc * pDesc, Texture ** ppTexture, void* pImageData)
+void addVirtualTexture(Renderer * pRenderer, const TextureDesc * pDesc, Texture ** ppTexture, const VirtualTexturePageSource* pPageSource)
 {
 	ASSERT(pRenderer);
 	Texture* pTexture = (Texture*)conf_calloc(1, sizeof(*pTexture));
 	ASSERT(pTexture);
 
-	uint32_t imageSize = 0;
-	uint32_t mipSize = pDesc->mWidth * pDesc->mHeight * pDesc->mDepth;
-	while (mipSize > 0)
-	{
-		imageSize += mipSize;
-		mipSize /= 4;
-	}
-
-	pTexture->mVirtualImageData = (char*)conf_malloc(imageSize * sizeof(uint32_t));
-	memcpy(pTexture->mVirtualImageData, pImageData, imageSize * sizeof(uint32_t));
+	ASSERT(pPageSource && pPageSource->pfnReadPage);
+	pTexture->mVirtualPageSource = *pPageSource;
 
 	// Create command buffer to transition resources to the correct state
 	Queue*   graphicsQueue = NULL;
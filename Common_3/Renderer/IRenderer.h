@@ -597,6 +597,11 @@ typedef struct TextureBarrier
 	Texture*       pTexture;
 	ResourceState  mNewState;
 	bool           mSplit;
+	/// Vulkan only. A non zero mMipLevelCount moves just these mips from mMipState to mNewState and leaves the
+	/// tracked state of the texture alone, for mips that leave it temporarily
+	uint32_t       mMipLevel;
+	uint32_t       mMipLevelCount;
+	ResourceState  mMipState;
 } TextureBarrier;
 
 typedef struct ReadRange
@@ -869,6 +874,16 @@ struct VirtualTexturePage
 	}
 };
 
+// Provides the pixels of virtual texture pages on demand so the source image never has to be resident in memory
+typedef struct VirtualTexturePageSource
+{
+	/// Writes the pixels of page pageIndex to pDst
+	bool (*pfnReadPage)(void* pUserData, uint32_t pageIndex, void* pDst, uint64_t size);
+	/// Called once the texture is removed
+	void (*pfnRelease)(void* pUserData);
+	void* pUserData;
+} VirtualTexturePageSource;
+
 typedef struct Texture
 {
 #if defined(DIRECT3D12)
@@ -948,8 +963,8 @@ typedef struct Texture
 	Buffer* mRemovePage;
 	/// the count of pages which should be removed
 	Buffer* mRemovePageCount;
-	/// Original Pixel image data
-	void* mVirtualImageData;
+	/// Source of the page pixels
+	VirtualTexturePageSource mVirtualPageSource;
 	/// Sparse Virtual Texture Width
 	uint64_t mSparseVirtualTexturePageWidth;
 	/// Sparse Virtual Texture Height
@@ -29,13 +29,21 @@
 #include "../../Xbox/Common_3/Renderer/XBoxPrivateHeaders.h"
 #endif
 
-#include "../ThirdParty/OpenSource/EASTL/deque.h"
+#include "../ThirdParty/OpenSource/EASTL/vector.h"
+#include "../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../ThirdParty/OpenSource/EASTL/unordered_set.h"
+#include "../ThirdParty/OpenSource/EASTL/heap.h"
+#include "../ThirdParty/OpenSource/EASTL/functional.h"
 
 #include "IRenderer.h"
 #include "ResourceLoader.h"
+#include "ShaderPack.h"
 #include "../OS/Interfaces/ILog.h"
 #include "../OS/Interfaces/IThread.h"
 #include "../OS/Image/Image.h"
+#include "../OS/Core/ThreadSystem.h"
+#include "../OS/Interfaces/ITime.h"
+#include "../ThirdParty/OpenSource/MicroProfile/ProfilerBase.h"
 
 //this is needed for unix as PATH_MAX is defined instead of MAX_PATH
 #ifndef _WIN32
@@ -43,7 +51,7 @@
 #ifdef __linux__
 #include <limits.h>
 #endif
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) || (defined(__linux__) && defined(VULKAN))
 #include <shaderc/shaderc.h>
 #endif
 #define MAX_PATH PATH_MAX
@@ -55,7 +63,7 @@ extern void removeBuffer(Renderer* pRenderer, Buffer* p_buffer);
 extern void mapBuffer(Renderer* pRenderer, Buffer* pBuffer, ReadRange* pRange);
 extern void unmapBuffer(Renderer* pRenderer, Buffer* pBuffer);
 extern void addTexture(Renderer* pRenderer, const TextureDesc* pDesc, Texture** pp_texture);
-extern void addVirtualTexture(Renderer* pRenderer, const TextureDesc* pDesc, Texture** ppTexture, void* pImageData);
+extern void addVirtualTexture(Renderer* pRenderer, const TextureDesc* pDesc, Texture** ppTexture, const VirtualTexturePageSource* pPageSource);
 extern void removeTexture(Renderer* pRenderer, Texture* p_texture);
 extern void cmdUpdateBuffer(Cmd* pCmd, Buffer* pBuffer, uint64_t dstOffset, Buffer* pSrcBuffer, uint64_t srcOffset, uint64_t size);
 extern void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, SubresourceDataDesc* pSubresourceDesc);
@@ -67,11 +75,19 @@ extern void updateVirtualTexture(Renderer* pRenderer, Queue* pQueue, Texture* pT
 // Internal TextureUpdateDesc
 // Used internally as to not expose Image class in the public interface
 //////////////////////////////////////////////////////////////////////////
+struct TextureStream;
+
 typedef struct TextureUpdateDescInternal
 {
 	Texture* pTexture;
 	Image*   pImage;
 	bool     mFreeImage;
+	int32_t  mPriority;
+	// Mip range to upload, 0 levels uploads every mip from mBaseMipLevel on
+	uint32_t mBaseMipLevel;
+	uint32_t mMipLevels;
+	// Progressive load the request belongs to, owns the image instead of mFreeImage
+	TextureStream* pStream;
 } TextureUpdateDescInternal;
 
 //////////////////////////////////////////////////////////////////////////
@@ -101,6 +117,10 @@ enum
 	DEFAULT_BUFFER_SIZE = 16ull<<20,
 	DEFAULT_BUFFER_COUNT = 2u,
 	DEFAULT_TIMESLICE_MS = 4u,
+	// Progressive loads upload mips up to this size in one request before the larger ones
+	MIP_TAIL_MAX_SIZE = 128u,
+	// Smallest pooled staging buffer of beginUpdateResource, pooled sizes are powers of two
+	STAGING_POOL_MIN_SIZE = 64u << 10,
 	MAX_BUFFER_COUNT = 8u,
 };
 
@@ -110,15 +130,33 @@ typedef struct CopyEngine
 	Queue*      pQueue;
 	CmdPool*    pCmdPool;
 	ResourceSet* resourceSets;
+	// Size sets get when they are recycled, the buffer of each set can still be smaller after growing
 	uint64_t    bufferSize;
 	uint64_t    allocatedSpace;
+	// Smallest piece of a pending upload that didn't fit into an empty staging buffer
+	uint64_t    requiredSpace;
 	uint32_t    bufferCount;
+	uint32_t    nodeIndex;
+	// Bytes copied into staging memory or recorded from in-place staging buffers
+	uint64_t    uploadedBytes;
 	bool        isRecording;
+	// Staging buffers handed out by beginUpdateResource, recycled once the set that copied them is idle
+	eastl::vector<Buffer*> tempBuffers[MAX_BUFFER_COUNT];
 } CopyEngine;
 
 //////////////////////////////////////////////////////////////////////////
 // Resource Loader Internal Functions
 //////////////////////////////////////////////////////////////////////////
+static void addStagingBuffer(Renderer* pRenderer, uint32_t nodeIndex, uint64_t size, Buffer** ppBuffer)
+{
+	BufferDesc bufferDesc = {};
+	bufferDesc.mSize = size;
+	bufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_ONLY;
+	bufferDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT | BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+	bufferDesc.mNodeIndex = nodeIndex;
+	addBuffer(pRenderer, &bufferDesc, ppBuffer);
+}
+
 static void setupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine, uint32_t nodeIndex, uint64_t size, uint32_t bufferCount)
 {
 	QueueDesc desc = { QUEUE_FLAG_NONE, QUEUE_PRIORITY_NORMAL, CMD_POOL_COPY, nodeIndex };
@@ -139,17 +177,15 @@ static void setupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine, uint32
 
 		addCmd(pCopyEngine->pCmdPool, false, &resourceSet.pCmd);
 
-		BufferDesc bufferDesc = {};
-		bufferDesc.mSize = size;
-		bufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_ONLY;
-		bufferDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT | BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
-		bufferDesc.mNodeIndex = nodeIndex;
-		addBuffer(pRenderer, &bufferDesc, &resourceSet.mBuffer);
+		addStagingBuffer(pRenderer, nodeIndex, size, &resourceSet.mBuffer);
 	}
 
 	pCopyEngine->bufferSize = size;
 	pCopyEngine->bufferCount = bufferCount;
+	pCopyEngine->nodeIndex = nodeIndex;
 	pCopyEngine->allocatedSpace = 0;
+	pCopyEngine->requiredSpace = 0;
+	pCopyEngine->uploadedBytes = 0;
 	pCopyEngine->isRecording = false;
 }
 
@@ -163,6 +199,10 @@ static void cleanupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine)
 		removeCmd(pCopyEngine->pCmdPool, resourceSet.pCmd);
 
 		removeFence(pRenderer, resourceSet.pFence);
+
+		for (Buffer* pBuffer : pCopyEngine->tempBuffers[i])
+			removeBuffer(pRenderer, pBuffer);
+		pCopyEngine->tempBuffers[i].clear();
 	}
 	
 	conf_free(pCopyEngine->resourceSets);
@@ -184,6 +224,22 @@ static void resetCopyEngineSet(Renderer* pRenderer, CopyEngine* pCopyEngine, siz
 	ASSERT(!pCopyEngine->isRecording);
 	pCopyEngine->allocatedSpace = 0;
 	pCopyEngine->isRecording = false;
+
+	// The set is idle after its fence was waited on, so its staging buffer can be replaced
+	ResourceSet& resourceSet = pCopyEngine->resourceSets[activeSet];
+	if (resourceSet.mBuffer->mDesc.mSize < pCopyEngine->bufferSize)
+	{
+		removeBuffer(pRenderer, resourceSet.mBuffer);
+		addStagingBuffer(pRenderer, pCopyEngine->nodeIndex, pCopyEngine->bufferSize, &resourceSet.mBuffer);
+	}
+}
+
+// Staging space left in the active set once the next allocation is aligned
+static uint64_t getStagingSpace(CopyEngine* pCopyEngine, size_t activeSet, uint64_t alignment)
+{
+	uint64_t const size = pCopyEngine->resourceSets[activeSet].mBuffer->mDesc.mSize;
+	uint64_t const offset = round_up_64(pCopyEngine->allocatedSpace, alignment);
+	return offset < size ? size - offset : 0;
 }
 
 #ifdef _DURANGO
@@ -221,7 +277,8 @@ static void streamerFlush(CopyEngine* pCopyEngine, size_t activeSet)
 	}
 }
 
-/// Return memory from pre-allocated staging buffer or create a temporary buffer if the streamer ran out of memory
+/// Return memory from the active staging buffer, or an empty range when the request doesn't fit into what is left.
+/// Uploads are split into pieces that fit, see updateBuffer and updateTexture
 static MappedMemoryRange allocateStagingMemory(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, uint64_t memoryRequirement, uint32_t alignment)
 {
 	uint64_t offset = pCopyEngine->allocatedSpace;
@@ -242,6 +299,7 @@ static MappedMemoryRange allocateStagingMemory(Renderer* pRenderer, CopyEngine*
 #endif
 		uint8_t* pDstData = (uint8_t*)buffer->pCpuMappedAddress + offset;
 		pCopyEngine->allocatedSpace = offset + memoryRequirement;
+		pCopyEngine->uploadedBytes += memoryRequirement;
 		return { pDstData, buffer, offset, memoryRequirement };
 	}
 
@@ -306,6 +364,10 @@ typedef struct UpdateRequest
 	UpdateRequest(Texture* tex) : mType(UPDATE_REQUEST_UPDATE_RESOURCE_STATE) { texture = tex; buffer = NULL; }
 	UpdateRequestType mType;
 	SyncToken mToken = 0;
+	int32_t mPriority = 0;
+	// Queue order among requests of the same priority
+	uint64_t mSequence = 0;
+	int64_t mQueueTimeUs = 0;
 	union
 	{
 		BufferUpdateDesc bufUpdateDesc;
@@ -314,12 +376,27 @@ typedef struct UpdateRequest
 	};
 } UpdateRequest;
 
+// Heap order of the request queues: higher priority first, FIFO within a priority
+static bool updateRequestPrecedes(const UpdateRequest& a, const UpdateRequest& b)
+{
+	if (a.mPriority != b.mPriority)
+		return a.mPriority < b.mPriority;
+	return a.mSequence > b.mSequence;
+}
+
 typedef struct UpdateState
 {
 	UpdateState(): UpdateState(UpdateRequest())
 	{
 	}
-	UpdateState(const UpdateRequest& request): mRequest(request), mMipLevel(0), mArrayLayer(0), mOffset({ 0, 0, 0 }), mSize(0)
+	UpdateState(const UpdateRequest& request):
+		mRequest(request),
+		mMipLevel(request.mType == UPDATE_REQUEST_UPDATE_TEXTURE ? request.texUpdateDesc.mBaseMipLevel : 0),
+		mArrayLayer(0),
+		mOffset({ 0, 0, 0 }),
+		mSize(0),
+		mPreCopyBarrier(false),
+		mMipRangeBarriers(false)
 	{
 	}
 
@@ -328,8 +405,50 @@ typedef struct UpdateState
 	uint32_t      mArrayLayer;
 	uint3         mOffset;
 	uint64_t      mSize;
+	// Texture updates: the copy destination barrier got recorded, and whether it only covers the updated mips
+	bool          mPreCopyBarrier;
+	bool          mMipRangeBarriers;
 } UpdateState;
 
+// Parsed shader include file, keyed by native path
+typedef struct ShaderIncludeNode
+{
+	time_t                       mModifiedTime;
+	uint64_t                     mContentHash[2];
+	// Native paths of the files it includes
+	eastl::vector<eastl::string> mIncludes;
+} ShaderIncludeNode;
+
+typedef struct TokenCallback
+{
+	ResourceLoadedCallback pCallback;
+	void*                  pUserData;
+	ResourceCallbackMode   mMode;
+	uint64_t               mToken;
+} TokenCallback;
+
+// Progressive texture load: the mip tail request first, then one request per larger mip
+typedef struct TextureStream
+{
+	Image*   pImage;
+	bool     mFreeImage;
+	uint32_t mTailMip;
+	// Token of every mip request below mTailMip and of the tail at mTailMip, all reserved before the stream is published
+	uint64_t mTokens[MAX_MIP_LEVELS];
+	// Requests still reading pImage plus one for the request that queues them
+	tfrg_atomic32_t mImageRefs;
+} TextureStream;
+
+// Texture loaded once for every shared TextureLoadDesc with the same file or binary data contents, creation flags, node
+// and progressive flag
+typedef struct SharedTexture
+{
+	eastl::string mKey;
+	Texture*      pTexture;
+	SyncToken     mToken;
+	uint32_t      mRefCount;
+} SharedTexture;
+
 class ResourceLoader
 {
 public:
@@ -345,14 +464,86 @@ public:
 	ConditionVariable mQueueCond;
 	Mutex mTokenMutex;
 	ConditionVariable mTokenCond;
-	eastl::deque <UpdateRequest> mRequestQueue[MAX_GPUS];
-
+	// Pending requests per node, a heap ordered by updateRequestPrecedes (mQueueMutex)
+	eastl::vector<UpdateRequest> mRequestQueue[MAX_GPUS];
+	uint64_t mRequestSequence;
+	// Tokens of texture jobs that haven't queued their upload yet, mapped to whether they got cancelled (mQueueMutex)
+	eastl::unordered_map<uint64_t, bool> mPreparingTokens;
+	// Textures their job still works on, mapped to whether they load progressively. removeResource waits on
+	// mPreparingCond until the job is done with them (mQueueMutex)
+	eastl::unordered_map<Texture*, bool> mPreparingTextures;
+	ConditionVariable mPreparingCond;
+
+	// Highest token with every token up to it completed. Textures are prepared on pThreadSystem,
+	// so tokens can complete out of order, the ones past a gap wait in mCompletedTokens (min heap, mTokenMutex)
 	tfrg_atomic64_t mTokenCompleted;
 	tfrg_atomic64_t mTokenCounter;
-
-	static void InitImageClass()
+	eastl::vector<uint64_t> mCompletedTokens;
+	// Completed tokens of requests that didn't produce their resource (mTokenMutex)
+	eastl::unordered_set<uint64_t> mFailedTokens;
+	// Callbacks waiting for their token and deferred ones waiting for processResourceCallbacks (mTokenMutex)
+	eastl::unordered_map<uint64_t, eastl::vector<TokenCallback> > mTokenCallbacks;
+	eastl::vector<TokenCallback> mDeferredCallbacks;
+
+	// Shared texture loads by key, by texture and by load token while the key is still listed (mSharedTextureMutex)
+	Mutex mSharedTextureMutex;
+	eastl::unordered_map<eastl::string, SharedTexture*> mSharedTextures;
+	eastl::unordered_map<Texture*, SharedTexture*> mSharedTextureOwners;
+	eastl::unordered_map<uint64_t, SharedTexture*> mSharedTextureTokens;
+
+	// Progressive loads by texture (mTextureStreamMutex)
+	Mutex mTextureStreamMutex;
+	eastl::unordered_map<Texture*, TextureStream*> mTextureStreams;
+
+	// Idle staging buffers for in place updates of GPU only buffers per node, at most one staging buffer size each (mStagingPoolMutex)
+	Mutex                  mStagingPoolMutex;
+	eastl::vector<Buffer*> mStagingPool[MAX_GPUS];
+	uint64_t               mStagingPoolBytes[MAX_GPUS];
+
+	// Statistics, written by the streamer thread unless noted otherwise
+	int64_t         mStartTimeUs;
+	tfrg_atomic64_t mStagingStallCount;
+	tfrg_atomic64_t mStagingStallTimeUs;
+	tfrg_atomic64_t mStagingGrowCount;
+	tfrg_atomic64_t mStagingBufferSize;
+	tfrg_atomic64_t mBytesPerSecond;
+	// Written by the texture jobs
+	tfrg_atomic64_t mDecodeTimeUs;
+	tfrg_atomic64_t mDecodeCount;
+	struct
+	{
+		tfrg_atomic64_t mUploadedBytes;
+		tfrg_atomic64_t mRequestCount;
+		tfrg_atomic64_t mRecordTimeUs;
+		tfrg_atomic64_t mFenceWaitTimeUs;
+	} mNodeStats[MAX_GPUS];
+
+	// Worker threads for texture preparation (file read, container parse, transcoding) and CPU heavy image work
+	ThreadSystem* pThreadSystem;
+
+	// Packed shader binaries, the stream is shared by all shader loads (mShaderPackMutex)
+	Mutex                          mShaderPackMutex;
+	FileStream*                    pShaderPack;
+	eastl::vector<ShaderPackEntry> mShaderPackEntries;
+
+	// Include graph of shader sources, persisted next to the shader binaries (mShaderIncludeMutex)
+	Mutex                                                mShaderIncludeMutex;
+	eastl::unordered_map<eastl::string, ShaderIncludeNode> mShaderIncludes;
+	bool                                                 mShaderIncludesDirty;
+
+	// Shader compiler version per shader target, part of every shader binary cache key (mShaderCompilerMutex)
+	Mutex                                         mShaderCompilerMutex;
+	eastl::unordered_map<uint32_t, eastl::string> mShaderCompilerVersions;
+
+	static void InitImageClass(Renderer* pRenderer, ThreadSystem* pThreadSystem)
 	{
-		Image::Init();
+		// Only these backends fill capBits, the others keep the default transcode targets
+#if defined(DIRECT3D12) || defined(VULKAN) || defined(METAL)
+		Image::Init(pRenderer->capBits.canShaderReadFrom, pThreadSystem);
+#else
+		UNREF_PARAM(pRenderer);
+		Image::Init(NULL, pThreadSystem);
+#endif
 	}
 
 	static void ExitImageClass()
@@ -397,6 +588,13 @@ public:
 		return pImage;
 	}
 
+	static bool ProbeImage(const Path* filePath, const BinaryImageData* pBinaryImageData, ImageProbeInfo* pOutInfo)
+	{
+		if (filePath)
+			return Image::TryProbeFile(filePath, pOutInfo);
+		return Image::TryProbeMemory(pBinaryImageData->pBinaryData, pBinaryImageData->mSize, pBinaryImageData->pExtension, pOutInfo);
+	}
+
 	static void DestroyImage(Image* pImage)
 	{
 		pImage->Destroy();
@@ -404,6 +602,20 @@ public:
 	}
 };
 
+// Frees the image of a texture update once no request reads it anymore
+static void releaseUpdateImage(const TextureUpdateDescInternal& desc)
+{
+	if (TextureStream* pStream = desc.pStream)
+	{
+		if (tfrg_atomic32_add_relaxed(&pStream->mImageRefs, -1) == 1 && pStream->mFreeImage)
+			ResourceLoader::DestroyImage(pStream->pImage);
+	}
+	else if (desc.mFreeImage)
+	{
+		ResourceLoader::DestroyImage(desc.pImage);
+	}
+}
+
 uint32 SplitBitsWith0(uint32 x)
 {
 	x &= 0x0000ffff;
@@ -547,11 +759,23 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 	uint32_t j = pTextureUpdate.mArrayLayer;
 	uint3 uploadOffset = pTextureUpdate.mOffset;
 
+	ResourceState const readState = util_determine_resource_start_state(pTexture->mDesc.mDescriptors);
+
 	// Only need transition for vulkan and durango since resource will auto promote to copy dest on copy queue in PC dx12
-	if (applyBarrieers && (uploadOffset.x == 0) && (uploadOffset.y == 0) && (uploadOffset.z == 0))
+	if (applyBarrieers && !pTextureUpdate.mPreCopyBarrier)
 	{
 		TextureBarrier preCopyBarrier = { pTexture, RESOURCE_STATE_COPY_DEST };
+		// Mips streamed into a texture that is already sampled move alone on Vulkan, so the resident ones stay readable
+		pTextureUpdate.mMipRangeBarriers = pRenderer->mSettings.mApi == RENDERER_API_VULKAN && texUpdateDesc.mMipLevels &&
+										   texUpdateDesc.mMipLevels < pTexture->mDesc.mMipLevels && pTexture->mCurrentState == readState;
+		if (pTextureUpdate.mMipRangeBarriers)
+		{
+			preCopyBarrier.mMipLevel = texUpdateDesc.mBaseMipLevel;
+			preCopyBarrier.mMipLevelCount = texUpdateDesc.mMipLevels;
+			preCopyBarrier.mMipState = readState;
+		}
 		cmdResourceBarrier(pCmd, 0, NULL, 1, &preCopyBarrier);
+		pTextureUpdate.mPreCopyBarrier = true;
 	}
 	Extent3D          uploadGran = pCopyEngine->pQueue->mUploadGranularity;
 
@@ -572,7 +796,8 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 	const uint3 queueGranularity = {pxPerRow, uploadGran.mHeight, uploadGran.mDepth};
 	const uint3 fullSizeDim = {img.GetWidth(), img.GetHeight(), img.GetDepth()};
 
-	for (; i < pTexture->mDesc.mMipLevels; ++i)
+	uint32_t const mipEnd = texUpdateDesc.mMipLevels ? texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels : pTexture->mDesc.mMipLevels;
+	for (; i < mipEnd; ++i)
 	{
 		uint3 const pxImageDim{ img.GetWidth(i), img.GetHeight(i), img.GetDepth(i) };
 		uint3    uploadExtent{ (pxImageDim + pxBlockDim - uint3(1)) / pxBlockDim };
@@ -586,7 +811,7 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 
 		for (; j < arrayCount; ++j)
 		{
-			uint64_t spaceAvailable{ round_down_64(pCopyEngine->bufferSize - pCopyEngine->allocatedSpace, textureRowAlignment) };
+			uint64_t spaceAvailable{ round_down_64(getStagingSpace(pCopyEngine, activeSet, textureAlignment), textureRowAlignment) };
 			uint3    uploadRectExtent{ calculateUploadRect(spaceAvailable, dstPitches, uploadOffset, uploadExtent, granularity) };
 			uint32_t uploadPitchY{ round_up(uploadRectExtent.x * dstPitches.x, textureRowAlignment) };
 			uint3    uploadPitches{ blockSize, uploadPitchY, uploadPitchY * uploadRectExtent.y };
@@ -597,6 +822,12 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 
 			if (uploadRectExtent.x == 0)
 			{
+				// Not even one granule fits into an empty buffer, ask the streamer for a bigger one
+				if (pCopyEngine->allocatedSpace == 0)
+				{
+					uint64_t const granulePitchY = round_up_64((uint64_t)granularity.x * blockSize, textureRowAlignment);
+					pCopyEngine->requiredSpace = granulePitchY * granularity.y * granularity.z + textureAlignment;
+				}
 				pTextureUpdate.mMipLevel = i;
 				pTextureUpdate.mArrayLayer = j;
 				pTextureUpdate.mOffset = uploadOffset;
@@ -677,18 +908,21 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 	// Only need transition for vulkan and durango since resource will decay to srv on graphics queue in PC dx12
 	if (applyBarrieers)
 	{
-		TextureBarrier postCopyBarrier = { pTexture, util_determine_resource_start_state(pTexture->mDesc.mDescriptors) };
+		TextureBarrier postCopyBarrier = { pTexture, readState };
+		if (pTextureUpdate.mMipRangeBarriers)
+		{
+			postCopyBarrier.mMipLevel = texUpdateDesc.mBaseMipLevel;
+			postCopyBarrier.mMipLevelCount = texUpdateDesc.mMipLevels;
+			postCopyBarrier.mMipState = RESOURCE_STATE_COPY_DEST;
+		}
 		cmdResourceBarrier(pCmd, 0, NULL, 1, &postCopyBarrier);
 	}
 	else
 	{
-		pTexture->mCurrentState = util_determine_resource_start_state(pTexture->mDesc.mDescriptors);
+		pTexture->mCurrentState = readState;
 	}
 	
-	if (texUpdateDesc.mFreeImage)
-	{
-		ResourceLoader::DestroyImage(texUpdateDesc.pImage);
-	}
+	releaseUpdateImage(texUpdateDesc);
 
 	return true;
 }
@@ -704,45 +938,63 @@ static bool updateBuffer(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t ac
 	const uint64_t bufferSize = (bufUpdateDesc.mSize > 0) ? bufUpdateDesc.mSize : pBuffer->mDesc.mSize;
 	const uint64_t alignment = pBuffer->mDesc.mDescriptors & DESCRIPTOR_TYPE_UNIFORM_BUFFER ? pRenderer->pActiveGpuSettings->mUniformBufferAlignment : 1;
 	const uint64_t offset = round_up_64(bufUpdateDesc.mDstOffset, alignment) + pBufferUpdate.mSize;
-	uint64_t       spaceAvailable = round_down_64(pCopyEngine->bufferSize - pCopyEngine->allocatedSpace, RESOURCE_BUFFER_ALIGNMENT);
-
-	if (spaceAvailable < RESOURCE_BUFFER_ALIGNMENT)
-		return false;
-
-	uint64_t dataToCopy = min(spaceAvailable, bufferSize - pBufferUpdate.mSize);
 
 #ifdef _DURANGO
-	DmaCmd* pCmd = aquireCmd(pCopyEngine, activeSet);
+	DmaCmd* pCmd = NULL;
 #else
-	Cmd* pCmd = aquireCmd(pCopyEngine, activeSet);
+	Cmd* pCmd = NULL;
 #endif
-	
-	MappedMemoryRange range = allocateStagingMemory(pRenderer, pCopyEngine, activeSet, dataToCopy, RESOURCE_BUFFER_ALIGNMENT);
 
-	// TODO: should not happed, resolve, simplify
-	//ASSERT(range.pData);
-	if (!range.pData)
-		return false;
+	if (Buffer* pSrcBuffer = bufUpdateDesc.mInternal.pSrcBuffer)
+	{
+		// Written in place after beginUpdateResource, copied as a whole and released once the set is idle
+		pCmd = aquireCmd(pCopyEngine, activeSet);
+#if defined(DIRECT3D11)
+		unmapBuffer(pRenderer, pSrcBuffer);
+#endif
+		cmdUpdateBuffer(pCmd, pBuffer, offset, pSrcBuffer, 0, bufferSize);
+		pCopyEngine->tempBuffers[activeSet].push_back(pSrcBuffer);
+		pCopyEngine->uploadedBytes += bufferSize;
+		pBufferUpdate.mSize = bufferSize;
+	}
+	else
+	{
+		uint64_t spaceAvailable = round_down_64(getStagingSpace(pCopyEngine, activeSet, RESOURCE_BUFFER_ALIGNMENT), RESOURCE_BUFFER_ALIGNMENT);
 
-	void* pSrcBufferAddress = NULL;
-	if (bufUpdateDesc.pData)
-		pSrcBufferAddress = (uint8_t*)(bufUpdateDesc.pData) + (bufUpdateDesc.mSrcOffset + pBufferUpdate.mSize);
+		if (spaceAvailable < RESOURCE_BUFFER_ALIGNMENT)
+			return false;
 
-	if (pSrcBufferAddress)
-		memcpy(range.pData, pSrcBufferAddress, dataToCopy);
-	else
-		memset(range.pData, 0, dataToCopy);
+		uint64_t dataToCopy = min(spaceAvailable, bufferSize - pBufferUpdate.mSize);
+
+		pCmd = aquireCmd(pCopyEngine, activeSet);
+
+		MappedMemoryRange range = allocateStagingMemory(pRenderer, pCopyEngine, activeSet, dataToCopy, RESOURCE_BUFFER_ALIGNMENT);
 
-	cmdUpdateBuffer(pCmd, pBuffer, offset, range.pBuffer, range.mOffset, dataToCopy);
+		// TODO: should not happed, resolve, simplify
+		//ASSERT(range.pData);
+		if (!range.pData)
+			return false;
+
+		void* pSrcBufferAddress = NULL;
+		if (bufUpdateDesc.pData)
+			pSrcBufferAddress = (uint8_t*)(bufUpdateDesc.pData) + (bufUpdateDesc.mSrcOffset + pBufferUpdate.mSize);
+
+		if (pSrcBufferAddress)
+			memcpy(range.pData, pSrcBufferAddress, dataToCopy);
+		else
+			memset(range.pData, 0, dataToCopy);
+
+		cmdUpdateBuffer(pCmd, pBuffer, offset, range.pBuffer, range.mOffset, dataToCopy);
 #if defined(DIRECT3D11)
-	unmapBuffer(pRenderer, range.pBuffer);
+		unmapBuffer(pRenderer, range.pBuffer);
 #endif
 
-	pBufferUpdate.mSize += dataToCopy;
+		pBufferUpdate.mSize += dataToCopy;
 
-	if (pBufferUpdate.mSize != bufferSize)
-	{
-		return false;
+		if (pBufferUpdate.mSize != bufferSize)
+		{
+			return false;
+		}
 	}
 
 	ResourceState state = util_determine_resource_start_state(&pBuffer->mDesc);
@@ -802,11 +1054,245 @@ static bool allQueuesEmpty(ResourceLoader* pLoader)
 	return true;
 }
 
+static SyncToken reserveToken(ResourceLoader* pLoader)
+{
+	return tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
+}
+
+static void completeTokens(ResourceLoader* pLoader, const uint64_t* pTokens, uint32_t tokenCount)
+{
+	if (!tokenCount)
+		return;
+
+	eastl::vector<TokenCallback> callbacks;
+	pLoader->mTokenMutex.Acquire();
+	for (uint32_t i = 0; i < tokenCount; ++i)
+	{
+		pLoader->mCompletedTokens.push_back(pTokens[i]);
+		eastl::push_heap(pLoader->mCompletedTokens.begin(), pLoader->mCompletedTokens.end(), eastl::greater<uint64_t>());
+
+		if (!pLoader->mTokenCallbacks.empty())
+		{
+			eastl::unordered_map<uint64_t, eastl::vector<TokenCallback> >::iterator it = pLoader->mTokenCallbacks.find(pTokens[i]);
+			if (it != pLoader->mTokenCallbacks.end())
+			{
+				for (const TokenCallback& callback : it->second)
+				{
+					if (callback.mMode == RESOURCE_CALLBACK_MODE_DEFERRED)
+						pLoader->mDeferredCallbacks.push_back(callback);
+					else
+						callbacks.push_back(callback);
+				}
+				pLoader->mTokenCallbacks.erase(it);
+			}
+		}
+	}
+	// Only written under mTokenMutex
+	uint64_t completed = tfrg_atomic64_load_relaxed(&pLoader->mTokenCompleted);
+	while (!pLoader->mCompletedTokens.empty() && pLoader->mCompletedTokens.front() == completed + 1)
+	{
+		eastl::pop_heap(pLoader->mCompletedTokens.begin(), pLoader->mCompletedTokens.end(), eastl::greater<uint64_t>());
+		pLoader->mCompletedTokens.pop_back();
+		++completed;
+	}
+	tfrg_atomic64_store_release(&pLoader->mTokenCompleted, completed);
+	pLoader->mTokenMutex.Release();
+	pLoader->mTokenCond.WakeAll();
+
+	for (const TokenCallback& callback : callbacks)
+		callback.pCallback(callback.pUserData, callback.mToken);
+}
+
+// Completes the token of a request that failed, isTokenFailed reports it from the callbacks on
+static void failToken(ResourceLoader* pLoader, uint64_t token)
+{
+	pLoader->mTokenMutex.Acquire();
+	pLoader->mFailedTokens.insert(token);
+	pLoader->mTokenMutex.Release();
+	completeTokens(pLoader, &token, 1);
+}
+
+static bool isTokenFailed(ResourceLoader* pLoader, uint64_t token)
+{
+	pLoader->mTokenMutex.Acquire();
+	bool const failed = pLoader->mFailedTokens.find(token) != pLoader->mFailedTokens.end();
+	pLoader->mTokenMutex.Release();
+	return failed;
+}
+
+// Unlike isTokenCompleted this is exact, tokens completed past a gap count as well. Caller holds mTokenMutex
+static bool isTokenDone(ResourceLoader* pLoader, uint64_t token)
+{
+	if (token <= (uint64_t)tfrg_atomic64_load_relaxed(&pLoader->mTokenCompleted))
+		return true;
+	return eastl::find(pLoader->mCompletedTokens.begin(), pLoader->mCompletedTokens.end(), token) != pLoader->mCompletedTokens.end();
+}
+
+static void waitTokenDone(ResourceLoader* pLoader, uint64_t token)
+{
+	pLoader->mTokenMutex.Acquire();
+	while (!isTokenDone(pLoader, token))
+		pLoader->mTokenCond.Wait(pLoader->mTokenMutex);
+	pLoader->mTokenMutex.Release();
+}
+
+static void addResourceCallback(
+	ResourceLoader* pLoader, SyncToken token, ResourceCallbackMode mode, ResourceLoadedCallback pCallback, void* pUserData)
+{
+	ASSERT(pCallback);
+	TokenCallback callback = { pCallback, pUserData, mode, (uint64_t)token };
+
+	pLoader->mTokenMutex.Acquire();
+	bool const done = isTokenDone(pLoader, callback.mToken);
+	if (!done)
+		pLoader->mTokenCallbacks[callback.mToken].push_back(callback);
+	else if (mode == RESOURCE_CALLBACK_MODE_DEFERRED)
+		pLoader->mDeferredCallbacks.push_back(callback);
+	pLoader->mTokenMutex.Release();
+
+	// already completed, immediate callbacks run on the caller
+	if (done && mode == RESOURCE_CALLBACK_MODE_IMMEDIATE)
+		pCallback(pUserData, token);
+}
+
+static void processResourceCallbacks(ResourceLoader* pLoader)
+{
+	eastl::vector<TokenCallback> callbacks;
+	pLoader->mTokenMutex.Acquire();
+	callbacks.swap(pLoader->mDeferredCallbacks);
+	pLoader->mTokenMutex.Release();
+
+	for (const TokenCallback& callback : callbacks)
+		callback.pCallback(callback.pUserData, callback.mToken);
+}
+
+typedef struct TokenGroup
+{
+	ResourceLoader* pLoader;
+	SyncToken       mToken;
+	tfrg_atomic64_t mRemaining;
+} TokenGroup;
+
+static void onTokenGroupMemberCompleted(void* pUserData, SyncToken)
+{
+	TokenGroup* pGroup = (TokenGroup*)pUserData;
+	if (tfrg_atomic64_add_relaxed(&pGroup->mRemaining, -1) == 1)
+	{
+		uint64_t const token = pGroup->mToken;
+		completeTokens(pGroup->pLoader, &token, 1);
+		conf_free(pGroup);
+	}
+}
+
+static SyncToken addTokenGroup(ResourceLoader* pLoader, const SyncToken* pTokens, uint32_t tokenCount)
+{
+	TokenGroup* pGroup = (TokenGroup*)conf_calloc(1, sizeof(TokenGroup));
+	pGroup->pLoader = pLoader;
+	pGroup->mToken = reserveToken(pLoader);
+	SyncToken const groupToken = pGroup->mToken;
+	// One extra reference until every member is registered, so the group can't complete halfway
+	tfrg_atomic64_store_relaxed(&pGroup->mRemaining, tokenCount + 1);
+
+	for (uint32_t i = 0; i < tokenCount; ++i)
+		addResourceCallback(pLoader, pTokens[i], RESOURCE_CALLBACK_MODE_IMMEDIATE, onTokenGroupMemberCompleted, pGroup);
+
+	onTokenGroupMemberCompleted(pGroup, groupToken);
+	return groupToken;
+}
+
+// Picks the size staging sets get when they are recycled. An upload piece that doesn't fit into an empty buffer
+// always grows it, stalls grow it by doubling up to ResourceLoaderDesc::mMaxBufferSize
+static bool growStagingBuffers(ResourceLoader* pLoader, CopyEngine* pCopyEngine, bool stalled)
+{
+	uint64_t size = pCopyEngine->bufferSize;
+	if (stalled && pLoader->mDesc.mMaxBufferSize > size)
+		size = min(size * 2, pLoader->mDesc.mMaxBufferSize);
+	if (pCopyEngine->requiredSpace > size)
+	{
+		LOGF(LogLevel::eWARNING, "Growing staging buffers to %llu bytes for an upload that doesn't fit into %llu bytes",
+			(unsigned long long)pCopyEngine->requiredSpace, (unsigned long long)size);
+		size = pCopyEngine->requiredSpace;
+	}
+	pCopyEngine->requiredSpace = 0;
+
+	if (size == pCopyEngine->bufferSize)
+		return false;
+
+	pCopyEngine->bufferSize = size;
+	uint64_t const prevSize = tfrg_atomic64_load_relaxed(&pLoader->mStagingBufferSize);
+	tfrg_atomic64_store_relaxed(&pLoader->mStagingBufferSize, max(prevSize, size));
+	return true;
+}
+
+// Pooled size for an in place update of size bytes, 0 if it is larger than the staging buffers and gets a buffer of its own
+static uint64_t getStagingPoolSize(ResourceLoader* pLoader, uint64_t size)
+{
+	uint64_t poolSize = STAGING_POOL_MIN_SIZE;
+	while (poolSize < size)
+		poolSize *= 2;
+	uint64_t const stagingSize = tfrg_atomic64_load_relaxed(&pLoader->mStagingBufferSize);
+	return poolSize <= max(stagingSize, pLoader->mDesc.mBufferSize) ? poolSize : 0;
+}
+
+static Buffer* acquireStagingBuffer(ResourceLoader* pLoader, uint32_t nodeIndex, uint64_t size)
+{
+	uint64_t const poolSize = getStagingPoolSize(pLoader, size);
+	if (poolSize)
+	{
+		pLoader->mStagingPoolMutex.Acquire();
+		eastl::vector<Buffer*>& pool = pLoader->mStagingPool[nodeIndex];
+		for (size_t i = 0; i < pool.size(); ++i)
+		{
+			Buffer* pBuffer = pool[i];
+			if (pBuffer->mDesc.mSize != poolSize)
+				continue;
+			pool[i] = pool.back();
+			pool.pop_back();
+			pLoader->mStagingPoolBytes[nodeIndex] -= poolSize;
+			pLoader->mStagingPoolMutex.Release();
+			return pBuffer;
+		}
+		pLoader->mStagingPoolMutex.Release();
+	}
+
+	Buffer* pBuffer = NULL;
+	addStagingBuffer(pLoader->pRenderer, nodeIndex, poolSize ? poolSize : size, &pBuffer);
+	return pBuffer;
+}
+
+// Staging buffers of in place updates go back to the pool once the set that copied them is idle
+static void recycleStagingBuffers(ResourceLoader* pLoader, CopyEngine* pCopyEngine, size_t activeSet)
+{
+	eastl::vector<Buffer*>& buffers = pCopyEngine->tempBuffers[activeSet];
+	if (buffers.empty())
+		return;
+
+	pLoader->mStagingPoolMutex.Acquire();
+	for (Buffer* pBuffer : buffers)
+	{
+		uint64_t const size = pBuffer->mDesc.mSize;
+		uint64_t&      poolBytes = pLoader->mStagingPoolBytes[pCopyEngine->nodeIndex];
+		if (getStagingPoolSize(pLoader, size) == size && poolBytes + size <= pCopyEngine->bufferSize)
+		{
+			pLoader->mStagingPool[pCopyEngine->nodeIndex].push_back(pBuffer);
+			poolBytes += size;
+		}
+		else
+		{
+			removeBuffer(pLoader->pRenderer, pBuffer);
+		}
+	}
+	pLoader->mStagingPoolMutex.Release();
+	buffers.clear();
+}
+
 static void streamerThreadFunc(void* pThreadData)
 {
 	ResourceLoader* pLoader = (ResourceLoader*)pThreadData;
 	ASSERT(pLoader);
 
+	ProfileOnThreadCreate("ResourceLoader");
+
 	uint32_t linkedGPUCount = pLoader->pRenderer->mLinkedNodeCount;
 	CopyEngine pCopyEngines[MAX_GPUS];
 	for (uint32_t i = 0; i < linkedGPUCount; ++i)
@@ -814,13 +1300,19 @@ static void streamerThreadFunc(void* pThreadData)
 		setupCopyEngine(pLoader->pRenderer, &pCopyEngines[i], i, pLoader->mDesc.mBufferSize, pLoader->mDesc.mBufferCount);
 	}
 
+	tfrg_atomic64_store_relaxed(&pLoader->mStagingBufferSize, pCopyEngines[0].bufferSize);
+
 	const uint32_t allUploadsCompleted = (1 << linkedGPUCount) - 1;
 	uint32_t       completionMask = allUploadsCompleted;
 	UpdateState updateState[MAX_GPUS];
 
 	unsigned nextTimeslot = getSystemTime() + pLoader->mDesc.mTimesliceMs;
-	SyncToken maxToken[MAX_BUFFER_COUNT] = { 0 };
+	// Tokens of the requests recorded into each set, completed once the set's fence is waited on
+	eastl::vector<uint64_t> setTokens[MAX_BUFFER_COUNT];
 	size_t activeSet = 0;
+	// Upload rate over the last full second
+	int64_t rateWindowStart = getUSec();
+	uint64_t rateWindowBytes = 0;
 	while (pLoader->mRun)
 	{
 		pLoader->mQueueMutex.Acquire();
@@ -838,10 +1330,12 @@ static void streamerThreadFunc(void* pThreadData)
 			const uint32_t mask = 1 << i;
 			if (completionMask & mask)
 			{
-				if (!pLoader->mRequestQueue[i].empty())
+				eastl::vector<UpdateRequest>& queue = pLoader->mRequestQueue[i];
+				if (!queue.empty())
 				{
-					updateState[i] = pLoader->mRequestQueue[i].front();
-					pLoader->mRequestQueue[i].pop_front();
+					eastl::pop_heap(queue.begin(), queue.end(), updateRequestPrecedes);
+					updateState[i] = queue.back();
+					queue.pop_back();
 					completionMask &= ~mask;
 				}
 				else
@@ -850,7 +1344,14 @@ static void streamerThreadFunc(void* pThreadData)
 				}
 			}
 
+			uint32_t const queueDepth = (uint32_t)pLoader->mRequestQueue[i].size();
 			pLoader->mQueueMutex.Release();
+			PROFILE_COUNTER_SET("ResourceLoader/QueueDepth", queueDepth);
+			UNREF_PARAM(queueDepth);
+
+			PROFILE_SCOPEI("ResourceLoader", "RecordUpload", 0x3355ee);
+			int64_t const recordStart = getUSec();
+			uint64_t const uploadedBytes = pCopyEngines[i].uploadedBytes;
 
 			bool completed = true;
 			switch (updateState[i].mRequest.mType)
@@ -869,9 +1370,24 @@ static void streamerThreadFunc(void* pThreadData)
 			completionMask |= completed << i;
 			if (updateState[i].mRequest.mToken && completed)
 			{
-				ASSERT(maxToken[activeSet] < updateState[i].mRequest.mToken);
-				maxToken[activeSet] = updateState[i].mRequest.mToken;
+				setTokens[activeSet].push_back((uint64_t)updateState[i].mRequest.mToken);
 			}
+
+			uint64_t const stagedBytes = pCopyEngines[i].uploadedBytes - uploadedBytes;
+			rateWindowBytes += stagedBytes;
+			PROFILE_COUNTER_ADD("ResourceLoader/UploadedBytes", stagedBytes);
+			tfrg_atomic64_add_relaxed(&pLoader->mNodeStats[i].mUploadedBytes, stagedBytes);
+			tfrg_atomic64_add_relaxed(&pLoader->mNodeStats[i].mRecordTimeUs, (uint64_t)(getUSec() - recordStart));
+			if (completed && updateState[i].mRequest.mType != UPDATE_REQUEST_INVALID)
+				tfrg_atomic64_add_relaxed(&pLoader->mNodeStats[i].mRequestCount, 1);
+		}
+
+		int64_t const now = getUSec();
+		if (now - rateWindowStart >= 1000000)
+		{
+			tfrg_atomic64_store_relaxed(&pLoader->mBytesPerSecond, rateWindowBytes * 1000000 / (uint64_t)(now - rateWindowStart));
+			rateWindowStart = now;
+			rateWindowBytes = 0;
 		}
 		
 		if (getSystemTime() > nextTimeslot || completionMask == 0)
@@ -881,20 +1397,31 @@ static void streamerThreadFunc(void* pThreadData)
 				streamerFlush(&pCopyEngines[i], activeSet);
 			}
 			
+			// A request that is still incomplete ran out of staging space, waiting for the next set is a stall
+			bool const stalled = completionMask != allUploadsCompleted;
+			int64_t const waitStart = stalled ? getUSec() : 0;
+
 			activeSet = (activeSet + 1) % pLoader->mDesc.mBufferCount;
 			for (uint32_t i = 0; i < linkedGPUCount; ++i)
 			{
+				PROFILE_SCOPEI("ResourceLoader", "WaitCopyFence", 0xee5533);
+				int64_t const fenceWaitStart = getUSec();
 				waitCopyEngineSet(pLoader->pRenderer, &pCopyEngines[i], activeSet);
+				tfrg_atomic64_add_relaxed(&pLoader->mNodeStats[i].mFenceWaitTimeUs, (uint64_t)(getUSec() - fenceWaitStart));
+				if (growStagingBuffers(pLoader, &pCopyEngines[i], stalled))
+					tfrg_atomic64_add_relaxed(&pLoader->mStagingGrowCount, 1);
+				recycleStagingBuffers(pLoader, &pCopyEngines[i], activeSet);
 				resetCopyEngineSet(pLoader->pRenderer, &pCopyEngines[i], activeSet);
 			}
+
+			if (stalled)
+			{
+				tfrg_atomic64_add_relaxed(&pLoader->mStagingStallCount, 1);
+				tfrg_atomic64_add_relaxed(&pLoader->mStagingStallTimeUs, (uint64_t)(getUSec() - waitStart));
+			}
 			
-			SyncToken nextToken = maxToken[activeSet];
-			SyncToken prevToken = tfrg_atomic64_load_relaxed(&pLoader->mTokenCompleted);
-			// As the only writer atomicity is preserved
-			pLoader->mTokenMutex.Acquire();
-			tfrg_atomic64_store_release(&pLoader->mTokenCompleted, nextToken > prevToken ? nextToken : prevToken);
-			pLoader->mTokenMutex.Release();
-			pLoader->mTokenCond.WakeAll();
+			completeTokens(pLoader, setTokens[activeSet].data(), (uint32_t)setTokens[activeSet].size());
+			setTokens[activeSet].clear();
 			nextTimeslot = getSystemTime() + pLoader->mDesc.mTimesliceMs;
 		}
 
@@ -908,22 +1435,218 @@ static void streamerThreadFunc(void* pThreadData)
 	}
 }
 
+// Keeps the pack open and its table of contents in memory, variants are read with a seek each
+static void openShaderPack(ResourceLoader* pLoader)
+{
+	pLoader->pShaderPack = fsOpenFileInResourceDirectory(RD_SHADER_BINARIES, SHADER_PACK_FILE_NAME, FM_READ_BINARY);
+	if (!pLoader->pShaderPack)
+		return;
+
+	ShaderPackHeader header = {};
+	bool             valid = fsReadFromStream(pLoader->pShaderPack, &header, sizeof(header)) == sizeof(header) &&
+				 header.mMagic == SHADER_PACK_MAGIC && header.mVersion == SHADER_PACK_VERSION;
+	// Every entry has to lie within the file and follow the previous key, lookups then read without further checks
+	ssize_t const  streamSize = fsGetStreamFileSize(pLoader->pShaderPack);
+	uint64_t const fileSize = streamSize > 0 ? (uint64_t)streamSize : 0;
+	valid = valid && header.mEntryCount <= (fileSize - sizeof(header)) / sizeof(ShaderPackEntry);
+	if (valid)
+	{
+		pLoader->mShaderPackEntries.resize(header.mEntryCount);
+		size_t const tocSize = header.mEntryCount * sizeof(ShaderPackEntry);
+		valid = fsReadFromStream(pLoader->pShaderPack, pLoader->mShaderPackEntries.data(), tocSize) == tocSize;
+	}
+	for (uint32_t i = 0; i < header.mEntryCount && valid; ++i)
+	{
+		const ShaderPackEntry& entry = pLoader->mShaderPackEntries[i];
+		valid = entry.mOffset <= fileSize && entry.mSize <= fileSize - entry.mOffset &&
+				(i == 0 || shaderPackKeyLess(pLoader->mShaderPackEntries[i - 1].mKey, entry.mKey));
+	}
+
+	if (!valid)
+	{
+		LOGF(LogLevel::eWARNING, "Ignoring invalid shader pack %s", SHADER_PACK_FILE_NAME);
+		pLoader->mShaderPackEntries.set_capacity(0);
+		fsCloseStream(pLoader->pShaderPack);
+		pLoader->pShaderPack = NULL;
+	}
+}
+
+static void closeShaderPack(ResourceLoader* pLoader)
+{
+	if (pLoader->pShaderPack)
+		fsCloseStream(pLoader->pShaderPack);
+	pLoader->pShaderPack = NULL;
+	pLoader->mShaderPackEntries.set_capacity(0);
+}
+
+static bool readShaderPackByteCode(ResourceLoader* pLoader, const uint64_t key[2], eastl::vector<char>& byteCode)
+{
+	if (!pLoader || !pLoader->pShaderPack)
+		return false;
+
+	const ShaderPackEntry* pEntry = eastl::lower_bound(
+		pLoader->mShaderPackEntries.begin(), pLoader->mShaderPackEntries.end(), key,
+		[](const ShaderPackEntry& entry, const uint64_t* pKey) { return shaderPackKeyLess(entry.mKey, pKey); });
+	if (pEntry == pLoader->mShaderPackEntries.end() || pEntry->mKey[0] != key[0] || pEntry->mKey[1] != key[1])
+		return false;
+
+	byteCode.resize((size_t)pEntry->mSize);
+	pLoader->mShaderPackMutex.Acquire();
+	bool const read = fsSeekStream(pLoader->pShaderPack, SBO_START_OF_FILE, (ssize_t)pEntry->mOffset) &&
+					  fsReadFromStream(pLoader->pShaderPack, byteCode.data(), byteCode.size()) == byteCode.size();
+	pLoader->mShaderPackMutex.Release();
+
+	if (!read)
+	{
+		LOGF(LogLevel::eERROR, "Failed to read shader binary from %s", SHADER_PACK_FILE_NAME);
+		byteCode.clear();
+	}
+	return read;
+}
+
+#define SHADER_INCLUDE_CACHE_FILE_NAME "ShaderIncludes.cache"
+#define SHADER_INCLUDE_CACHE_MAGIC 0x434e4953u    // "SINC"
+#define SHADER_INCLUDE_CACHE_VERSION 1u
+
+static void writeCacheString(FileStream* fh, const eastl::string& str)
+{
+	fsWriteToStreamUInt32(fh, (uint32_t)str.size());
+	fsWriteToStream(fh, str.data(), str.size());
+}
+
+// Sizes read from a cache file are checked against the bytes left in it before anything is allocated
+static uint64_t getStreamBytesLeft(const FileStream* fh)
+{
+	ssize_t const left = fsGetStreamFileSize(fh) - fsGetStreamSeekPosition(fh);
+	return left > 0 ? (uint64_t)left : 0;
+}
+
+static bool readCacheString(FileStream* fh, eastl::string& str)
+{
+	uint32_t const size = fsReadFromStreamUInt32(fh);
+	if (size > getStreamBytesLeft(fh))
+		return false;
+	str.resize(size);
+	return fsReadFromStream(fh, str.begin(), size) == size;
+}
+
+static void loadShaderIncludeCache(ResourceLoader* pLoader)
+{
+	pLoader->mShaderIncludesDirty = false;
+	FileStream* fh = fsOpenFileInResourceDirectory(RD_SHADER_BINARIES, SHADER_INCLUDE_CACHE_FILE_NAME, FM_READ_BINARY);
+	if (!fh)
+		return;
+
+	bool valid = fsReadFromStreamUInt32(fh) == SHADER_INCLUDE_CACHE_MAGIC && fsReadFromStreamUInt32(fh) == SHADER_INCLUDE_CACHE_VERSION;
+	uint32_t const nodeCount = valid ? fsReadFromStreamUInt32(fh) : 0;
+	for (uint32_t i = 0; i < nodeCount && valid; ++i)
+	{
+		eastl::string     path;
+		ShaderIncludeNode node;
+		valid = readCacheString(fh, path);
+		node.mModifiedTime = (time_t)fsReadFromStreamInt64(fh);
+		node.mContentHash[0] = fsReadFromStreamUInt64(fh);
+		node.mContentHash[1] = fsReadFromStreamUInt64(fh);
+		// Every include takes at least its size field
+		uint32_t const includeCount = fsReadFromStreamUInt32(fh);
+		valid = valid && includeCount <= getStreamBytesLeft(fh) / sizeof(uint32_t);
+		node.mIncludes.resize(valid ? includeCount : 0);
+		for (eastl::string& include : node.mIncludes)
+			valid = valid && readCacheString(fh, include);
+		if (valid)
+			pLoader->mShaderIncludes[path] = node;
+	}
+	fsCloseStream(fh);
+
+	if (!valid)
+	{
+		LOGF(LogLevel::eWARNING, "Ignoring invalid shader include cache %s", SHADER_INCLUDE_CACHE_FILE_NAME);
+		pLoader->mShaderIncludes.clear();
+	}
+}
+
+static void saveShaderIncludeCache(ResourceLoader* pLoader)
+{
+	if (!pLoader->mShaderIncludesDirty)
+		return;
+
+	FileStream* fh = fsOpenFileInResourceDirectory(RD_SHADER_BINARIES, SHADER_INCLUDE_CACHE_FILE_NAME, FM_WRITE_BINARY);
+	if (!fh)
+	{
+		LOGF(LogLevel::eWARNING, "Failed to save shader include cache %s", SHADER_INCLUDE_CACHE_FILE_NAME);
+		return;
+	}
+
+	// Files without a modification time (packaged sources) can't be validated in a later run
+	uint32_t nodeCount = 0;
+	for (eastl::unordered_map<eastl::string, ShaderIncludeNode>::iterator it = pLoader->mShaderIncludes.begin(); it != pLoader->mShaderIncludes.end(); ++it)
+		nodeCount += it->second.mModifiedTime != 0;
+
+	fsWriteToStreamUInt32(fh, SHADER_INCLUDE_CACHE_MAGIC);
+	fsWriteToStreamUInt32(fh, SHADER_INCLUDE_CACHE_VERSION);
+	fsWriteToStreamUInt32(fh, nodeCount);
+	for (eastl::unordered_map<eastl::string, ShaderIncludeNode>::iterator it = pLoader->mShaderIncludes.begin(); it != pLoader->mShaderIncludes.end(); ++it)
+	{
+		const ShaderIncludeNode& node = it->second;
+		if (!node.mModifiedTime)
+			continue;
+		writeCacheString(fh, it->first);
+		fsWriteToStreamInt64(fh, (int64_t)node.mModifiedTime);
+		fsWriteToStreamUInt64(fh, node.mContentHash[0]);
+		fsWriteToStreamUInt64(fh, node.mContentHash[1]);
+		fsWriteToStreamUInt32(fh, (uint32_t)node.mIncludes.size());
+		for (const eastl::string& include : node.mIncludes)
+			writeCacheString(fh, include);
+	}
+	fsCloseStream(fh);
+}
+
 static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, ResourceLoader** ppLoader)
 {
 	ResourceLoader* pLoader = conf_new(ResourceLoader);
 	pLoader->pRenderer = pRenderer;
 
 	pLoader->mRun = true;
-	pLoader->mDesc = pDesc ? *pDesc : ResourceLoaderDesc{ DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_COUNT, DEFAULT_TIMESLICE_MS };
+	pLoader->mDesc = pDesc ? *pDesc : ResourceLoaderDesc{ DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_COUNT, DEFAULT_TIMESLICE_MS, 0 };
+	tfrg_atomic64_store_relaxed(&pLoader->mStagingStallCount, 0);
+	tfrg_atomic64_store_relaxed(&pLoader->mStagingStallTimeUs, 0);
+	tfrg_atomic64_store_relaxed(&pLoader->mStagingGrowCount, 0);
+	tfrg_atomic64_store_relaxed(&pLoader->mStagingBufferSize, 0);
+	tfrg_atomic64_store_relaxed(&pLoader->mBytesPerSecond, 0);
+	tfrg_atomic64_store_relaxed(&pLoader->mDecodeTimeUs, 0);
+	tfrg_atomic64_store_relaxed(&pLoader->mDecodeCount, 0);
+	for (uint32_t i = 0; i < MAX_GPUS; ++i)
+	{
+		tfrg_atomic64_store_relaxed(&pLoader->mNodeStats[i].mUploadedBytes, 0);
+		tfrg_atomic64_store_relaxed(&pLoader->mNodeStats[i].mRequestCount, 0);
+		tfrg_atomic64_store_relaxed(&pLoader->mNodeStats[i].mRecordTimeUs, 0);
+		tfrg_atomic64_store_relaxed(&pLoader->mNodeStats[i].mFenceWaitTimeUs, 0);
+	}
+	pLoader->mStartTimeUs = getUSec();
+	pLoader->mRequestSequence = 0;
 
 	pLoader->mQueueMutex.Init();
 	pLoader->mTokenMutex.Init();
+	pLoader->mSharedTextureMutex.Init();
+	pLoader->mTextureStreamMutex.Init();
+	pLoader->mStagingPoolMutex.Init();
+	for (uint32_t i = 0; i < MAX_GPUS; ++i)
+		pLoader->mStagingPoolBytes[i] = 0;
+	pLoader->mShaderPackMutex.Init();
+	pLoader->mShaderIncludeMutex.Init();
+	pLoader->mShaderCompilerMutex.Init();
 	pLoader->mQueueCond.Init();
 	pLoader->mTokenCond.Init();
+	pLoader->mPreparingCond.Init();
 	
+	openShaderPack(pLoader);
+	loadShaderIncludeCache(pLoader);
+
 	pLoader->mThreadDesc.pFunc = streamerThreadFunc;
 	pLoader->mThreadDesc.pData = pLoader;
 
+	initThreadSystem(&pLoader->pThreadSystem);
+
 	pLoader->mThread = create_thread(&pLoader->mThreadDesc);
 
 	*ppLoader = pLoader;
@@ -931,11 +1654,47 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 
 static void removeResourceLoader(ResourceLoader* pLoader)
 {
+	// texture preparation jobs still queue uploads
+	waitThreadSystemIdle(pLoader->pThreadSystem);
+
 	pLoader->mRun = false;
 	pLoader->mQueueCond.WakeOne();
 	destroy_thread(pLoader->mThread);
+	shutdownThreadSystem(pLoader->pThreadSystem);
+
+	// Shared textures exist once addResource returns, entries left belong to textures that were never removed
+	for (eastl::unordered_map<Texture*, SharedTexture*>::iterator it = pLoader->mSharedTextureOwners.begin(); it != pLoader->mSharedTextureOwners.end(); ++it)
+		conf_delete(it->second);
+	pLoader->mSharedTextureOwners.clear();
+	pLoader->mSharedTextures.clear();
+	pLoader->mSharedTextureTokens.clear();
+	pLoader->mSharedTextureMutex.Destroy();
+
+	for (eastl::unordered_map<Texture*, TextureStream*>::iterator it = pLoader->mTextureStreams.begin(); it != pLoader->mTextureStreams.end(); ++it)
+		conf_delete(it->second);
+	pLoader->mTextureStreams.clear();
+	pLoader->mTextureStreamMutex.Destroy();
+
+	for (uint32_t i = 0; i < MAX_GPUS; ++i)
+	{
+		for (Buffer* pBuffer : pLoader->mStagingPool[i])
+			removeBuffer(pLoader->pRenderer, pBuffer);
+		pLoader->mStagingPool[i].clear();
+	}
+	pLoader->mStagingPoolMutex.Destroy();
+
+	closeShaderPack(pLoader);
+	pLoader->mShaderPackMutex.Destroy();
+
+	saveShaderIncludeCache(pLoader);
+	pLoader->mShaderIncludes.clear();
+	pLoader->mShaderIncludeMutex.Destroy();
+	pLoader->mShaderCompilerMutex.Destroy();
+
 	pLoader->mQueueCond.Destroy();
+	pLoader->mFailedTokens.clear();
 	pLoader->mTokenCond.Destroy();
+	pLoader->mPreparingCond.Destroy();
 	pLoader->mQueueMutex.Destroy();
 	pLoader->mTokenMutex.Destroy();
 	conf_delete(pLoader);
@@ -977,54 +1736,167 @@ static void updateCPUbuffer(Renderer* pRenderer, BufferUpdateDesc* pBufferUpdate
 	}
 }
 
+// Caller holds mQueueMutex
+static void pushUpdateRequest(ResourceLoader* pLoader, uint32_t nodeIndex, const UpdateRequest& request, SyncToken token, int32_t priority)
+{
+	eastl::vector<UpdateRequest>& queue = pLoader->mRequestQueue[nodeIndex];
+	queue.push_back(request);
+	queue.back().mToken = token;
+	queue.back().mPriority = priority;
+	queue.back().mSequence = pLoader->mRequestSequence++;
+	queue.back().mQueueTimeUs = getUSec();
+	eastl::push_heap(queue.begin(), queue.end(), updateRequestPrecedes);
+}
+
 static void queueResourceUpdate(ResourceLoader* pLoader, BufferUpdateDesc* pBufferUpdate, SyncToken* token)
 {
 	uint32_t nodeIndex = pBufferUpdate->pBuffer->mDesc.mNodeIndex;
 	pLoader->mQueueMutex.Acquire();
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pBufferUpdate));
-	pLoader->mRequestQueue[nodeIndex].back().mToken = t;
+	SyncToken t = reserveToken(pLoader);
+	pushUpdateRequest(pLoader, nodeIndex, UpdateRequest(*pBufferUpdate), t, pBufferUpdate->mPriority);
 	pLoader->mQueueMutex.Release();
 	pLoader->mQueueCond.WakeOne();
 	if (token) *token = t;
 }
 
-static void queueResourceUpdate(ResourceLoader* pLoader, TextureUpdateDescInternal* pTextureUpdate, SyncToken* token)
+// Queues a texture upload under a token reserved when the load was requested, false if the load got cancelled meanwhile
+static bool queueResourceUpdate(ResourceLoader* pLoader, TextureUpdateDescInternal* pTextureUpdate, SyncToken reservedToken)
 {
-	uint32_t nodeIndex = pTextureUpdate->pTexture->mDesc.mNodeIndex;
 	pLoader->mQueueMutex.Acquire();
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pTextureUpdate));
-	pLoader->mRequestQueue[nodeIndex].back().mToken = t;
+	bool cancelled = false;
+	eastl::unordered_map<uint64_t, bool>::iterator it = pLoader->mPreparingTokens.find((uint64_t)reservedToken);
+	if (it != pLoader->mPreparingTokens.end())
+	{
+		cancelled = it->second;
+		pLoader->mPreparingTokens.erase(it);
+	}
+	// Cancelled loads don't touch the texture anymore
+	if (!cancelled)
+		pushUpdateRequest(
+			pLoader, pTextureUpdate->pTexture->mDesc.mNodeIndex, UpdateRequest(*pTextureUpdate), reservedToken, pTextureUpdate->mPriority);
 	pLoader->mQueueMutex.Release();
+
+	if (cancelled)
+	{
+		// The texture job got cancelled while preparing, the texture stays with undefined contents
+		releaseUpdateImage(*pTextureUpdate);
+		uint64_t const token = reservedToken;
+		completeTokens(pLoader, &token, 1);
+		return false;
+	}
 	pLoader->mQueueCond.WakeOne();
+	return true;
+}
+
+static void queueResourceUpdate(ResourceLoader* pLoader, TextureUpdateDescInternal* pTextureUpdate, SyncToken* token)
+{
+	SyncToken t = reserveToken(pLoader);
+	queueResourceUpdate(pLoader, pTextureUpdate, t);
 	if (token) *token = t;
 }
 
-static void queueResourceUpdate(ResourceLoader* pLoader, Buffer* pBuffer, SyncToken* token)
+static void queueResourceUpdate(ResourceLoader* pLoader, Buffer* pBuffer, int32_t priority, SyncToken* token)
 {
 	uint32_t nodeIndex = pBuffer->mDesc.mNodeIndex;
 	pLoader->mQueueMutex.Acquire();
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(pBuffer));
-	pLoader->mRequestQueue[nodeIndex].back().mToken = t;
+	SyncToken t = reserveToken(pLoader);
+	pushUpdateRequest(pLoader, nodeIndex, UpdateRequest(pBuffer), t, priority);
 	pLoader->mQueueMutex.Release();
 	pLoader->mQueueCond.WakeOne();
 	if (token) *token = t;
 }
 
-static void queueResourceUpdate(ResourceLoader* pLoader, Texture* pTexture, SyncToken* token)
+static void queueResourceUpdate(ResourceLoader* pLoader, Texture* pTexture, int32_t priority, SyncToken* token)
 {
 	uint32_t nodeIndex = pTexture->mDesc.mNodeIndex;
 	pLoader->mQueueMutex.Acquire();
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(pTexture));
-	pLoader->mRequestQueue[nodeIndex].back().mToken = t;
+	SyncToken t = reserveToken(pLoader);
+	pushUpdateRequest(pLoader, nodeIndex, UpdateRequest(pTexture), t, priority);
 	pLoader->mQueueMutex.Release();
 	pLoader->mQueueCond.WakeOne();
 	if (token) *token = t;
 }
 
+static bool isPreparationCancelled(ResourceLoader* pLoader, SyncToken token)
+{
+	pLoader->mQueueMutex.Acquire();
+	eastl::unordered_map<uint64_t, bool>::iterator it = pLoader->mPreparingTokens.find((uint64_t)token);
+	bool cancelled = it != pLoader->mPreparingTokens.end() && it->second;
+	pLoader->mQueueMutex.Release();
+	return cancelled;
+}
+
+static bool cancelResourceRequest(ResourceLoader* pLoader, SyncToken token)
+{
+	UpdateRequest request;
+	bool found = false;
+
+	// A shared load is only cancelled for its last holder. The lock is kept until the cancel succeeded,
+	// then the entry is dropped so later loads of the same key start over
+	pLoader->mSharedTextureMutex.Acquire();
+	eastl::unordered_map<uint64_t, SharedTexture*>::iterator shared = pLoader->mSharedTextureTokens.find((uint64_t)token);
+	if (shared != pLoader->mSharedTextureTokens.end() && shared->second->mRefCount > 1)
+	{
+		pLoader->mSharedTextureMutex.Release();
+		return false;
+	}
+
+	pLoader->mQueueMutex.Acquire();
+	bool preparing = false;
+	eastl::unordered_map<uint64_t, bool>::iterator it = pLoader->mPreparingTokens.find((uint64_t)token);
+	if (it != pLoader->mPreparingTokens.end())
+	{
+		// The job drops the request and completes the token itself
+		preparing = true;
+		found = !it->second;
+		it->second = true;
+	}
+
+	for (uint32_t i = 0; i < MAX_GPUS && !found && !preparing; ++i)
+	{
+		eastl::vector<UpdateRequest>& queue = pLoader->mRequestQueue[i];
+		for (eastl::vector<UpdateRequest>::iterator req = queue.begin(); req != queue.end(); ++req)
+		{
+			if (req->mToken == token)
+			{
+				request = *req;
+				queue.erase(req);
+				eastl::make_heap(queue.begin(), queue.end(), updateRequestPrecedes);
+				found = true;
+				break;
+			}
+		}
+	}
+	pLoader->mQueueMutex.Release();
+
+	if (found && shared != pLoader->mSharedTextureTokens.end())
+	{
+		pLoader->mSharedTextures.erase(shared->second->mKey);
+		pLoader->mSharedTextureTokens.erase(shared);
+	}
+	pLoader->mSharedTextureMutex.Release();
+
+	if (!found || preparing)
+		return found;
+
+	if (request.mType == UPDATE_REQUEST_UPDATE_TEXTURE)
+		releaseUpdateImage(request.texUpdateDesc);
+	if (request.mType == UPDATE_REQUEST_UPDATE_BUFFER && request.bufUpdateDesc.mInternal.pSrcBuffer)
+		removeBuffer(pLoader->pRenderer, request.bufUpdateDesc.mInternal.pSrcBuffer);
+
+	uint64_t const completed = (uint64_t)token;
+	completeTokens(pLoader, &completed, 1);
+
+	// Without its mip tail a progressive load has nothing to stream on top of
+	TextureStream* pStream = request.mType == UPDATE_REQUEST_UPDATE_TEXTURE ? request.texUpdateDesc.pStream : NULL;
+	if (pStream && request.texUpdateDesc.mBaseMipLevel == pStream->mTailMip)
+	{
+		for (uint32_t mip = 0; mip < pStream->mTailMip; ++mip)
+			cancelResourceRequest(pLoader, pStream->mTokens[mip]);
+	}
+	return true;
+}
+
 static bool isTokenCompleted(ResourceLoader* pLoader, SyncToken token)
 {
 	bool completed = tfrg_atomic64_load_acquire(&pLoader->mTokenCompleted) >= token;
@@ -1047,7 +1919,7 @@ void initResourceLoaderInterface(Renderer* pRenderer, ResourceLoaderDesc* pDesc)
 {
 	addResourceLoader(pRenderer, pDesc, &pResourceLoader);
 
-	ResourceLoader::InitImageClass();
+	ResourceLoader::InitImageClass(pRenderer, pResourceLoader->pThreadSystem);
 }
 
 void removeResourceLoaderInterface(Renderer* pRenderer)
@@ -1084,6 +1956,7 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 	{
 		BufferUpdateDesc bufferUpdate(*pBufferDesc->ppBuffer, pBufferDesc->pData);
         bufferUpdate.mSize = pBufferDesc->mDesc.mSize;
+		bufferUpdate.mPriority = pBufferDesc->mPriority;
 		updateResource(&bufferUpdate, token);
 	}
 	else
@@ -1093,10 +1966,254 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 			pBufferDesc->mDesc.mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY &&
 			// Check whether this is required (user specified a state other than undefined / common)
 			(pBufferDesc->mDesc.mStartState != RESOURCE_STATE_UNDEFINED && pBufferDesc->mDesc.mStartState != RESOURCE_STATE_COMMON))
-			queueResourceUpdate(pResourceLoader, *pBufferDesc->ppBuffer, token);
+			queueResourceUpdate(pResourceLoader, *pBufferDesc->ppBuffer, pBufferDesc->mPriority, token);
+	}
+}
+
+#if !defined(METAL) && !defined(DIRECT3D11)
+static bool readVirtualTexturePage(void* pUserData, uint32_t pageIndex, void* pDst, uint64_t size)
+{
+	return Image::ReadSVTPage((SVTPageReader*)pUserData, pageIndex, pDst, size);
+}
+
+static void releaseVirtualTexturePageSource(void* pUserData)
+{
+	Image::CloseSVT((SVTPageReader*)pUserData);
+}
+#endif
+
+// Queues the mip tail under reservedToken, then every larger mip with a lower priority than the one below it
+static void queueProgressiveUpdate(
+	ResourceLoader* pLoader, Texture* pTexture, Image* pImage, bool freeImage, uint32_t tailMip, int32_t priority, SyncToken reservedToken)
+{
+	TextureStream* pStream = conf_new(TextureStream);
+	pStream->pImage = pImage;
+	pStream->mFreeImage = freeImage;
+	pStream->mTailMip = tailMip;
+	for (uint32_t mip = 0; mip < MAX_MIP_LEVELS; ++mip)
+		pStream->mTokens[mip] = UINT64_MAX;
+	pStream->mTokens[tailMip] = (uint64_t)reservedToken;
+	// Every token is written before the stream is published, residency queries and cancels only read them
+	for (uint32_t mip = tailMip; mip-- > 0;)
+		pStream->mTokens[mip] = (uint64_t)reserveToken(pLoader);
+	tfrg_atomic32_store_relaxed(&pStream->mImageRefs, 2);
+
+	TextureUpdateDescInternal updateDesc = { pTexture, pImage, false, priority, tailMip, pImage->GetMipMapCount() - tailMip, pStream };
+	bool const queued = queueResourceUpdate(pLoader, &updateDesc, reservedToken);
+	if (queued)
+	{
+		// Published once the tail is queued, a cancelled load leaves no stream behind
+		pLoader->mTextureStreamMutex.Acquire();
+		pLoader->mTextureStreams[pTexture] = pStream;
+		pLoader->mTextureStreamMutex.Release();
+
+		for (uint32_t mip = tailMip; mip-- > 0;)
+		{
+			tfrg_atomic32_add_relaxed(&pStream->mImageRefs, 1);
+			updateDesc.mPriority = priority - (int32_t)(tailMip - mip);
+			updateDesc.mBaseMipLevel = mip;
+			updateDesc.mMipLevels = 1;
+			queueResourceUpdate(pLoader, &updateDesc, pStream->mTokens[mip]);
+		}
+	}
+	else
+	{
+		// The mips never get queued, their tokens complete right away
+		completeTokens(pLoader, pStream->mTokens, tailMip);
+	}
+
+	TextureUpdateDescInternal creatorRef = {};
+	creatorRef.pStream = pStream;
+	releaseUpdateImage(creatorRef);
+	if (!queued)
+		conf_delete(pStream);
+}
+
+// Layout of the texture an image is uploaded to, the same one a header probe reports
+static ImageProbeInfo getImageLayout(Image* pImage)
+{
+	ImageProbeInfo info = {};
+	info.mWidth = pImage->GetWidth();
+	info.mHeight = pImage->GetHeight();
+	info.mDepth = max(1U, pImage->GetDepth());
+	info.mMipMapCount = pImage->GetMipMapCount();
+	info.mArrayCount = pImage->GetArrayCount();
+	info.mFormat = pImage->GetFormat();
+	info.mIsCube = pImage->IsCube();
+	return info;
+}
+
+static void fillImageTextureDesc(TextureDesc* pDesc, const ImageProbeInfo& info, TextureCreationFlags creationFlag, uint32_t nodeIndex)
+{
+	*pDesc = {};
+	pDesc->mFlags = creationFlag;
+	pDesc->mWidth = info.mWidth;
+	pDesc->mHeight = info.mHeight;
+	pDesc->mDepth = max(1U, info.mDepth);
+	pDesc->mArraySize = info.mArrayCount;
+
+	pDesc->mMipLevels = info.mMipMapCount;
+	pDesc->mSampleCount = SAMPLE_COUNT_1;
+	pDesc->mSampleQuality = 0;
+	pDesc->mFormat = info.mFormat;
+
+	pDesc->mClearValue = ClearValue();
+	pDesc->mDescriptors = DESCRIPTOR_TYPE_TEXTURE;
+	pDesc->mStartState = RESOURCE_STATE_COMMON;
+	pDesc->pNativeHandle = NULL;
+	pDesc->mHostVisible = false;
+	pDesc->mNodeIndex = nodeIndex;
+
+	if (info.mIsCube)
+	{
+		pDesc->mDescriptors |= DESCRIPTOR_TYPE_TEXTURE_CUBE;
+		pDesc->mArraySize *= 6;
+	}
+}
+
+static void addImageTexture(
+	Texture** ppTexture, const ImageProbeInfo& info, const Path* pPath, TextureCreationFlags creationFlag, uint32_t nodeIndex)
+{
+	TextureDesc desc;
+	fillImageTextureDesc(&desc, info, creationFlag, nodeIndex);
+
+	wchar_t debugName[MAX_PATH] = {};
+	desc.pDebugName = debugName;
+
+	if (pPath)
+	{
+		PathComponent fileName = fsGetPathFileName(pPath);
+		mbstowcs(debugName, fileName.buffer, min((size_t)MAX_PATH, fileName.length));
+	}
+
+	addTexture(pResourceLoader->pRenderer, &desc, ppTexture);
+}
+
+// Queues the upload of pImage to pTexture under reservedToken
+static void queueImageUpload(
+	Texture* pTexture, Image* pImage, bool freeImage, int32_t priority, SyncToken reservedToken, bool progressive)
+{
+	uint32_t tailMip = 0;
+	// Xbox transitions the whole texture for every copy, a streamed mip would take the resident ones away from the shaders
+	if (progressive && pResourceLoader->pRenderer->mSettings.mApi != RENDERER_API_XBOX_D3D12)
+	{
+		while (tailMip + 1 < pImage->GetMipMapCount() && max(pImage->GetWidth(tailMip), pImage->GetHeight(tailMip)) > MIP_TAIL_MAX_SIZE)
+			++tailMip;
+	}
+
+	if (tailMip > 0)
+	{
+		queueProgressiveUpdate(pResourceLoader, pTexture, pImage, freeImage, tailMip, priority, reservedToken);
+		return;
+	}
+
+	TextureUpdateDescInternal updateDesc = { pTexture, pImage, freeImage, priority };
+	queueResourceUpdate(pResourceLoader, &updateDesc, reservedToken);
+}
+
+// Creates the texture described by pImage and queues its upload under reservedToken
+static void addTextureFromImage(
+	Texture** ppTexture, Image* pImage, bool freeImage, TextureCreationFlags creationFlag, uint32_t nodeIndex, int32_t priority,
+	SyncToken reservedToken, bool progressive = false)
+{
+	addImageTexture(ppTexture, getImageLayout(pImage), pImage->GetPath(), creationFlag, nodeIndex);
+	queueImageUpload(*ppTexture, pImage, freeImage, priority, reservedToken, progressive);
+}
+
+// Texture loads with a header probe create the texture on the calling thread and decode the image as a
+// thread system job. The job reads, parses and transcodes the file and queues the upload, the token
+// completes once the upload is done
+typedef struct TextureLoadJob
+{
+	Texture*        pTexture;
+	// Layout pTexture was created with, so the decoded image is checked without touching the texture
+	TextureDesc     mDesc;
+	Path*           pFilePath;
+	BinaryImageData mBinaryImageData;
+	int32_t         mPriority;
+	SyncToken       mToken;
+	bool            mProgressive;
+} TextureLoadJob;
+
+static Image* loadTextureImage(const Path* pFilePath, const BinaryImageData* pBinaryImageData)
+{
+	if (pFilePath)
+		return ResourceLoader::CreateImage(pFilePath, NULL, NULL);
+
+	Image* pImage = ResourceLoader::CreateImage(pBinaryImageData->pBinaryData, pBinaryImageData->mSize, pBinaryImageData->pExtension, NULL, NULL);
+	if (!pImage)
+		LOGF(LogLevel::eERROR, "Failed to load texture from binary image data");
+	return pImage;
+}
+
+static void loadTextureTask(void* pData, uintptr_t)
+{
+	TextureLoadJob* pJob = (TextureLoadJob*)pData;
+
+	PROFILE_SCOPEI("ResourceLoader", "DecodeTexture", 0x33ee55);
+	int64_t const decodeStart = getUSec();
+
+	Image* pImage = NULL;
+	// Cancelled before the read, nothing to decode
+	if (!isPreparationCancelled(pResourceLoader, pJob->mToken))
+		pImage = loadTextureImage(pJob->pFilePath, &pJob->mBinaryImageData);
+
+	tfrg_atomic64_add_relaxed(&pResourceLoader->mDecodeTimeUs, (uint64_t)(getUSec() - decodeStart));
+	tfrg_atomic64_add_relaxed(&pResourceLoader->mDecodeCount, 1);
+
+	if (pImage && isPreparationCancelled(pResourceLoader, pJob->mToken))
+	{
+		ResourceLoader::DestroyImage(pImage);
+		pImage = NULL;
 	}
+
+	if (pImage)
+	{
+		// The texture was created from the header, a loader that disagrees with its probe can't be uploaded
+		const TextureDesc& textureDesc = pJob->mDesc;
+		TextureDesc        imageDesc;
+		fillImageTextureDesc(&imageDesc, getImageLayout(pImage), textureDesc.mFlags, textureDesc.mNodeIndex);
+		if (imageDesc.mWidth != textureDesc.mWidth || imageDesc.mHeight != textureDesc.mHeight || imageDesc.mDepth != textureDesc.mDepth ||
+			imageDesc.mArraySize != textureDesc.mArraySize || imageDesc.mMipLevels != textureDesc.mMipLevels ||
+			imageDesc.mFormat != textureDesc.mFormat || imageDesc.mDescriptors != textureDesc.mDescriptors)
+		{
+			LOGF(LogLevel::eERROR, "Decoded image doesn't match its header, the texture load failed");
+			ResourceLoader::DestroyImage(pImage);
+			pImage = NULL;
+		}
+	}
+
+	if (pImage)
+	{
+		queueImageUpload(pJob->pTexture, pImage, true, pJob->mPriority, pJob->mToken, pJob->mProgressive);
+	}
+	else
+	{
+		// Nothing to upload, the texture keeps undefined contents. Unless it got cancelled the load failed
+		pResourceLoader->mQueueMutex.Acquire();
+		eastl::unordered_map<uint64_t, bool>::iterator it = pResourceLoader->mPreparingTokens.find((uint64_t)pJob->mToken);
+		bool const cancelled = it != pResourceLoader->mPreparingTokens.end() && it->second;
+		if (it != pResourceLoader->mPreparingTokens.end())
+			pResourceLoader->mPreparingTokens.erase(it);
+		pResourceLoader->mQueueMutex.Release();
+		uint64_t const token = pJob->mToken;
+		if (cancelled)
+			completeTokens(pResourceLoader, &token, 1);
+		else
+			failToken(pResourceLoader, token);
+	}
+
+	pResourceLoader->mQueueMutex.Acquire();
+	pResourceLoader->mPreparingTextures.erase(pJob->pTexture);
+	pResourceLoader->mQueueMutex.Release();
+	pResourceLoader->mPreparingCond.WakeAll();
+
+	fsFreePath(pJob->pFilePath);
+	conf_free(pJob);
 }
 
+static void hash128(const void* pData, size_t size, uint64_t pOutHash[2]);
+
 void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 {
 	ASSERT(pTextureDesc->ppTexture);
@@ -1106,7 +2223,6 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 	
 	if (pTextureDesc->pFilePath)
 	{
-		pImage = ResourceLoader::CreateImage(pTextureDesc->pFilePath, NULL, NULL);
 #if !defined(METAL) && !defined(DIRECT3D11)
 		PathComponent component = fsGetPathExtension(pTextureDesc->pFilePath);
 		
@@ -1114,24 +2230,31 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 
 		if (isSparseVirtualTexture)
 		{
+			// Only the page table is loaded, pages are read from the file once they become visible
+			SVTPageReader* pReader = NULL;
+			FileStream* pStream = fsOpenFile(pTextureDesc->pFilePath, FM_READ_BINARY);
+			if (!pStream || !Image::OpenSVT(pStream, &pReader))
+			{
+				LOGF(LogLevel::eERROR, "Failed to open sparse virtual texture %s", fsGetPathAsNativeString(pTextureDesc->pFilePath));
+				return;
+			}
+
 			TextureDesc SVTDesc = {};
-			SVTDesc.mWidth = pImage->GetWidth();
-			SVTDesc.mHeight = pImage->GetHeight();
-			SVTDesc.mDepth = pImage->GetDepth();
+			SVTDesc.mWidth = pReader->mWidth;
+			SVTDesc.mHeight = pReader->mHeight;
+			SVTDesc.mDepth = 1;
 			SVTDesc.mFlags = TEXTURE_CREATION_FLAG_NONE;
-			SVTDesc.mFormat = pImage->GetFormat();
+			SVTDesc.mFormat = TinyImageFormat_R8G8B8A8_UNORM;
 			SVTDesc.mHostVisible = false;
-			SVTDesc.mMipLevels = pImage->GetMipMapCount();
+			SVTDesc.mMipLevels = pReader->mMipMapCount;
 			SVTDesc.mSampleCount = SAMPLE_COUNT_1;
 			//SVTDesc.mStartState = RESOURCE_STATE_COMMON;
 			SVTDesc.mStartState = RESOURCE_STATE_COPY_DEST;
 			SVTDesc.mDescriptors = DESCRIPTOR_TYPE_TEXTURE;
 			pTextureDesc->pDesc = &SVTDesc;
 
-			addVirtualTexture(pResourceLoader->pRenderer, pTextureDesc->pDesc, pTextureDesc->ppTexture, pImage->GetPixels());
-
-			conf_free(pImage->GetPixels());
-			conf_free(pImage);
+			VirtualTexturePageSource pageSource = { readVirtualTexturePage, releaseVirtualTexturePageSource, pReader };
+			addVirtualTexture(pResourceLoader->pRenderer, pTextureDesc->pDesc, pTextureDesc->ppTexture, &pageSource);
 
 			/************************************************************************/
 			// Create visibility buffer
@@ -1232,22 +2355,102 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 
 			return;
 		}
-		else
+#endif
+	}
+
+	if (pTextureDesc->pFilePath || pTextureDesc->pBinaryImageData)
+	{
+		// Shared loads keep the lock until the texture exists, so every holder gets the same one
+		bool const    shared = pTextureDesc->mShared;
+		eastl::string key;
+		if (shared)
 		{
-			if (!pImage)
+			// Files by path, binary image data by its contents
+			if (pTextureDesc->pFilePath)
+			{
+				key.sprintf("%s", fsGetPathAsNativeString(pTextureDesc->pFilePath));
+			}
+			else
+			{
+				const BinaryImageData* pData = pTextureDesc->pBinaryImageData;
+				uint64_t               contentHash[2];
+				hash128(pData->pBinaryData, pData->mSize, contentHash);
+				key.sprintf(
+					"|%016llx%016llx|%u|%s", (unsigned long long)contentHash[0], (unsigned long long)contentHash[1], pData->mSize,
+					pData->pExtension ? pData->pExtension : "");
+			}
+			// A progressive load completes its token with the mip tail, it can't stand in for a complete one
+			key.append_sprintf("|%u|%u|%u", (uint32_t)pTextureDesc->mCreationFlag, pTextureDesc->mNodeIndex, (uint32_t)pTextureDesc->mProgressive);
+
+			pResourceLoader->mSharedTextureMutex.Acquire();
+			eastl::unordered_map<eastl::string, SharedTexture*>::iterator it = pResourceLoader->mSharedTextures.find(key);
+			if (it != pResourceLoader->mSharedTextures.end())
 			{
+				// Loaded or still loading, share the texture and the in-flight token
+				SharedTexture* pShared = it->second;
+				++pShared->mRefCount;
+				*pTextureDesc->ppTexture = pShared->pTexture;
+				if (token) *token = pShared->mToken;
+				pResourceLoader->mSharedTextureMutex.Release();
 				return;
-			}			
+			}
 		}
-#else
-		if (!pImage)
+
+		ImageProbeInfo info = {};
+		SyncToken      t = 0;
+		if (ResourceLoader::ProbeImage(pTextureDesc->pFilePath, pTextureDesc->pBinaryImageData, &info))
 		{
-			return;
+			addImageTexture(pTextureDesc->ppTexture, info, pTextureDesc->pFilePath, pTextureDesc->mCreationFlag, pTextureDesc->mNodeIndex);
+			t = reserveToken(pResourceLoader);
+
+			TextureLoadJob* pJob = (TextureLoadJob*)conf_calloc(1, sizeof(TextureLoadJob));
+			pJob->pTexture = *pTextureDesc->ppTexture;
+			fillImageTextureDesc(&pJob->mDesc, info, pTextureDesc->mCreationFlag, pTextureDesc->mNodeIndex);
+			pJob->pFilePath = pTextureDesc->pFilePath ? fsCopyPath(pTextureDesc->pFilePath) : NULL;
+			if (!pJob->pFilePath)
+				pJob->mBinaryImageData = *pTextureDesc->pBinaryImageData;
+			pJob->mPriority = pTextureDesc->mPriority;
+			pJob->mToken = t;
+			pJob->mProgressive = pTextureDesc->mProgressive;
+			pResourceLoader->mQueueMutex.Acquire();
+			pResourceLoader->mPreparingTokens[(uint64_t)t] = false;
+			pResourceLoader->mPreparingTextures[pJob->pTexture] = pJob->mProgressive;
+			pResourceLoader->mQueueMutex.Release();
+			addThreadSystemTask(pResourceLoader->pThreadSystem, loadTextureTask, pJob);
 		}
-#endif
-		freeImage = true;
+		else
+		{
+			// Without a header probe the layout is only known after decoding, which then happens here
+			pImage = loadTextureImage(pTextureDesc->pFilePath, pTextureDesc->pBinaryImageData);
+			*pTextureDesc->ppTexture = NULL;
+			if (pImage)
+			{
+				t = reserveToken(pResourceLoader);
+				addTextureFromImage(
+					pTextureDesc->ppTexture, pImage, true, pTextureDesc->mCreationFlag, pTextureDesc->mNodeIndex, pTextureDesc->mPriority, t,
+					pTextureDesc->mProgressive);
+			}
+		}
+
+		if (shared)
+		{
+			if (*pTextureDesc->ppTexture)
+			{
+				SharedTexture* pShared = conf_new(SharedTexture);
+				pShared->mKey = key;
+				pShared->pTexture = *pTextureDesc->ppTexture;
+				pShared->mToken = t;
+				pShared->mRefCount = 1;
+				pResourceLoader->mSharedTextures[key] = pShared;
+				pResourceLoader->mSharedTextureOwners[pShared->pTexture] = pShared;
+				pResourceLoader->mSharedTextureTokens[(uint64_t)t] = pShared;
+			}
+			pResourceLoader->mSharedTextureMutex.Release();
+		}
+		if (token) *token = t;
+		return;
 	}
-	else if (!pTextureDesc->pFilePath && !pTextureDesc->pRawImageData && !pTextureDesc->pBinaryImageData && pTextureDesc->pDesc)
+	else if (!pTextureDesc->pRawImageData && pTextureDesc->pDesc)
 	{
 		// If texture is supposed to be filled later (UAV / Update later / ...) proceed with the mStartState provided by the user in the texture description
 		addTexture(pResourceLoader->pRenderer, pTextureDesc->pDesc, pTextureDesc->ppTexture);
@@ -1256,66 +2459,27 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 		if (pResourceLoader->pRenderer->mSettings.mApi == RENDERER_API_VULKAN &&
 			// Check whether this is required (user specified a state other than undefined / common)
 			(pTextureDesc->pDesc->mStartState != RESOURCE_STATE_UNDEFINED && pTextureDesc->pDesc->mStartState != RESOURCE_STATE_COMMON))
-			queueResourceUpdate(pResourceLoader, *pTextureDesc->ppTexture, token);
+			queueResourceUpdate(pResourceLoader, *pTextureDesc->ppTexture, pTextureDesc->mPriority, token);
 		return;
 	}
-	else if (pTextureDesc->pRawImageData && !pTextureDesc->pBinaryImageData)
+	else if (pTextureDesc->pRawImageData)
 	{
 		pImage = ResourceLoader::CreateImage(pTextureDesc->pRawImageData->mFormat, pTextureDesc->pRawImageData->mWidth, pTextureDesc->pRawImageData->mHeight, pTextureDesc->pRawImageData->mDepth, pTextureDesc->pRawImageData->mMipLevels, pTextureDesc->pRawImageData->mArraySize, pTextureDesc->pRawImageData->pRawData);
 		pImage->SetMipsAfterSlices(pTextureDesc->pRawImageData->mMipsAfterSlices);
 		freeImage = true;
 	}
-	else if (pTextureDesc->pBinaryImageData)
-	{
-		pImage = ResourceLoader::CreateImage(pTextureDesc->pBinaryImageData->pBinaryData, pTextureDesc->pBinaryImageData->mSize, pTextureDesc->pBinaryImageData->pExtension, NULL, NULL);
-#ifdef _DEBUG
-		bool success = pImage;
-#endif
-#ifdef _DEBUG
-		ASSERT(success);
-#endif
-		freeImage = true;
-	}
 	else
-		ASSERT(0 && "Invalid params");
-
-	TextureDesc desc = {};
-	desc.mFlags = pTextureDesc->mCreationFlag;
-	desc.mWidth = pImage->GetWidth();
-	desc.mHeight = pImage->GetHeight();
-	desc.mDepth = max(1U, pImage->GetDepth());
-	desc.mArraySize = pImage->GetArrayCount();
-
-	desc.mMipLevels = pImage->GetMipMapCount();
-	desc.mSampleCount = SAMPLE_COUNT_1;
-	desc.mSampleQuality = 0;
-	desc.mFormat = pImage->GetFormat();
-
-	desc.mClearValue = ClearValue();
-	desc.mDescriptors = DESCRIPTOR_TYPE_TEXTURE;
-	desc.mStartState = RESOURCE_STATE_COMMON;
-	desc.pNativeHandle = NULL;
-	desc.mHostVisible = false;
-	desc.mNodeIndex = pTextureDesc->mNodeIndex;
-
-	if (pImage->IsCube())
 	{
-		desc.mDescriptors |= DESCRIPTOR_TYPE_TEXTURE_CUBE;
-		desc.mArraySize *= 6;
+		ASSERT(0 && "Invalid params");
+		return;
 	}
 
-	wchar_t debugName[MAX_PATH] = {};
-	desc.pDebugName = debugName;
-	
-	if (const Path *path = pImage->GetPath()) {
-		PathComponent fileName = fsGetPathFileName(path);
-		mbstowcs(debugName, fileName.buffer, min((size_t)MAX_PATH, fileName.length));
-	}
-   
-	addTexture(pResourceLoader->pRenderer, &desc, pTextureDesc->ppTexture);
+	SyncToken t = reserveToken(pResourceLoader);
 
-	TextureUpdateDescInternal updateDesc = { *pTextureDesc->ppTexture, pImage, freeImage };
-	queueResourceUpdate(pResourceLoader, &updateDesc, token);
+	addTextureFromImage(
+		pTextureDesc->ppTexture, pImage, freeImage, pTextureDesc->mCreationFlag, pTextureDesc->mNodeIndex, pTextureDesc->mPriority, t,
+		pTextureDesc->mProgressive);
+	if (token) *token = t;
 }
 
 void updateResource(BufferUpdateDesc* pBufferUpdate, bool batch)
@@ -1362,10 +2526,66 @@ void updateResource(BufferUpdateDesc* pBufferUpdate, SyncToken* token)
 	}
 }
 
+void beginUpdateResource(BufferUpdateDesc* pBufferUpdate)
+{
+	Buffer* pBuffer = pBufferUpdate->pBuffer;
+	ASSERT(pBuffer);
+
+	uint64_t const alignment = pBuffer->mDesc.mDescriptors & DESCRIPTOR_TYPE_UNIFORM_BUFFER
+								   ? pResourceLoader->pRenderer->pActiveGpuSettings->mUniformBufferAlignment
+								   : 1;
+	uint64_t const offset = round_up_64(pBufferUpdate->mDstOffset, alignment);
+	if (!pBufferUpdate->mSize)
+		pBufferUpdate->mSize = pBuffer->mDesc.mSize - offset;
+
+	pBufferUpdate->mInternal.pSrcBuffer = NULL;
+	pBufferUpdate->mInternal.mUnmap = false;
+
+	if (pBuffer->mDesc.mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY)
+	{
+		// GPU only memory can't be mapped, the caller writes into a pooled staging buffer that the copy queue copies from
+		pBufferUpdate->mInternal.pSrcBuffer = acquireStagingBuffer(pResourceLoader, pBuffer->mDesc.mNodeIndex, pBufferUpdate->mSize);
+#if defined(DIRECT3D11)
+		mapBuffer(pResourceLoader->pRenderer, pBufferUpdate->mInternal.pSrcBuffer, NULL);
+#endif
+		pBufferUpdate->pMappedData = pBufferUpdate->mInternal.pSrcBuffer->pCpuMappedAddress;
+	}
+	else
+	{
+		pBufferUpdate->mInternal.mUnmap = !pBuffer->pCpuMappedAddress;
+		if (pBufferUpdate->mInternal.mUnmap)
+			mapBuffer(pResourceLoader->pRenderer, pBuffer, NULL);
+		pBufferUpdate->pMappedData = (uint8_t*)pBuffer->pCpuMappedAddress + offset;
+	}
+}
+
+void endUpdateResource(BufferUpdateDesc* pBufferUpdate, SyncToken* token)
+{
+	ASSERT(pBufferUpdate->pMappedData && "endUpdateResource without beginUpdateResource");
+	pBufferUpdate->pMappedData = NULL;
+
+	if (pBufferUpdate->mInternal.pSrcBuffer)
+	{
+		SyncToken updateToken;
+		queueResourceUpdate(pResourceLoader, pBufferUpdate, &updateToken);
+#if defined(DIRECT3D11)
+		waitTokenCompleted(updateToken);
+#endif
+		if (token) *token = updateToken;
+		pBufferUpdate->mInternal.pSrcBuffer = NULL;
+	}
+	else if (pBufferUpdate->mInternal.mUnmap)
+	{
+		unmapBuffer(pResourceLoader->pRenderer, pBufferUpdate->pBuffer);
+		pBufferUpdate->mInternal.mUnmap = false;
+	}
+}
+
 void updateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token)
 {	
-	TextureUpdateDescInternal desc;
+	TextureUpdateDescInternal desc = {};
 	desc.pTexture = pTextureUpdate->pTexture;
+	desc.mPriority = pTextureUpdate->mPriority;
 	if (pTextureUpdate->pRawImageData)
 	{
 		Image* pImage = ResourceLoader::CreateImage(pTextureUpdate->pRawImageData->mFormat, pTextureUpdate->pRawImageData->mWidth, pTextureUpdate->pRawImageData->mHeight,
@@ -1406,24 +2626,188 @@ void updateResources(uint32_t resourceCount, ResourceUpdateDesc* pResources, Syn
 
 void removeResource(Texture* pTexture)
 {
+	pResourceLoader->mSharedTextureMutex.Acquire();
+	eastl::unordered_map<Texture*, SharedTexture*>::iterator it = pResourceLoader->mSharedTextureOwners.find(pTexture);
+	if (it != pResourceLoader->mSharedTextureOwners.end())
+	{
+		SharedTexture* pShared = it->second;
+		if (--pShared->mRefCount)
+		{
+			pResourceLoader->mSharedTextureMutex.Release();
+			return;
+		}
+
+		pResourceLoader->mSharedTextureOwners.erase(it);
+		eastl::unordered_map<eastl::string, SharedTexture*>::iterator entry = pResourceLoader->mSharedTextures.find(pShared->mKey);
+		if (entry != pResourceLoader->mSharedTextures.end() && entry->second == pShared)
+		{
+			pResourceLoader->mSharedTextures.erase(entry);
+			pResourceLoader->mSharedTextureTokens.erase((uint64_t)pShared->mToken);
+		}
+		conf_delete(pShared);
+	}
+	pResourceLoader->mSharedTextureMutex.Release();
+
+	// A load that is still decoding, cancelled or not, may use the texture until its job is done with it
+	pResourceLoader->mQueueMutex.Acquire();
+	while (pResourceLoader->mPreparingTextures.find(pTexture) != pResourceLoader->mPreparingTextures.end())
+		pResourceLoader->mPreparingCond.Wait(pResourceLoader->mQueueMutex);
+	pResourceLoader->mQueueMutex.Release();
+
+	pResourceLoader->mTextureStreamMutex.Acquire();
+	TextureStream* pStream = NULL;
+	eastl::unordered_map<Texture*, TextureStream*>::iterator stream = pResourceLoader->mTextureStreams.find(pTexture);
+	if (stream != pResourceLoader->mTextureStreams.end())
+	{
+		pStream = stream->second;
+		pResourceLoader->mTextureStreams.erase(stream);
+	}
+	pResourceLoader->mTextureStreamMutex.Release();
+
+	if (pStream)
+	{
+		// Mips that are still streaming are dropped, the ones being copied have to finish first
+		for (uint32_t mip = 0; mip <= pStream->mTailMip; ++mip)
+		{
+			SyncToken token = pStream->mTokens[mip];
+			if (pStream->mTokens[mip] != UINT64_MAX && !cancelResourceRequest(pResourceLoader, token))
+				waitTokenDone(pResourceLoader, pStream->mTokens[mip]);
+		}
+		conf_delete(pStream);
+	}
+
 	removeTexture(pResourceLoader->pRenderer, pTexture);
 }
 
+uint32_t getTextureResidentMip(Texture* pTexture)
+{
+	// Nothing of a progressive load is resident while decoding, its stream is published before the job lets go of the texture
+	pResourceLoader->mQueueMutex.Acquire();
+	eastl::unordered_map<Texture*, bool>::iterator preparing = pResourceLoader->mPreparingTextures.find(pTexture);
+	bool const decoding = preparing != pResourceLoader->mPreparingTextures.end() && preparing->second;
+	pResourceLoader->mQueueMutex.Release();
+	if (decoding)
+		return pTexture->mDesc.mMipLevels;
+
+	uint32_t residentMip = 0;
+	pResourceLoader->mTextureStreamMutex.Acquire();
+	eastl::unordered_map<Texture*, TextureStream*>::iterator it = pResourceLoader->mTextureStreams.find(pTexture);
+	if (it != pResourceLoader->mTextureStreams.end())
+	{
+		TextureStream* pStream = it->second;
+		residentMip = pTexture->mDesc.mMipLevels;
+		pResourceLoader->mTokenMutex.Acquire();
+		for (uint32_t mip = pStream->mTailMip + 1; mip-- > 0 && isTokenDone(pResourceLoader, pStream->mTokens[mip]);)
+			residentMip = mip;
+		pResourceLoader->mTokenMutex.Release();
+	}
+	pResourceLoader->mTextureStreamMutex.Release();
+	return residentMip;
+}
+
 void removeResource(Buffer* pBuffer)
 {
 	removeBuffer(pResourceLoader->pRenderer, pBuffer);
 }
 
+bool probeTexture(const Path* pFilePath, TextureDesc* pOutDesc)
+{
+	ASSERT(pFilePath && pOutDesc);
+
+	ImageProbeInfo info = {};
+	if (!Image::ProbeFile(pFilePath, &info))
+		return false;
+
+	pOutDesc->mWidth = info.mWidth;
+	pOutDesc->mHeight = info.mHeight;
+	pOutDesc->mDepth = info.mDepth;
+	pOutDesc->mArraySize = info.mArrayCount;
+	pOutDesc->mMipLevels = info.mMipMapCount;
+	pOutDesc->mFormat = info.mFormat;
+	pOutDesc->mDescriptors = DESCRIPTOR_TYPE_TEXTURE;
+
+	if (info.mIsCube)
+	{
+		pOutDesc->mDescriptors |= DESCRIPTOR_TYPE_TEXTURE_CUBE;
+		pOutDesc->mArraySize *= 6;
+	}
+
+	return true;
+}
+
 bool isTokenCompleted(SyncToken token)
 {
 	return isTokenCompleted(pResourceLoader, token);
 }
 
+bool isTokenFailed(SyncToken token)
+{
+	return isTokenFailed(pResourceLoader, token);
+}
+
 void waitTokenCompleted(SyncToken token)
 {
 	waitTokenCompleted(pResourceLoader, token);
 }
 
+void getResourceLoaderStats(ResourceLoaderStats* pOutStats)
+{
+	ASSERT(pOutStats);
+	ResourceLoader* pLoader = pResourceLoader;
+	int64_t const now = getUSec();
+	*pOutStats = {};
+
+	pOutStats->mElapsedTimeUs = (uint64_t)(now - pLoader->mStartTimeUs);
+	pOutStats->mBytesPerSecond = tfrg_atomic64_load_relaxed(&pLoader->mBytesPerSecond);
+
+	pLoader->mQueueMutex.Acquire();
+	for (uint32_t i = 0; i < MAX_GPUS; ++i)
+	{
+		pOutStats->mQueueDepth += (uint32_t)pLoader->mRequestQueue[i].size();
+		for (const UpdateRequest& request : pLoader->mRequestQueue[i])
+			pOutStats->mOldestRequestAgeUs = max(pOutStats->mOldestRequestAgeUs, (uint64_t)(now - request.mQueueTimeUs));
+	}
+	pOutStats->mPreparingTextureCount = (uint32_t)pLoader->mPreparingTokens.size();
+	pLoader->mQueueMutex.Release();
+
+	pOutStats->mStagingStallCount = tfrg_atomic64_load_relaxed(&pLoader->mStagingStallCount);
+	pOutStats->mStagingStallTimeUs = tfrg_atomic64_load_relaxed(&pLoader->mStagingStallTimeUs);
+	pOutStats->mStagingGrowCount = tfrg_atomic64_load_relaxed(&pLoader->mStagingGrowCount);
+	pOutStats->mStagingBufferSize = tfrg_atomic64_load_relaxed(&pLoader->mStagingBufferSize);
+	pOutStats->mDecodeTimeUs = tfrg_atomic64_load_relaxed(&pLoader->mDecodeTimeUs);
+	pOutStats->mDecodeCount = tfrg_atomic64_load_relaxed(&pLoader->mDecodeCount);
+
+	for (uint32_t i = 0; i < MAX_GPUS; ++i)
+	{
+		ResourceLoaderNodeStats& node = pOutStats->mNodes[i];
+		node.mUploadedBytes = tfrg_atomic64_load_relaxed(&pLoader->mNodeStats[i].mUploadedBytes);
+		node.mRequestCount = tfrg_atomic64_load_relaxed(&pLoader->mNodeStats[i].mRequestCount);
+		node.mRecordTimeUs = tfrg_atomic64_load_relaxed(&pLoader->mNodeStats[i].mRecordTimeUs);
+		node.mFenceWaitTimeUs = tfrg_atomic64_load_relaxed(&pLoader->mNodeStats[i].mFenceWaitTimeUs);
+		pOutStats->mUploadedBytes += node.mUploadedBytes;
+	}
+}
+
+bool cancelResourceRequest(SyncToken token)
+{
+	return cancelResourceRequest(pResourceLoader, token);
+}
+
+void addResourceCallback(SyncToken token, ResourceCallbackMode mode, ResourceLoadedCallback pCallback, void* pUserData)
+{
+	addResourceCallback(pResourceLoader, token, mode, pCallback, pUserData);
+}
+
+void processResourceCallbacks()
+{
+	processResourceCallbacks(pResourceLoader);
+}
+
+SyncToken addTokenGroup(const SyncToken* pTokens, uint32_t tokenCount)
+{
+	return addTokenGroup(pResourceLoader, pTokens, tokenCount);
+}
+
 bool isBatchCompleted()
 {
 	SyncToken token = tfrg_atomic64_load_relaxed(&pResourceLoader->mTokenCounter);
@@ -1449,7 +2833,7 @@ void finishResourceLoading()
 /************************************************************************/
 // Shader loading
 /************************************************************************/
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) || (defined(__linux__) && defined(VULKAN))
 // Translate Vulkan Shader Type to shaderc shader type
 shaderc_shader_kind getShadercShaderType(ShaderStage type)
 {
@@ -1467,6 +2851,10 @@ shaderc_shader_kind getShadercShaderType(ShaderStage type)
 }
 #endif
 
+bool save_byte_code(const Path* binaryShaderPath, const eastl::vector<char>& byteCode);
+Path* copy_byte_code_temp_path(const Path* binaryShaderPath);
+bool  move_byte_code(const Path* tempPath, const Path* binaryShaderPath);
+
 #if defined(VULKAN)
 #if defined(__ANDROID__)
 // Android:
@@ -1501,7 +2889,101 @@ void vk_compileShader(
 	shaderc_result_release(spvShader);
 	shaderc_compiler_release(compiler);
 }
+#elif defined(__linux__)
+typedef struct ShadercInclude
+{
+	shaderc_include_result mResult;
+	eastl::string          mSourceName;
+	eastl::string          mContent;
+} ShadercInclude;
+
+// Includes are resolved relative to the including file, on the file system of the shader source (pUserData)
+static shaderc_include_result* resolveShadercInclude(
+	void* pUserData, const char* pRequestedSource, int type, const char* pRequestingSource, size_t includeDepth)
+{
+	const FileSystem* pFileSystem = (const FileSystem*)pUserData;
+	ShadercInclude*   pInclude = conf_new(ShadercInclude);
+
+	PathHandle  requestingPath = fsCreatePath(pFileSystem, pRequestingSource);
+	PathHandle  includeDirectory = fsCopyParentPath(requestingPath);
+	PathHandle  includePath = fsAppendPathComponent(includeDirectory, pRequestedSource);
+	FileStream* fh = includePath ? fsOpenFile(includePath, FM_READ_BINARY) : NULL;
+	if (fh)
+	{
+		pInclude->mSourceName = fsGetPathAsNativeString(includePath);
+		pInclude->mContent = fsReadFromStreamSTLString(fh);
+		fsCloseStream(fh);
+	}
+	else
+	{
+		// An empty source name tells shaderc the include failed, the content is the error message
+		pInclude->mContent.sprintf("Cannot open #include file: %s", pRequestedSource);
+	}
+
+	pInclude->mResult.source_name = pInclude->mSourceName.c_str();
+	pInclude->mResult.source_name_length = pInclude->mSourceName.size();
+	pInclude->mResult.content = pInclude->mContent.c_str();
+	pInclude->mResult.content_length = pInclude->mContent.size();
+	pInclude->mResult.user_data = pInclude;
+	return &pInclude->mResult;
+}
+
+static void releaseShadercInclude(void*, shaderc_include_result* pResult)
+{
+	conf_delete((ShadercInclude*)pResult->user_data);
+}
+
+// Linux:
+// Use shaderc to compile glsl to spirV in process. The source comes from memory, includes are read through the file system
+void vk_compileShader(
+	Renderer* pRenderer, ShaderTarget target, ShaderStage stage, const Path* filePath, uint32_t codeSize, const char* code,
+	const Path* outFilePath, uint32_t macroCount, ShaderMacro* pMacros, eastl::vector<char>* pByteCode, const char* pEntryPoint)
+{
+	// The compiler is stateless and thread safe, one instance serves every compile
+	static shaderc_compiler_t compiler = shaderc_compiler_initialize();
+
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+	if (target >= shader_target_6_0)
+		shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+	shaderc_compile_options_add_macro_definition(options, "LINUX", strlen("LINUX"), NULL, 0);
+	shaderc_compile_options_set_include_callbacks(
+		options, resolveShadercInclude, releaseShadercInclude, (void*)fsGetPathFileSystem(filePath));
+	for (uint32_t i = 0; i < macroCount; ++i)
+	{
+		shaderc_compile_options_add_macro_definition(options, pMacros[i].definition, strlen(pMacros[i].definition),
+			pMacros[i].value, strlen(pMacros[i].value));
+	}
+
+	const char* fileName = fsGetPathAsNativeString(filePath);
+	shaderc_compilation_result_t spvShader = shaderc_compile_into_spv(
+		compiler, code, codeSize, getShadercShaderType(stage), fileName, pEntryPoint ? pEntryPoint : "main", options);
+	if (shaderc_result_get_compilation_status(spvShader) == shaderc_compilation_status_success)
+	{
+		pByteCode->resize(shaderc_result_get_length(spvShader));
+		memcpy(pByteCode->data(), shaderc_result_get_bytes(spvShader), pByteCode->size());
+		if (!save_byte_code(outFilePath, *pByteCode))
+			LOGF(LogLevel::eWARNING, "Failed to save byte code for file %s", fileName);
+	}
+	else
+	{
+		LOGF(LogLevel::eERROR, "Failed to compile shader %s with error\n%s", fileName, shaderc_result_get_error_message(spvShader));
+	}
+
+	shaderc_result_release(spvShader);
+	shaderc_compile_options_release(options);
+}
 #else
+// glslangValidator of the Vulkan SDK, or the system one if no SDK is set up
+static eastl::string get_glslang_validator_path()
+{
+	eastl::string glslangValidator = getenv("VULKAN_SDK");
+	if (glslangValidator.size())
+		glslangValidator += "/bin/glslangValidator";
+	else
+		glslangValidator = "/usr/bin/glslangValidator";
+	return glslangValidator;
+}
+
 // PC:
 // Vulkan has no builtin functions to compile source to spirv
 // So we call the glslangValidator tool located inside VulkanSDK on user machine to compile the glsl code to spirv
@@ -1515,6 +2997,8 @@ void vk_compileShader(
 		fsCreateDirectory(parentDirectory);
 
 	eastl::string                  commandLine;
+	// glslangValidator writes the binary in pieces, it is moved to outFilePath once complete
+	PathHandle compiledFilePath = copy_byte_code_temp_path(outFilePath);
 
 	// If there is a config file located in the shader source directory use it to specify the limits
 	PathHandle configFilePath = fsAppendPathComponent(filePath, "config.conf");
@@ -1525,13 +3009,13 @@ void vk_compileShader(
 			"\"%s\" -V \"%s\" -o \"%s\"", 
 			fsGetPathAsNativeString(configFilePath), 
 			fsGetPathAsNativeString(filePath), 
-			fsGetPathAsNativeString(outFilePath));
+			fsGetPathAsNativeString(compiledFilePath));
 	}
 	else
 	{
 		commandLine.append_sprintf("-V \"%s\" -o \"%s\"", 
 			fsGetPathAsNativeString(filePath),
-			fsGetPathAsNativeString(outFilePath));
+			fsGetPathAsNativeString(compiledFilePath));
 	}
 
 	if (target >= shader_target_6_0)
@@ -1556,11 +3040,7 @@ void vk_compileShader(
 		commandLine += " \"-D" + eastl::string(pMacros[i].definition) + "=" + pMacros[i].value + "\"";
 	}
 
-	eastl::string glslangValidator = getenv("VULKAN_SDK");
-	if (glslangValidator.size())
-		glslangValidator += "/bin/glslangValidator";
-	else
-		glslangValidator = "/usr/bin/glslangValidator";
+	eastl::string const glslangValidator = get_glslang_validator_path();
 
 	const char* args[1] = { commandLine.c_str() };
 	
@@ -1569,12 +3049,14 @@ void vk_compileShader(
 	PathHandle logFilePath = fsAppendPathComponent(parentDirectory, logFileName.c_str());
 	if (systemRun(glslangValidator.c_str(), args, 1, logFilePath) == 0)
 	{		
-		FileStream* fh = fsOpenFile(outFilePath, FM_READ_BINARY);
+		FileStream* fh = fsOpenFile(compiledFilePath, FM_READ_BINARY);
 		//Check if the File Handle exists
 		ASSERT(fh);
 		pByteCode->resize(fsGetStreamFileSize(fh));
 		fsReadFromStream(fh, pByteCode->data(), pByteCode->size());
 		fsCloseStream(fh);
+		if (!move_byte_code(compiledFilePath, outFilePath))
+			LOGF(LogLevel::eWARNING, "Failed to save byte code for file %s", fsGetPathAsNativeString(filePath));
 	}
 	else
 	{
@@ -1607,7 +3089,9 @@ void mtl_compileShader(
         fsCreateDirectory(outFileDirectory);
     }
 
-    PathHandle intermediateFile = fsAppendPathExtension(outFilePath, "air");
+    // Both steps write to files of this compile only, the library is moved to outFilePath once complete
+    PathHandle compiledFilePath = copy_byte_code_temp_path(outFilePath);
+    PathHandle intermediateFile = fsAppendPathExtension(compiledFilePath, "air");
     
     const char *xcrun = "/usr/bin/xcrun";
 	eastl::vector<eastl::string> args;
@@ -1654,7 +3138,7 @@ void mtl_compileShader(
 			""
 			"%s"
 			"",
-			fsGetPathAsNativeString(outFilePath));
+			fsGetPathAsNativeString(compiledFilePath));
 		args.push_back(tmpArg);
         
         cArgs.clear();
@@ -1664,37 +3148,217 @@ void mtl_compileShader(
         
 		if (systemRun(xcrun, &cArgs[0], cArgs.size(), NULL) == 0)
 		{
-			// Remove the temp .air file.
-            const char *nativePath = fsGetPathAsNativeString(intermediateFile);
-			systemRun("rm", &nativePath, 1, NULL);
+			// Remove the temp .air file.
+            const char *nativePath = fsGetPathAsNativeString(intermediateFile);
+			systemRun("rm", &nativePath, 1, NULL);
+
+			// Store the compiled bytecode.
+			FileStream* fHandle = fsOpenFile(compiledFilePath, FM_READ_BINARY);
+			
+			ASSERT(fHandle);
+			pByteCode->resize(fsGetStreamFileSize(fHandle));
+            fsReadFromStream(fHandle, pByteCode->data(), pByteCode->size());
+            fsCloseStream(fHandle);
+			if (!move_byte_code(compiledFilePath, outFilePath))
+				LOGF(eWARNING, "Failed to save byte code for file %s", fsGetPathFileName(outFilePath).buffer);
+		}
+		else
+        {
+			LOGF(eERROR, "Failed to assemble shader's %s .metallib file", fsGetPathFileName(outFilePath));
+        }
+	}
+	else
+    {
+		LOGF(eERROR, "Failed to compile shader %s", fsGetPathFileName(outFilePath));
+    }
+}
+#endif
+#if (defined(DIRECT3D12) || defined(DIRECT3D11))
+extern void compileShader(
+	Renderer* pRenderer, ShaderTarget target, ShaderStage stage, const Path* filePath, uint32_t codeSize, const char* code,
+	uint32_t macroCount, ShaderMacro* pMacros, void* (*allocator)(size_t a, const char *f, int l, const char *sf), uint32_t* pByteCodeSize, char** ppByteCode, const char* pEntryPoint);
+extern void getShaderCompilerVersion(Renderer* pRenderer, ShaderTarget target, char* pVersion, uint32_t versionSize);
+#endif
+
+static inline uint64_t rotl64(uint64_t x, uint32_t r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+// MurmurHash3 x64 128
+static void hash128(const void* pData, size_t size, uint64_t pOutHash[2])
+{
+	const uint8_t* data = (const uint8_t*)pData;
+	const size_t   blockCount = size / 16;
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+	uint64_t       h1 = 0;
+	uint64_t       h2 = 0;
+
+	for (size_t i = 0; i < blockCount; ++i)
+	{
+		uint64_t k1, k2;
+		memcpy(&k1, data + i * 16, sizeof(k1));
+		memcpy(&k2, data + i * 16 + 8, sizeof(k2));
+
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const uint8_t* tail = data + blockCount * 16;
+	const size_t   tailSize = size & 15;
+	uint64_t       k1 = 0;
+	uint64_t       k2 = 0;
+	for (size_t i = tailSize; i > 8; --i)
+		k2 ^= (uint64_t)tail[i - 1] << ((i - 9) * 8);
+	for (size_t i = min(tailSize, (size_t)8); i > 0; --i)
+		k1 ^= (uint64_t)tail[i - 1] << ((i - 1) * 8);
+	if (tailSize > 8)
+	{
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+	if (tailSize)
+	{
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= size;
+	h2 ^= size;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+	pOutHash[0] = h1;
+	pOutHash[1] = h2;
+}
+
+#define MAX_SHADER_INCLUDE_DEPTH 64
+
+// Gets the file name of a quoted #include directive that isn't commented out
+static bool parse_include_directive(const eastl::string& line, eastl::string& outFileName)
+{
+	static const char pIncludeDirective[] = "#include";
+	size_t const filePos = line.find(pIncludeDirective, 0);
+	if (filePos == eastl::string::npos)
+		return false;
+
+	const size_t commentPosCpp = line.find("//", 0);
+	const size_t commentPosC = line.find("/*", 0);
+	if ((commentPosCpp != eastl::string::npos && commentPosCpp < filePos) || (commentPosC != eastl::string::npos && commentPosC < filePos))
+		return false;
+
+	// skip empty spaces, bracket includes are disregarded
+	size_t currentPos = line.find_first_not_of(' ', filePos + strlen(pIncludeDirective));
+	if (currentPos == eastl::string::npos || line[currentPos] != '\"')
+		return false;
+
+	size_t const nameEnd = line.find('\"', currentPos + 1);
+	if (nameEnd == eastl::string::npos || nameEnd == currentPos + 1)
+		return false;
+
+	outFileName = line.substr(currentPos + 1, nameEnd - currentPos - 1);
+	return true;
+}
+
+#ifndef TARGET_IOS
+// Appends the content hashes of an include file and everything it includes. Parsed files are cached and only read
+// again once their modification time changes, so headers shared by many shaders are parsed once
+static bool hash_shader_include(
+	ResourceLoader* pLoader, const Path* filePath, time_t& outTimeStamp, eastl::vector<uint64_t>& outIncludeHashes, uint32_t depth)
+{
+	if (depth > MAX_SHADER_INCLUDE_DEPTH)
+	{
+		LOGF(LogLevel::eERROR, "#include nested too deeply, recursive include? %s", fsGetPathAsNativeString(filePath));
+		return false;
+	}
+
+	eastl::string const key = fsGetPathAsNativeString(filePath);
+	time_t const        modifiedTime = fsGetLastModifiedTime(filePath);
+
+	ShaderIncludeNode node;
+	bool              cached = false;
+	if (pLoader)
+	{
+		pLoader->mShaderIncludeMutex.Acquire();
+		eastl::unordered_map<eastl::string, ShaderIncludeNode>::iterator it = pLoader->mShaderIncludes.find(key);
+		if (it != pLoader->mShaderIncludes.end() && it->second.mModifiedTime == modifiedTime)
+		{
+			node = it->second;
+			cached = true;
+		}
+		pLoader->mShaderIncludeMutex.Release();
+	}
 
-			// Store the compiled bytecode.
-			FileStream* fHandle = fsOpenFile(outFilePath, FM_READ_BINARY);
-			
-			ASSERT(fHandle);
-			pByteCode->resize(fsGetStreamFileSize(fHandle));
-            fsReadFromStream(fHandle, pByteCode->data(), pByteCode->size());
-            fsCloseStream(fHandle);
+	if (!cached)
+	{
+		FileStream* fh = fsOpenFile(filePath, FM_READ_BINARY);
+		if (!fh)
+		{
+			LOGF(LogLevel::eERROR, "Cannot open #include file: %s", key.c_str());
+			return false;
+		}
+		eastl::string const content = fsReadFromStreamSTLString(fh);
+		fsCloseStream(fh);
+
+		node.mModifiedTime = modifiedTime;
+		hash128(content.data(), content.size(), node.mContentHash);
+
+		PathHandle    fileDirectory = fsCopyParentPath(filePath);
+		eastl::string fileName;
+		for (size_t lineStart = 0; lineStart < content.size();)
+		{
+			size_t lineEnd = content.find('\n', lineStart);
+			if (lineEnd == eastl::string::npos)
+				lineEnd = content.size();
+			if (parse_include_directive(content.substr(lineStart, lineEnd - lineStart), fileName))
+			{
+				PathHandle includeFilePath = fsAppendPathComponent(fileDirectory, fileName.c_str());
+				node.mIncludes.push_back(fsGetPathAsNativeString(includeFilePath));
+			}
+			lineStart = lineEnd + 1;
+		}
+
+		if (pLoader)
+		{
+			pLoader->mShaderIncludeMutex.Acquire();
+			pLoader->mShaderIncludes[key] = node;
+			pLoader->mShaderIncludesDirty = true;
+			pLoader->mShaderIncludeMutex.Release();
 		}
-		else
-        {
-			LOGF(eERROR, "Failed to assemble shader's %s .metallib file", fsGetPathFileName(outFilePath));
-        }
 	}
-	else
-    {
-		LOGF(eERROR, "Failed to compile shader %s", fsGetPathFileName(outFilePath));
-    }
+
+	if (modifiedTime > outTimeStamp)
+		outTimeStamp = modifiedTime;
+	outIncludeHashes.push_back(node.mContentHash[0]);
+	outIncludeHashes.push_back(node.mContentHash[1]);
+
+	for (const eastl::string& include : node.mIncludes)
+	{
+		PathHandle includeFilePath = fsCreatePath(fsGetPathFileSystem(filePath), include.c_str());
+		if (!hash_shader_include(pLoader, includeFilePath, outTimeStamp, outIncludeHashes, depth + 1))
+			return false;
+	}
+	return true;
 }
 #endif
-#if (defined(DIRECT3D12) || defined(DIRECT3D11))
-extern void compileShader(
-	Renderer* pRenderer, ShaderTarget target, ShaderStage stage, const Path* filePath, uint32_t codeSize, const char* code,
-	uint32_t macroCount, ShaderMacro* pMacros, void* (*allocator)(size_t a, const char *f, int l, const char *sf), uint32_t* pByteCodeSize, char** ppByteCode, const char* pEntryPoint);
-#endif
 
-// Function to generate the timestamp of this shader source file considering all include file timestamp
-static bool process_source_file(FileStream* original, const Path* filePath, FileStream* file, time_t& outTimeStamp, eastl::string& outCode)
+// Function to generate the timestamp of this shader source file considering all include file timestamp.
+// Outside iOS only the source itself goes to outCode, the compilers resolve includes. The content hashes of all
+// included files go to outIncludeHashes instead
+static bool process_source_file(
+	FileStream* original, const Path* filePath, FileStream* file, time_t& outTimeStamp, eastl::string& outCode,
+	eastl::vector<uint64_t>& outIncludeHashes)
 {
 	// If the source if a non-packaged file, store the timestamp
 	if (file)
@@ -1711,49 +3375,17 @@ static bool process_source_file(FileStream* original, const Path* filePath, File
     
     PathHandle fileDirectory = fsCopyParentPath(filePath);
 
-	const eastl::string pIncludeDirective = "#include";
 	while (!fsStreamAtEnd(file))
 	{
         eastl::string line = fsReadFromStreamSTLLine(file);
-        
-		size_t        filePos = line.find(pIncludeDirective, 0);
-		const size_t  commentPosCpp = line.find("//", 0);
-		const size_t  commentPosC = line.find("/*", 0);
 
-		// if we have an "#include \"" in our current line
-		const bool bLineHasIncludeDirective = filePos != eastl::string::npos;
-		const bool bLineIsCommentedOut = (commentPosCpp != eastl::string::npos && commentPosCpp < filePos) ||
-										 (commentPosC != eastl::string::npos && commentPosC < filePos);
-
-		if (bLineHasIncludeDirective && !bLineIsCommentedOut)
+		eastl::string fileName;
+		const bool    bLineHasIncludeDirective = parse_include_directive(line, fileName);
+		if (bLineHasIncludeDirective)
 		{
-			// get the include file name
-			size_t        currentPos = filePos + pIncludeDirective.length();
-			eastl::string fileName;
-			while (line.at(currentPos++) == ' ')
-				;    // skip empty spaces
-			if (currentPos >= line.size())
-				continue;
-			if (line.at(currentPos - 1) != '\"')
-				continue;
-			else
-			{
-				// read char by char until we have the include file name
-				while (line.at(currentPos) != '\"')
-				{
-					fileName.push_back(line.at(currentPos));
-					++currentPos;
-				}
-			}
-
-			// get the include file path
-			//TODO: Remove Comments
-            
-            if (fileName.at(0) == '<')    // disregard bracketsauthop
-                continue;
-            
             PathHandle includeFilePath = fsAppendPathComponent(fileDirectory, fileName.c_str());
 
+#ifdef TARGET_IOS
 			// open the include file
             FileStream* fHandle = fsOpenFile(includeFilePath, FM_READ_BINARY);
 			if (!fHandle)
@@ -1763,13 +3395,17 @@ static bool process_source_file(FileStream* original, const Path* filePath, File
 			}
 
 			// Add the include file into the current code recursively
-			if (!process_source_file(original, includeFilePath, fHandle, outTimeStamp, outCode))
+			if (!process_source_file(original, includeFilePath, fHandle, outTimeStamp, outCode, outIncludeHashes))
 			{
                 fsCloseStream(fHandle);
 				return false;
 			}
 
             fsCloseStream(fHandle);
+#else
+			if (!hash_shader_include(pResourceLoader, includeFilePath, outTimeStamp, outIncludeHashes, 0))
+				return false;
+#endif
 		}
 
 #ifdef TARGET_IOS
@@ -1799,15 +3435,148 @@ static bool process_source_file(FileStream* original, const Path* filePath, File
 	return true;
 }
 
-// Loads the bytecode from file if the binary shader file is newer than the source
-bool check_for_byte_code(const Path* binaryShaderPath, time_t sourceTimeStamp, eastl::vector<char>& byteCode)
+// Bump to invalidate every cached shader binary, e.g. when a compiler changes without changing its version string
+#define SHADER_BYTE_CODE_CACHE_VERSION 1
+
+#if (defined(VULKAN) && !defined(__ANDROID__) && !defined(__linux__)) || defined(METAL)
+// Runs a compiler with arguments that only make it print its version and returns what it printed
+static bool query_tool_version(const char* tool, const char** ppArgs, size_t argCount, eastl::string& outVersion)
 {
-	if (!fsFileExists(binaryShaderPath))
-		return false;
+	PathHandle outputPath = fsCopyPathInResourceDirectory(RD_SHADER_BINARIES, "compiler_version.txt");
+	PathHandle parentDirectory = fsCopyParentPath(outputPath);
+	if (!fsFileExists(parentDirectory))
+		fsCreateDirectory(parentDirectory);
+
+	PathHandle tempPath = copy_byte_code_temp_path(outputPath);
+	bool       result = false;
+	if (systemRun(tool, ppArgs, argCount, tempPath) == 0)
+	{
+		if (FileStream* fh = fsOpenFile(tempPath, FM_READ_BINARY))
+		{
+			outVersion = fsReadFromStreamSTLString(fh);
+			fsCloseStream(fh);
+			result = !outVersion.empty();
+		}
+	}
+	fsDeleteFile(tempPath);
+	return result;
+}
+#endif
+
+// Identifies the compiler producing the bytecode, so binaries built with another compiler are never reused.
+// Only versions go into it, no install paths, so the same compiler gives the same key on every machine
+static eastl::string query_shader_compiler_version(Renderer* pRenderer, ShaderTarget target)
+{
+	eastl::string version;
+	switch (pRenderer->mSettings.mApi)
+	{
+#if defined(DIRECT3D12) || defined(DIRECT3D11)
+		case RENDERER_API_D3D12:
+		case RENDERER_API_XBOX_D3D12:
+		case RENDERER_API_D3D11:
+		{
+			char compilerVersion[256] = {};
+			getShaderCompilerVersion(pRenderer, target, compilerVersion, sizeof(compilerVersion));
+			version = compilerVersion;
+			break;
+		}
+#endif
+#if defined(VULKAN)
+		case RENDERER_API_VULKAN:
+		{
+#if defined(__ANDROID__) || defined(__linux__)
+			// shaderc reports no build version of its own, it is linked from the SDK or NDK the Vulkan headers come from
+			unsigned int spvVersion = 0, spvRevision = 0;
+			shaderc_get_spv_version(&spvVersion, &spvRevision);
+			version.sprintf("shaderc headers %u spv %u.%u", (uint32_t)VK_HEADER_VERSION, spvVersion, spvRevision);
+#else
+			// Prints the glslang, ESSL, GLSL and SPIR-V versions of the validator
+			const char* args[1] = { "--version" };
+			if (!query_tool_version(get_glslang_validator_path().c_str(), args, 1, version))
+				LOGF(LogLevel::eWARNING, "Failed to query the glslangValidator version");
+#endif
+			break;
+		}
+#endif
+#if defined(METAL)
+		case RENDERER_API_METAL:
+		{
+			const char* args[4] = { "-sdk", "macosx", "metal", "--version" };
+			if (query_tool_version("/usr/bin/xcrun", args, 4, version))
+			{
+				// Only the first line holds the version, the following ones name the install directory
+				version.resize(eastl::min(version.size(), version.find_first_of("\r\n")));
+			}
+			else
+			{
+				LOGF(LogLevel::eWARNING, "Failed to query the metal compiler version");
+			}
+			break;
+		}
+#endif
+		default: break;
+	}
+	version.append_sprintf(" %u", SHADER_BYTE_CODE_CACHE_VERSION);
+	return version;
+}
+
+// Compiler versions are queried once per shader target, on some platforms that starts the compiler
+static eastl::string get_shader_compiler_version(Renderer* pRenderer, ShaderTarget target)
+{
+	if (!pResourceLoader)
+		return query_shader_compiler_version(pRenderer, target);
+
+	MutexLock lock(pResourceLoader->mShaderCompilerMutex);
+	eastl::unordered_map<uint32_t, eastl::string>::iterator it = pResourceLoader->mShaderCompilerVersions.find((uint32_t)target);
+	if (it == pResourceLoader->mShaderCompilerVersions.end())
+	{
+		it = pResourceLoader->mShaderCompilerVersions
+				 .insert(eastl::make_pair((uint32_t)target, query_shader_compiler_version(pRenderer, target)))
+				 .first;
+	}
+	return it->second;
+}
+
+// Binaries are named after a hash of everything that goes into the compile: the source and the files it includes, macros,
+// entry point, stage, target and compiler. Identical inputs share one binary and no file path or timestamp is part
+// of the key, so a cache built on one machine is valid on every other
+static void get_byte_code_cache_key(
+	Renderer* pRenderer, ShaderTarget target, ShaderStage stage, const eastl::string& code, const eastl::vector<uint64_t>& includeHashes,
+	uint32_t macroCount, const ShaderMacro* pMacros, const char* pEntryPoint, uint64_t pOutKey[2])
+{
+	// Every field is length prefixed so different inputs can't concatenate to the same string
+	eastl::string key;
+	key.reserve(code.size() + 256);
+	eastl::string const compilerVersion = get_shader_compiler_version(pRenderer, target);
+	key.append_sprintf("%zu:", compilerVersion.size()).append(compilerVersion);
+	key.append_sprintf("%u|%u|", (uint32_t)target, (uint32_t)stage);
+	const char* entryPoint = pEntryPoint ? pEntryPoint : "";
+	key.append_sprintf("%zu:%s", strlen(entryPoint), entryPoint);
+	for (uint32_t i = 0; i < macroCount; ++i)
+	{
+		key.append_sprintf("%zu:%s", strlen(pMacros[i].definition), pMacros[i].definition);
+		key.append_sprintf("%zu:%s", strlen(pMacros[i].value), pMacros[i].value);
+	}
+	key.append_sprintf("%zu:", code.size()).append(code);
+	// Included files, which the compilers read themselves
+	key.append_sprintf("%zu:", includeHashes.size());
+	key.append((const char*)includeHashes.data(), includeHashes.size() * sizeof(uint64_t));
+
+	hash128(key.data(), key.size(), pOutKey);
+}
 
-	// If source code is loaded from a package, its timestamp will be zero. Else check that binary is not older
-	// than source
-	if (sourceTimeStamp && fsGetLastModifiedTime(binaryShaderPath) < sourceTimeStamp)
+// Loose binary of a cache key in RD_SHADER_BINARIES
+static PathHandle get_byte_code_binary_path(const uint64_t key[2])
+{
+	eastl::string const binaryShaderComponent =
+		eastl::string().sprintf("%016llx%016llx.bin", (unsigned long long)key[0], (unsigned long long)key[1]);
+	return fsCopyPathInResourceDirectory(RD_SHADER_BINARIES, binaryShaderComponent.c_str());
+}
+
+// Loads the bytecode from file if it was cached under the binary shader path
+bool check_for_byte_code(const Path* binaryShaderPath, eastl::vector<char>& byteCode)
+{
+	if (!fsFileExists(binaryShaderPath))
 		return false;
 
     FileStream* fh = fsOpenFile(binaryShaderPath, FM_READ_BINARY);
@@ -1825,6 +3594,27 @@ bool check_for_byte_code(const Path* binaryShaderPath, time_t sourceTimeStamp, e
 	return true;
 }
 
+// Unique path next to a binary to write it to before it is moved into place. Batches compiling the same
+// variant at once each write their own file and readers only ever see a complete binary
+Path* copy_byte_code_temp_path(const Path* binaryShaderPath)
+{
+	static tfrg_atomic64_t tempCounter = 0;
+	char                   extension[48];
+	snprintf(
+		extension, sizeof(extension), "%llx-%llx.tmp", (unsigned long long)getUSec(),
+		(unsigned long long)tfrg_atomic64_add_relaxed(&tempCounter, 1));
+	return fsAppendPathExtension(binaryShaderPath, extension);
+}
+
+// Replaces binaryShaderPath with the finished binary at tempPath, the temporary file is gone either way
+bool move_byte_code(const Path* tempPath, const Path* binaryShaderPath)
+{
+	if (fsRenameFile(tempPath, binaryShaderPath))
+		return true;
+	fsDeleteFile(tempPath);
+	return false;
+}
+
 // Saves bytecode to a file
 bool save_byte_code(const Path* binaryShaderPath, const eastl::vector<char>& byteCode)
 {
@@ -1834,15 +3624,21 @@ bool save_byte_code(const Path* binaryShaderPath, const eastl::vector<char>& byt
         fsCreateDirectory(parentDirectory);
     }
     
-    FileStream* fh = fsOpenFile(binaryShaderPath, FM_WRITE_BINARY);
+	PathHandle  tempPath = copy_byte_code_temp_path(binaryShaderPath);
+	FileStream* fh = fsOpenFile(tempPath, FM_WRITE_BINARY);
     
 	if (!fh)
 		return false;
 
-    fsWriteToStream(fh, byteCode.data(), byteCode.size() * sizeof(char));
-    fsCloseStream(fh);
+	bool const written = fsWriteToStream(fh, byteCode.data(), byteCode.size() * sizeof(char)) == byteCode.size() * sizeof(char);
+	fsCloseStream(fh);
 
-	return true;
+	if (!written)
+	{
+		fsDeleteFile(tempPath);
+		return false;
+	}
+	return move_byte_code(tempPath, binaryShaderPath);
 }
 
 bool load_shader_stage_byte_code(
@@ -1851,13 +3647,14 @@ bool load_shader_stage_byte_code(
 	const char* pEntryPoint)
 {
 	eastl::string code;
+	eastl::vector<uint64_t> includeHashes;
 	time_t          timeStamp = 0;
 
 #ifndef METAL
 	FileStream* sourceFileStream = fsOpenFile(filePath, FM_READ_BINARY);
 	ASSERT(sourceFileStream);
 
-	if (!process_source_file(sourceFileStream, filePath, sourceFileStream, timeStamp, code))
+	if (!process_source_file(sourceFileStream, filePath, sourceFileStream, timeStamp, code, includeHashes))
 	{
         fsCloseStream(sourceFileStream);
 		return false;
@@ -1867,48 +3664,20 @@ bool load_shader_stage_byte_code(
 	FileStream* sourceFileStream = fsOpenFile(metalShaderPath, FM_READ_BINARY);
 	ASSERT(sourceFileStream);
 
-	if (!process_source_file(sourceFileStream, metalShaderPath, sourceFileStream, timeStamp, code))
+	if (!process_source_file(sourceFileStream, metalShaderPath, sourceFileStream, timeStamp, code, includeHashes))
 	{
         fsCloseStream(sourceFileStream);
 		return false;
     }
 #endif
 
-	PathComponent directoryPath, fileName, extension;
-    fsGetPathComponents(filePath, &directoryPath, &fileName, &extension);
-	eastl::string shaderDefines;
-	// Apply user specified macros
-	for (uint32_t i = 0; i < macroCount; ++i)
-	{
-		shaderDefines += (eastl::string(pMacros[i].definition) + pMacros[i].value);
-	}
-
-	eastl::string rendererApi;
-	switch (pRenderer->mSettings.mApi)
-	{
-		case RENDERER_API_D3D12:
-		case RENDERER_API_XBOX_D3D12: rendererApi = "D3D12"; break;
-		case RENDERER_API_D3D11: rendererApi = "D3D11"; break;
-		case RENDERER_API_VULKAN: rendererApi = "Vulkan"; break;
-		case RENDERER_API_METAL: rendererApi = "Metal"; break;
-		default: break;
-	}
-
-	eastl::string appName(pRenderer->pName);
-
-#ifdef __linux__
-	appName.make_lower();
-	appName = appName != pRenderer->pName ? appName : appName + "_";
-#endif
-
-    eastl::string binaryShaderComponent = fsPathComponentToString(fileName) +
-									 eastl::string().sprintf("_%zu", eastl::string_hash<eastl::string>()(shaderDefines)) + fsPathComponentToString(extension) +
-									 eastl::string().sprintf("%u", target) + ".bin";
-    
-    PathHandle binaryShaderPath = fsCopyPathInResourceDirectory(RD_SHADER_BINARIES, binaryShaderComponent.c_str());
+	PathComponent fileName = fsGetPathFileName(filePath);
+	uint64_t cacheKey[2];
+	get_byte_code_cache_key(pRenderer, target, stage, code, includeHashes, macroCount, pMacros, pEntryPoint, cacheKey);
+    PathHandle binaryShaderPath = get_byte_code_binary_path(cacheKey);
 
-	// Shader source is newer than binary
-	if (!check_for_byte_code(binaryShaderPath, timeStamp, byteCode))
+	// No binary compiled from these inputs yet, packed binaries are checked before loose ones
+	if (!readShaderPackByteCode(pResourceLoader, cacheKey, byteCode) && !check_for_byte_code(binaryShaderPath, byteCode))
 	{
         if (!sourceFileStream)
         {
@@ -1922,6 +3691,10 @@ bool load_shader_stage_byte_code(
 #if defined(VULKAN)
 #if defined(__ANDROID__)
 			vk_compileShader(pRenderer, stage, (uint32_t)code.size(), code.c_str(), binaryShaderPath, macroCount, pMacros, &byteCode, pEntryPoint);
+#elif defined(__linux__)
+			vk_compileShader(
+				pRenderer, target, stage, filePath, (uint32_t)code.size(), code.c_str(), binaryShaderPath, macroCount, pMacros, &byteCode,
+				pEntryPoint);
 #else
 			vk_compileShader(pRenderer, target, filePath, binaryShaderPath, macroCount, pMacros, &byteCode, pEntryPoint);
 #endif
@@ -2056,6 +3829,31 @@ bool find_shader_stage(
 	return true;
 }
 #endif
+
+#ifndef TARGET_IOS
+PathHandle get_shader_stage_path(const ShaderStageLoadDesc* pStageDesc)
+{
+	ResourceDirectory resourceDir = pStageDesc->mRoot;
+
+	PathHandle resourceDirBasePath = fsCopyPathForResourceDirectory(resourceDir);
+
+	if (resourceDir != RD_SHADER_SOURCES && resourceDir != RD_ROOT)
+		resourceDirBasePath = fsAppendPathComponent(resourceDirBasePath, fsGetDefaultRelativePathForResourceDirectory(RD_SHADER_SOURCES));
+
+	return fsAppendPathComponent(resourceDirBasePath, pStageDesc->pFileName);
+}
+
+// Renderer defines first, then the ones of the stage, in the order addShader passes them to the compiler
+static void get_shader_stage_macros(Renderer* pRenderer, const ShaderStageLoadDesc* pStageDesc, eastl::vector<ShaderMacro>& outMacros)
+{
+	outMacros.resize(pStageDesc->mMacroCount + pRenderer->mBuiltinShaderDefinesCount);
+	for (uint32_t macro = 0; macro < pRenderer->mBuiltinShaderDefinesCount; ++macro)
+		outMacros[macro] = pRenderer->pBuiltinShaderDefines[macro];
+	for (uint32_t macro = 0; macro < pStageDesc->mMacroCount; ++macro)
+		outMacros[pRenderer->mBuiltinShaderDefinesCount + macro] = pStageDesc->pMacros[macro];
+}
+#endif
+
 void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader)
 {
 	if (pDesc->mTarget > pRenderer->mSettings.mShaderTarget)
@@ -2077,29 +3875,17 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 	{
 		if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName) != 0)
 		{
-            ResourceDirectory resourceDir = pDesc->mStages[i].mRoot;
-			
-			PathHandle resourceDirBasePath = fsCopyPathForResourceDirectory(resourceDir);
-            
-            if (resourceDir != RD_SHADER_SOURCES && resourceDir != RD_ROOT) {
-				resourceDirBasePath = fsAppendPathComponent(resourceDirBasePath, fsGetDefaultRelativePathForResourceDirectory(RD_SHADER_SOURCES));
-            }
-			
-            PathHandle filePath = fsAppendPathComponent(resourceDirBasePath, pDesc->mStages[i].pFileName);
+			PathHandle filePath = get_shader_stage_path(&pDesc->mStages[i]);
 
 			ShaderStage            stage;
 			BinaryShaderStageDesc* pStage = NULL;
 			if (find_shader_stage(filePath, &binaryDesc, &pStage, &stage))
 			{
-				const uint32_t macroCount = pDesc->mStages[i].mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
-				eastl::vector<ShaderMacro> macros(macroCount);
-				for (uint32_t macro = 0; macro < pRenderer->mBuiltinShaderDefinesCount; ++macro)
-					macros[macro] = pRenderer->pBuiltinShaderDefines[macro];
-				for (uint32_t macro = 0; macro < pDesc->mStages[i].mMacroCount; ++macro)
-					macros[pRenderer->mBuiltinShaderDefinesCount + macro] = pDesc->mStages[i].pMacros[macro];
+				eastl::vector<ShaderMacro> macros;
+				get_shader_stage_macros(pRenderer, &pDesc->mStages[i], macros);
 
 				if (!load_shader_stage_byte_code(
-						pRenderer, pDesc->mTarget, stage, filePath, macroCount, macros.data(),
+						pRenderer, pDesc->mTarget, stage, filePath, (uint32_t)macros.size(), macros.data(),
 						byteCodes[i], pDesc->mStages[i].pEntryPointName))
 					return;
 
@@ -2170,7 +3956,8 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 
 				pStage->pName = pDesc->mStages[i].pFileName;
 				time_t timestamp = 0;
-                process_source_file(fh, metalFilePath, fh, timestamp, codes[i]);
+				eastl::vector<uint64_t> includeHashes;
+                process_source_file(fh, metalFilePath, fh, timestamp, codes[i], includeHashes);
                 pStage->pCode = codes[i].c_str();
                 if (pDesc->mStages[i].pEntryPointName)
                     pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
@@ -2197,6 +3984,275 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 #endif
 }
 
+#ifndef TARGET_IOS
+typedef struct ShaderStageJob
+{
+	PathHandle                   mFilePath;
+	ShaderTarget                 mTarget;
+	ShaderStage                  mStage;
+	// Macro strings are copied, the descs only have to live until addShaders returns
+	eastl::vector<eastl::string> mMacroStrings;
+	eastl::vector<ShaderMacro>   mMacros;
+	// Empty if the desc has none, it is passed on as NULL like addShader does so both find the same binary
+	eastl::string                mEntryPoint;
+	eastl::vector<char>          mByteCode;
+	bool                         mLoaded;
+} ShaderStageJob;
+
+typedef struct ShaderBatch
+{
+	Renderer*                       pRenderer;
+	Shader**                        ppShaders;
+	uint32_t                        mShaderCount;
+	SyncToken                       mToken;
+	eastl::vector<ShaderStageJob*>  mJobs;
+	// Job of each stage of each shader, UINT32_MAX for unused stages and shaders with an unsupported target
+	eastl::vector<uint32_t>         mStageJobs;
+	tfrg_atomic64_t                 mRemaining;
+	// False for bytecode only batches, their caller waits for the stages and frees the batch
+	bool                            mCreateShaders;
+} ShaderBatch;
+
+static void deleteShaderBatch(ShaderBatch* pBatch)
+{
+	for (ShaderStageJob* pJob : pBatch->mJobs)
+		conf_delete(pJob);
+	conf_delete(pBatch);
+}
+
+static void finishShaderBatch(ShaderBatch* pBatch)
+{
+	for (uint32_t s = 0; s < pBatch->mShaderCount; ++s)
+	{
+		BinaryShaderDesc binaryDesc = {};
+		bool             loaded = false;
+		for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+		{
+			uint32_t const jobIndex = pBatch->mStageJobs[s * SHADER_STAGE_COUNT + i];
+			if (jobIndex == UINT32_MAX)
+				continue;
+
+			ShaderStageJob* pJob = pBatch->mJobs[jobIndex];
+			loaded = pJob->mLoaded;
+			if (!loaded)
+				break;
+
+			ShaderStage            stage;
+			BinaryShaderStageDesc* pStage = NULL;
+			find_shader_stage(pJob->mFilePath, &binaryDesc, &pStage, &stage);
+			binaryDesc.mStages |= stage;
+			pStage->pByteCode = pJob->mByteCode.data();
+			pStage->mByteCodeSize = (uint32_t)pJob->mByteCode.size();
+			pStage->pEntryPoint = pJob->mEntryPoint.empty() ? "main" : pJob->mEntryPoint.c_str();
+		}
+
+		if (loaded)
+			addShaderBinary(pBatch->pRenderer, &binaryDesc, &pBatch->ppShaders[s]);
+	}
+
+	uint64_t const token = pBatch->mToken;
+	deleteShaderBatch(pBatch);
+	completeTokens(pResourceLoader, &token, 1);
+}
+
+static void loadShaderStageTask(void* pData, uintptr_t index)
+{
+	ShaderBatch*    pBatch = (ShaderBatch*)pData;
+	ShaderStageJob* pJob = pBatch->mJobs[index];
+
+	{
+		PROFILE_SCOPEI("ResourceLoader", "LoadShaderStage", 0xee33ee);
+		pJob->mLoaded = load_shader_stage_byte_code(
+			pBatch->pRenderer, pJob->mTarget, pJob->mStage, pJob->mFilePath, (uint32_t)pJob->mMacros.size(), pJob->mMacros.data(),
+			pJob->mByteCode, pJob->mEntryPoint.empty() ? NULL : pJob->mEntryPoint.c_str());
+	}
+
+	// The last stage creates the shaders
+	if (tfrg_atomic64_add_relaxed(&pBatch->mRemaining, -1) == 1 && pBatch->mCreateShaders)
+		finishShaderBatch(pBatch);
+}
+
+static ShaderBatch* addShaderBatch(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs)
+{
+	ShaderBatch* pBatch = conf_new(ShaderBatch);
+	pBatch->pRenderer = pRenderer;
+	pBatch->ppShaders = NULL;
+	pBatch->mShaderCount = shaderCount;
+	pBatch->mToken = 0;
+	pBatch->mCreateShaders = false;
+	pBatch->mStageJobs.resize(shaderCount * SHADER_STAGE_COUNT, UINT32_MAX);
+
+	// Stages that resolve to the same bytecode are loaded once, concurrent compiles would write the same binary file
+	eastl::unordered_map<eastl::string, uint32_t> stageJobs;
+	for (uint32_t s = 0; s < shaderCount; ++s)
+	{
+		const ShaderLoadDesc* pDesc = &pDescs[s];
+		if (pDesc->mTarget > pRenderer->mSettings.mShaderTarget)
+		{
+			LOGF(LogLevel::eERROR, "Requested shader target (%u) is higher than the shader target that the renderer supports (%u). Shader wont be compiled",
+				(uint32_t)pDesc->mTarget, (uint32_t)pRenderer->mSettings.mShaderTarget);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+		{
+			const ShaderStageLoadDesc* pStageDesc = &pDesc->mStages[i];
+			if (!pStageDesc->pFileName || strlen(pStageDesc->pFileName) == 0)
+				continue;
+
+			PathHandle             filePath = get_shader_stage_path(pStageDesc);
+			BinaryShaderDesc       binaryDesc = {};
+			BinaryShaderStageDesc* pStage = NULL;
+			ShaderStage            stage;
+			if (!find_shader_stage(filePath, &binaryDesc, &pStage, &stage))
+				continue;
+
+			const char* pEntryPoint = pStageDesc->pEntryPointName ? pStageDesc->pEntryPointName : "";
+			eastl::string key = eastl::string().sprintf("%s|%u|%s", fsGetPathAsNativeString(filePath), (uint32_t)pDesc->mTarget, pEntryPoint);
+			for (uint32_t macro = 0; macro < pStageDesc->mMacroCount; ++macro)
+				key.append_sprintf("|%s=%s", pStageDesc->pMacros[macro].definition, pStageDesc->pMacros[macro].value);
+
+			eastl::unordered_map<eastl::string, uint32_t>::iterator it = stageJobs.find(key);
+			if (it != stageJobs.end())
+			{
+				pBatch->mStageJobs[s * SHADER_STAGE_COUNT + i] = it->second;
+				continue;
+			}
+
+			ShaderStageJob* pJob = conf_new(ShaderStageJob);
+			pJob->mFilePath = filePath;
+			pJob->mTarget = pDesc->mTarget;
+			pJob->mStage = stage;
+			pJob->mEntryPoint = pEntryPoint;
+			pJob->mLoaded = false;
+			const uint32_t macroCount = pStageDesc->mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
+			pJob->mMacroStrings.reserve(macroCount * 2);
+			pJob->mMacros.resize(macroCount);
+			for (uint32_t macro = 0; macro < macroCount; ++macro)
+			{
+				const ShaderMacro& src = macro < pRenderer->mBuiltinShaderDefinesCount
+											 ? pRenderer->pBuiltinShaderDefines[macro]
+											 : pStageDesc->pMacros[macro - pRenderer->mBuiltinShaderDefinesCount];
+				pJob->mMacroStrings.push_back(src.definition);
+				pJob->mMacroStrings.push_back(src.value);
+			}
+			// Pointers are taken once the strings stopped moving
+			for (uint32_t macro = 0; macro < macroCount; ++macro)
+			{
+				pJob->mMacros[macro].definition = pJob->mMacroStrings[macro * 2].c_str();
+				pJob->mMacros[macro].value = pJob->mMacroStrings[macro * 2 + 1].c_str();
+			}
+
+			uint32_t const jobIndex = (uint32_t)pBatch->mJobs.size();
+			pBatch->mJobs.push_back(pJob);
+			pBatch->mStageJobs[s * SHADER_STAGE_COUNT + i] = jobIndex;
+			stageJobs[key] = jobIndex;
+		}
+	}
+
+	return pBatch;
+}
+#endif
+
+void addShaders(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs, Shader** ppShaders, SyncToken* token)
+{
+	SyncToken const t = reserveToken(pResourceLoader);
+	if (token) *token = t;
+
+	for (uint32_t s = 0; s < shaderCount; ++s)
+		ppShaders[s] = NULL;
+
+#if defined(TARGET_IOS) || defined(METAL)
+	// Metal shaders are compiled from source when the shader gets created, load them in order
+	for (uint32_t s = 0; s < shaderCount; ++s)
+		addShader(pRenderer, &pDescs[s], &ppShaders[s]);
+
+	uint64_t const token64 = t;
+	completeTokens(pResourceLoader, &token64, 1);
+#else
+	ShaderBatch* pBatch = addShaderBatch(pRenderer, shaderCount, pDescs);
+	pBatch->ppShaders = ppShaders;
+	pBatch->mToken = t;
+	pBatch->mCreateShaders = true;
+
+	if (pBatch->mJobs.empty())
+	{
+		finishShaderBatch(pBatch);
+		return;
+	}
+
+	tfrg_atomic64_store_relaxed(&pBatch->mRemaining, pBatch->mJobs.size());
+	addThreadSystemRangeTask(pResourceLoader->pThreadSystem, loadShaderStageTask, pBatch, pBatch->mJobs.size());
+#endif
+}
+
+bool compileShaderBinaries(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs)
+{
+#if defined(TARGET_IOS)
+	LOGF(LogLevel::eERROR, "Shader binaries are not supported on iOS");
+	return false;
+#else
+	ShaderBatch* pBatch = addShaderBatch(pRenderer, shaderCount, pDescs);
+
+	// Without a resource loader, e.g. in offline tools, the stages go to a thread system of their own
+	ThreadSystem* pThreadSystem = pResourceLoader ? pResourceLoader->pThreadSystem : NULL;
+	if (!pThreadSystem)
+		initThreadSystem(&pThreadSystem);
+
+	tfrg_atomic64_store_relaxed(&pBatch->mRemaining, pBatch->mJobs.size());
+	if (!pBatch->mJobs.empty())
+		addThreadSystemRangeTask(pThreadSystem, loadShaderStageTask, pBatch, pBatch->mJobs.size());
+	waitThreadSystemIdle(pThreadSystem);
+
+	if (!pResourceLoader)
+		shutdownThreadSystem(pThreadSystem);
+
+	bool loaded = true;
+	for (ShaderStageJob* pJob : pBatch->mJobs)
+		loaded = loaded && pJob->mLoaded;
+	deleteShaderBatch(pBatch);
+	return loaded;
+#endif
+}
+
+bool isShaderStageCompiled(Renderer* pRenderer, const ShaderLoadDesc* pDesc, uint32_t stageIndex)
+{
+#if defined(TARGET_IOS) || defined(METAL)
+	return false;
+#else
+	const ShaderStageLoadDesc* pStageDesc = &pDesc->mStages[stageIndex];
+	PathHandle                 filePath = get_shader_stage_path(pStageDesc);
+	BinaryShaderDesc           binaryDesc = {};
+	BinaryShaderStageDesc*     pStage = NULL;
+	ShaderStage                stage;
+	if (!find_shader_stage(filePath, &binaryDesc, &pStage, &stage))
+		return false;
+
+	FileStream* fh = fsOpenFile(filePath, FM_READ_BINARY);
+	if (!fh)
+		return false;
+	eastl::string           code;
+	eastl::vector<uint64_t> includeHashes;
+	time_t                  timeStamp = 0;
+	bool const              processed = process_source_file(fh, filePath, fh, timeStamp, code, includeHashes);
+	fsCloseStream(fh);
+	if (!processed)
+		return false;
+
+	// Same inputs as the addShader load of the stage
+	eastl::vector<ShaderMacro> macros;
+	get_shader_stage_macros(pRenderer, pStageDesc, macros);
+	uint64_t cacheKey[2];
+	get_byte_code_cache_key(
+		pRenderer, pDesc->mTarget, stage, code, includeHashes, (uint32_t)macros.size(), macros.data(), pStageDesc->pEntryPointName,
+		cacheKey);
+
+	eastl::vector<char> byteCode;
+	PathHandle          binaryShaderPath = get_byte_code_binary_path(cacheKey);
+	return readShaderPackByteCode(pResourceLoader, cacheKey, byteCode) || fsFileExists(binaryShaderPath);
+#endif
+}
+
 #if !defined(METAL) && !defined(DIRECT3D11)
 void updateVirtualTexture(Renderer* pRenderer, Queue* pQueue, TextureUpdateDesc* pTextureUpdate)
 {
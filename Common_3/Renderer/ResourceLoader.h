@@ -41,6 +41,8 @@ typedef struct BufferLoadDesc
 	BufferDesc  mDesc;
 	/// Force Reset buffer to NULL
 	bool mForceReset;
+	/// Pending requests with a higher priority are copied first
+	int32_t mPriority;
 } BufferLoadDesc;
 
 typedef struct RawImageData
@@ -58,6 +60,11 @@ typedef struct BinaryImageData
 	const char* pExtension;
 } BinaryImageData;
 
+/// Textures loaded from a file or binary image data are created from the header on the calling thread, then read
+/// and decoded on worker threads. *ppTexture is valid on return, its contents only once the SyncToken completes.
+/// pBinaryImageData->pBinaryData has to stay valid until then. Formats without a header probe are decoded before
+/// returning, a load that fails there leaves *ppTexture NULL. One that fails on a worker, or decodes to a different
+/// layout than its header, leaves the contents undefined and isTokenFailed reports its token.
 typedef struct TextureLoadDesc
 {
 	Texture** ppTexture;
@@ -76,6 +83,16 @@ typedef struct TextureLoadDesc
 	// Following is ignored if pDesc != NULL.  pDesc->mFlags will be considered instead.
 	TextureCreationFlags mCreationFlag; 
 
+	/// Pending requests with a higher priority are copied first
+	int32_t mPriority = 0;
+	/// File and binary image data loads. Shared loads of the same file, or of binary data with the same contents and
+	/// extension, with the same creation flags, node and mProgressive return one texture and token. Each load takes a reference
+	/// that removeResource releases
+	bool mShared = false;
+	/// Uploads the small mips first under the returned token, then streams the larger ones with lower priorities.
+	/// Sample no more detailed mip than getTextureResidentMip reports until the texture is fully resident.
+	/// Ignored on Xbox, where the copy barriers can't be limited to the streamed mips
+	bool mProgressive = false;
 } TextureLoadDesc;
 
 typedef struct VirtualTexturePageInfo
@@ -93,8 +110,12 @@ typedef struct BufferUpdateDesc
 		pData(data),
 		mSrcOffset(srcOff),
 		mDstOffset(dstOff),
-		mSize(size)
+		mSize(size),
+		mPriority(0),
+		pMappedData(NULL)
 	{
+		mInternal.pSrcBuffer = NULL;
+		mInternal.mUnmap = false;
 	}
 
 	Buffer*     pBuffer;
@@ -102,12 +123,22 @@ typedef struct BufferUpdateDesc
 	uint64_t    mSrcOffset;
 	uint64_t    mDstOffset;
 	uint64_t    mSize;    // If 0, uses size of pBuffer
+	int32_t     mPriority;    // Pending requests with a higher priority are copied first
+	/// Written by beginUpdateResource, valid until endUpdateResource
+	void*       pMappedData;
+	struct
+	{
+		Buffer* pSrcBuffer;
+		bool    mUnmap;
+	} mInternal;
 } BufferUpdateDesc;
 
 typedef struct TextureUpdateDesc
 {
 	Texture* pTexture;
 	RawImageData* pRawImageData = NULL;
+	/// Pending requests with a higher priority are copied first
+	int32_t mPriority = 0;
 } TextureUpdateDesc;
 
 typedef enum ResourceType
@@ -146,13 +177,60 @@ typedef struct ShaderLoadDesc
 
 typedef tfrg_atomic64_t SyncToken;
 
+typedef enum ResourceCallbackMode
+{
+	/// Runs on the loader thread that completes the token. Must be short and must not wait on tokens
+	RESOURCE_CALLBACK_MODE_IMMEDIATE = 0,
+	/// Queued until processResourceCallbacks, usually called once per frame on the main thread
+	RESOURCE_CALLBACK_MODE_DEFERRED,
+} ResourceCallbackMode;
+
+typedef void (*ResourceLoadedCallback)(void* pUserData, SyncToken token);
+
 typedef struct ResourceLoaderDesc
 {
 	uint64_t mBufferSize;
 	uint32_t mBufferCount;
 	uint32_t mTimesliceMs;
+	/// Staging buffers double in size up to this while uploads stall waiting for staging space. 0 keeps mBufferSize
+	uint64_t mMaxBufferSize;
 } ResourceLoaderDesc;
 
+typedef struct ResourceLoaderNodeStats
+{
+	uint64_t mUploadedBytes;
+	uint64_t mRequestCount;
+	/// Streamer time spent recording copies, decoding excluded
+	uint64_t mRecordTimeUs;
+	/// Streamer time spent waiting on copy queue fences to recycle staging buffers
+	uint64_t mFenceWaitTimeUs;
+} ResourceLoaderNodeStats;
+
+/// Totals since initResourceLoaderInterface, divide times by mElapsedTimeUs for utilization
+typedef struct ResourceLoaderStats
+{
+	uint64_t mElapsedTimeUs;
+	uint64_t mUploadedBytes;
+	/// Upload rate over the last full second
+	uint64_t mBytesPerSecond;
+	/// Requests waiting for the streamer and age of the oldest one
+	uint32_t mQueueDepth;
+	uint64_t mOldestRequestAgeUs;
+	/// Texture loads still reading or decoding on worker threads
+	uint32_t mPreparingTextureCount;
+	/// Uploads larger than a staging buffer are split per subresource and row band and spread over several buffers.
+	/// A stall is a wait on the GPU to release a staging buffer while an upload was waiting for space
+	uint64_t mStagingStallCount;
+	uint64_t mStagingStallTimeUs;
+	uint64_t mStagingGrowCount;
+	/// Current size of each staging buffer
+	uint64_t mStagingBufferSize;
+	/// Worker time spent reading, decoding and transcoding texture files, summed over threads
+	uint64_t mDecodeTimeUs;
+	uint64_t mDecodeCount;
+	ResourceLoaderNodeStats mNodes[MAX_GPUS];
+} ResourceLoaderStats;
+
 
 void initResourceLoaderInterface(Renderer* pRenderer, ResourceLoaderDesc* pDesc = nullptr);
 void removeResourceLoaderInterface(Renderer* pRenderer);
@@ -169,20 +247,67 @@ void updateResource(BufferUpdateDesc* pBuffer, SyncToken* token);
 void updateResource(TextureUpdateDesc* pTexture, SyncToken* token);
 void updateResources(uint32_t resourceCount, ResourceUpdateDesc* pResources, SyncToken* token);
 
+/// Hands out pMappedData to write mSize bytes at mDstOffset in place, pData is ignored. CPU visible buffers are mapped
+/// directly, GPU only buffers get a pooled staging buffer that endUpdateResource queues for copying. Updates larger
+/// than the staging buffers of the resource loader get a staging buffer of their own.
+/// Mapped CPU buffers are written while the GPU may read them, synchronizing with frames in flight is up to the caller
+void beginUpdateResource(BufferUpdateDesc* pBufferUpdate);
+void endUpdateResource(BufferUpdateDesc* pBufferUpdate, SyncToken* token);
+
 #if !defined(METAL) && !defined(DIRECT3D11)
 void updateVirtualTexture(Renderer* pRenderer, Queue* pQueue, TextureUpdateDesc* pTextureUpdate);
 #endif
 
+/// Also reported to MicroProfile as the ResourceLoader group and counters
+void getResourceLoaderStats(ResourceLoaderStats* pOutStats);
+
+/// Drops a load or update that hasn't started copying and completes its token. Requests of the same resource
+/// are ordered by priority, so updates that depend on each other should share one. Resources created by the request
+/// stay valid with undefined contents and still have to be removed, removeResource waits for a texture that is still
+/// being decoded. Returns false if the request already started copying or completed
+bool cancelResourceRequest(SyncToken token);
+
+/// Calls pCallback once the request of token completed, failed or got cancelled. Tokens that already completed
+/// call immediate callbacks right away on the caller's thread
+void addResourceCallback(SyncToken token, ResourceCallbackMode mode, ResourceLoadedCallback pCallback, void* pUserData);
+/// Runs the deferred callbacks whose tokens completed since the last call
+void processResourceCallbacks();
+/// Returns a token that completes as soon as all tokens in pTokens completed. Its callbacks fire right then,
+/// isTokenCompleted still reports it only once every earlier token completed as well
+SyncToken addTokenGroup(const SyncToken* pTokens, uint32_t tokenCount);
+
 bool isBatchCompleted();
 void waitBatchCompleted();
 bool isTokenCompleted(SyncToken token);
 void waitTokenCompleted(SyncToken token);
+/// True once the request of a completed token failed, e.g. a texture file that couldn't be read or decoded.
+/// Cancelled requests don't count as failed
+bool isTokenFailed(SyncToken token);
 
 void removeResource(Buffer* pBuffer);
 void removeResource(Texture* pTexture);
 
-/// Either loads the cached shader bytecode or compiles the shader to create new bytecode depending on whether source is newer than binary
+/// Most detailed mip from which on every mip is resident, mMipLevels while nothing is.
+/// Always 0 for textures that weren't loaded progressively
+uint32_t getTextureResidentMip(Texture* pTexture);
+
+/// Reads only the header of a texture file and fills the size, mip, array and format fields of pOutDesc
+/// Returns false if the file is missing or its format has no header probe
+bool probeTexture(const Path* pFilePath, TextureDesc* pOutDesc);
+
+/// Either loads the cached shader bytecode or compiles the shader to create new bytecode. Binaries are cached under a hash of
+/// the source and its includes, macros, entry point, stage, target and compiler version
 void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader);
+/// Loads or compiles the stages of all shaders in parallel on the loader's worker threads, identical stages only once.
+/// ppShaders is written when the token completes and has to stay valid until then, shaders that fail to load stay NULL
+void addShaders(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs, Shader** ppShaders, SyncToken* token);
+/// Fills the shader binary cache like addShader without creating shaders and waits for it, for offline precompilation.
+/// Needs no device or resource loader, pRenderer only has to provide mSettings and the builtin shader defines.
+/// Returns false if any stage failed to compile
+bool compileShaderBinaries(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs);
+/// True if addShader would find a binary for stage stageIndex of pDesc instead of compiling it.
+/// Lets offline tools check that the binaries they wrote are the ones the runtime looks up
+bool isShaderStageCompiled(Renderer* pRenderer, const ShaderLoadDesc* pDesc, uint32_t stageIndex);
 
 void flushResourceUpdates();
 void finishResourceLoading();
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// A shader pack holds the cached binaries of many shader variants in one file, so a warm start opens a single
+// file instead of one per variant. Layout:
+//   ShaderPackHeader
+//   ShaderPackEntry[mEntryCount], sorted by key
+//   bytecode of every entry, each starting at a SHADER_PACK_ALIGNMENT aligned offset
+// Keys are the 128 bit hashes the loose <key>.bin files in RD_SHADER_BINARIES are named after, the high half first.
+// addShader looks variants up in RD_SHADER_BINARIES/SHADER_PACK_FILE_NAME before falling back to loose files.
+// AssetPipelineCmd -ps builds a pack from a directory of loose binaries
+
+#define SHADER_PACK_FILE_NAME "ShaderBinaries.pack"
+#define SHADER_PACK_MAGIC 0x4b505346u    // "FSPK"
+#define SHADER_PACK_VERSION 1u
+#define SHADER_PACK_ALIGNMENT 16u
+
+typedef struct ShaderPackHeader
+{
+	uint32_t mMagic;
+	uint32_t mVersion;
+	uint32_t mEntryCount;
+	uint32_t mReserved;
+} ShaderPackHeader;
+
+typedef struct ShaderPackEntry
+{
+	uint64_t mKey[2];
+	// From the start of the file
+	uint64_t mOffset;
+	uint64_t mSize;
+} ShaderPackEntry;
+
+inline bool shaderPackKeyLess(const uint64_t a[2], const uint64_t b[2])
+{
+	return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+}
@@ -2345,6 +2345,27 @@ uint64_t get_vk_device_memory_offset(Renderer* pRenderer, Buffer* pBuffer)
 	vmaGetAllocationInfo(pRenderer->pVmaAllocator, pBuffer->pVkAllocation, &allocInfo);
 	return (uint64_t)allocInfo.offset;
 }
+// The device features are arguments so offline shader compilers can reproduce the defines of a device
+void vk_setBuiltinShaderDefines(Renderer* pRenderer, bool descriptorIndexing, bool textureArrayDynamicIndexing)
+{
+	static char descriptorIndexingMacroBuffer[2] = {};
+	static char textureArrayDynamicIndexingMacroBuffer[2] = {};
+	sprintf(descriptorIndexingMacroBuffer, "%u", (uint32_t)(descriptorIndexing));
+	sprintf(textureArrayDynamicIndexingMacroBuffer, "%u", (uint32_t)(textureArrayDynamicIndexing));
+	static ShaderMacro rendererShaderDefines[] =
+	{
+		{ "VK_EXT_DESCRIPTOR_INDEXING_ENABLED", descriptorIndexingMacroBuffer },
+		{ "VK_FEATURE_TEXTURE_ARRAY_DYNAMIC_INDEXING_ENABLED", textureArrayDynamicIndexingMacroBuffer },
+		// Descriptor set indices
+		{ "UPDATE_FREQ_NONE",      "set = 0" },
+		{ "UPDATE_FREQ_PER_FRAME", "set = 1" },
+		{ "UPDATE_FREQ_PER_BATCH", "set = 2" },
+		{ "UPDATE_FREQ_PER_DRAW",  "set = 3" },
+	};
+	pRenderer->mBuiltinShaderDefinesCount = sizeof(rendererShaderDefines) / sizeof(rendererShaderDefines[0]);
+	pRenderer->pBuiltinShaderDefines = rendererShaderDefines;
+}
+
 /************************************************************************/
 // Renderer Init Remove
 /************************************************************************/
@@ -2489,22 +2510,8 @@ void initRenderer(const char* app_name, const RendererDesc* settings, Renderer**
 	gFrameBufferMap = conf_placement_new<eastl::hash_map<ThreadID, FrameBufferMap> >(conf_malloc(sizeof(*gFrameBufferMap)));
 
 	// Set shader macro based on runtime information
-	static char descriptorIndexingMacroBuffer[2] = {};
-	static char textureArrayDynamicIndexingMacroBuffer[2] = {};
-	sprintf(descriptorIndexingMacroBuffer, "%u", (uint32_t)(gDescriptorIndexingExtension));
-	sprintf(textureArrayDynamicIndexingMacroBuffer, "%u", (uint32_t)(pRenderer->pVkActiveGpuFeatures->features.shaderSampledImageArrayDynamicIndexing));
-	static ShaderMacro rendererShaderDefines[] =
-	{
-		{ "VK_EXT_DESCRIPTOR_INDEXING_ENABLED", descriptorIndexingMacroBuffer },
-		{ "VK_FEATURE_TEXTURE_ARRAY_DYNAMIC_INDEXING_ENABLED", textureArrayDynamicIndexingMacroBuffer },
-		// Descriptor set indices
-		{ "UPDATE_FREQ_NONE",      "set = 0" },
-		{ "UPDATE_FREQ_PER_FRAME", "set = 1" },
-		{ "UPDATE_FREQ_PER_BATCH", "set = 2" },
-		{ "UPDATE_FREQ_PER_DRAW",  "set = 3" },
-	};
-	pRenderer->mBuiltinShaderDefinesCount = sizeof(rendererShaderDefines) / sizeof(rendererShaderDefines[0]);
-	pRenderer->pBuiltinShaderDefines = rendererShaderDefines;
+	vk_setBuiltinShaderDefines(
+		pRenderer, gDescriptorIndexingExtension, pRenderer->pVkActiveGpuFeatures->features.shaderSampledImageArrayDynamicIndexing != VK_FALSE);
 
 	// Renderer is good! Assign it to result!
 	*(ppRenderer) = pRenderer;
@@ -3735,8 +3742,8 @@ void removeTexture(Renderer* pRenderer, Texture* pTexture)
 	if (pTexture->mRemovePageCount)
 		removeBuffer(pRenderer, pTexture->mRemovePageCount);
 
-	if(pTexture->mVirtualImageData)
-		conf_free(pTexture->mVirtualImageData);
+	if (pTexture->mVirtualPageSource.pfnRelease)
+		pTexture->mVirtualPageSource.pfnRelease(pTexture->mVirtualPageSource.pUserData);
 
 	SAFE_FREE((wchar_t*)pTexture->mDesc.pDebugName);
 	SAFE_FREE(pTexture->pVkSRVStencilDescriptor);
@@ -5900,7 +5907,31 @@ void cmdResourceBarrier(Cmd* pCmd, uint32_t numBufferBarriers, BufferBarrier* pB
 		TextureBarrier* pTrans = &pTextureBarriers[i];
 		Texture*        pTexture = pTrans->pTexture;
 
-		if (!(pTrans->mNewState & pTexture->mCurrentState))
+		if (pTrans->mMipLevelCount)
+		{
+			VkImageMemoryBarrier* pImageBarrier = &imageBarriers[imageBarrierCount++];
+			pImageBarrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			pImageBarrier->pNext = NULL;
+
+			pImageBarrier->image = pTexture->pVkImage;
+			pImageBarrier->subresourceRange.aspectMask = pTexture->mVkAspectMask;
+			pImageBarrier->subresourceRange.baseMipLevel = pTrans->mMipLevel;
+			pImageBarrier->subresourceRange.levelCount = pTrans->mMipLevelCount;
+			pImageBarrier->subresourceRange.baseArrayLayer = 0;
+			pImageBarrier->subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+			pImageBarrier->srcAccessMask = util_to_vk_access_flags(pTrans->mMipState);
+			pImageBarrier->dstAccessMask = util_to_vk_access_flags(pTrans->mNewState);
+			pImageBarrier->oldLayout = util_to_vk_image_layout(pTrans->mMipState);
+			pImageBarrier->newLayout = util_to_vk_image_layout(pTrans->mNewState);
+
+			pImageBarrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			pImageBarrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+			srcAccessFlags |= pImageBarrier->srcAccessMask;
+			dstAccessFlags |= pImageBarrier->dstAccessMask;
+		}
+		else if (!(pTrans->mNewState & pTexture->mCurrentState))
 		{
 			VkImageMemoryBarrier* pImageBarrier = &imageBarriers[imageBarrierCount++];
 			pImageBarrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -6677,9 +6708,10 @@ void fillVirtualTexture(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture, Fence
 
 		if(allocateVirtualPage(pRenderer, pTexture, *pPage, pTexture->mSparseMemoryTypeIndex))
 		{
-			void* pData = (void*)((unsigned char*)pTexture->mVirtualImageData + (pageIndex * pPage->size));
-
-			memcpy(pPage->pIntermediateBuffer->pCpuMappedAddress, pData, pPage->size);
+			// Page pixels are read straight into the staging buffer
+			const VirtualTexturePageSource* pSource = &pTexture->mVirtualPageSource;
+			if (!pSource->pfnReadPage(pSource->pUserData, pageIndex, pPage->pIntermediateBuffer->pCpuMappedAddress, pPage->size))
+				LOGF(LogLevel::eWARNING, "Failed to read virtual texture page %u", pageIndex);
 
 			//Copy image to VkImage	
 			VkBufferImageCopy region = {};
@@ -6754,10 +6786,10 @@ void fillVirtualTextureLevel(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture,
 		{
 			if (allocateVirtualPage(pRenderer, pTexture, *pPage, pTexture->mSparseMemoryTypeIndex))
 			{
-				void* pData = (void*)((unsigned char*)pTexture->mVirtualImageData + (pageIndex * (uint32_t)pPage->size));
-
 				//CPU to GPU
-				memcpy(pPage->pIntermediateBuffer->pCpuMappedAddress, pData, pPage->size);
+				const VirtualTexturePageSource* pSource = &pTexture->mVirtualPageSource;
+				if (!pSource->pfnReadPage(pSource->pUserData, pageIndex, pPage->pIntermediateBuffer->pCpuMappedAddress, pPage->size))
+					LOGF(LogLevel::eWARNING, "Failed to read virtual texture page %u", pageIndex);
 
 				//Copy image to VkImage	
 				VkBufferImageCopy region = {};
@@ -6811,22 +6843,14 @@ void fillVirtualTextureLevel(Cmd* pCmd, Renderer* pRenderer, Texture* pTexture,
 	}
 }
 
-void addVirtualTexture(Renderer * pRenderer, const TextureDesc * pDesc, Texture ** ppTexture, void* pImageData)
+void addVirtualTexture(Renderer * pRenderer, const TextureDesc * pDesc, Texture ** ppTexture, const VirtualTexturePageSource* pPageSource)
 {
 	ASSERT(pRenderer);
 	Texture* pTexture = (Texture*)conf_calloc(1, sizeof(*pTexture));
 	ASSERT(pTexture);
 
-	uint32_t imageSize = 0;
-	uint32_t mipSize = pDesc->mWidth * pDesc->mHeight * pDesc->mDepth;
-	while (mipSize > 0)
-	{
-		imageSize += mipSize;
-		mipSize /= 4;
-	}
-
-	pTexture->mVirtualImageData = (char*)conf_malloc(imageSize * sizeof(uint32_t));
-	memcpy(pTexture->mVirtualImageData, pImageData, imageSize * sizeof(uint32_t));
+	ASSERT(pPageSource && pPageSource->pfnReadPage);
+	pTexture->mVirtualPageSource = *pPageSource;
 
 	// Create command buffer to transition resources to the correct state
 	Queue*   graphicsQueue = NULL;
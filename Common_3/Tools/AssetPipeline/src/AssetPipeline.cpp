@@ -29,6 +29,7 @@
 #include "../../../ThirdParty/OpenSource/EASTL/string.h"
 #include "../../../ThirdParty/OpenSource/EASTL/vector.h"
 #include "../../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../../../ThirdParty/OpenSource/EASTL/sort.h"
 
 // Assimp
 #include "../../../ThirdParty/OpenSource/assimp/4.1.0/include/assimp/Importer.hpp"
@@ -50,9 +51,11 @@
 
 #define IMAGE_CLASS_ALLOWED
 #include "../../../OS/Image/Image.h"
+#include "../../../OS/Core/ThreadSystem.h"
 #include "../../../OS/Interfaces/IOperatingSystem.h"
 #include "../../../OS/Interfaces/IFileSystem.h"
 #include "../../../OS/Interfaces/ILog.h"
+#include "../../../Renderer/ShaderPack.h"
 #include "../../../OS/Interfaces/IMemory.h"    //NOTE: this should be the last include in a .cpp
 
 typedef eastl::unordered_map<eastl::string, eastl::vector<PathHandle>> AnimationAssetMap;
@@ -732,6 +735,11 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 	eastl::vector<PathHandle> ddsFilesInDirectory;
 	ddsFilesInDirectory = fsGetFilesWithExtension(textureDirectory, ".dds");
 
+	// Page tiling and mip generation of each texture are spread over the worker threads
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem);
+	Image::Init();
+
 	for (size_t i = 0; i < ddsFilesInDirectory.size(); ++i)
 	{
 		eastl::string outputFile = fsGetPathAsNativeString(ddsFilesInDirectory[i]);
@@ -741,7 +749,6 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 		{
 
 			Image* pImage = conf_new(Image);
-			pImage->Init();
 
 			if (!pImage->LoadFromFile(ddsFilesInDirectory[i], NULL, NULL))
 			{
@@ -756,7 +763,7 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 
 			PathHandle pathForSVT = fsCreatePath(fsGetSystemFileSystem(), outputFile.c_str());
 
-			bool result = pImage->iSaveSVT(pathForSVT);
+			bool result = pImage->iSaveSVT(pathForSVT, 128, pThreadSystem);
 
 			pImage->Destroy();
 			conf_delete(pImage);
@@ -764,6 +771,8 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 			if (result == false)
 			{
 				LOGF(LogLevel::eERROR, "Failed to save sparse virtual texture %s.", outputFile.c_str());
+				Image::Exit();
+				shutdownThreadSystem(pThreadSystem);
 				return false;
 			}			
 		}
@@ -783,7 +792,6 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 		{
 
 			Image* pImage = conf_new(Image);
-			pImage->Init();
 
 			if (!pImage->LoadFromFile(ktxFilesInDirectory[i], NULL, NULL))
 			{
@@ -798,7 +806,7 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 
 			PathHandle pathForSVT = fsCreatePath(fsGetSystemFileSystem(), outputFile.c_str());
 
-			bool result = pImage->iSaveSVT(pathForSVT);
+			bool result = pImage->iSaveSVT(pathForSVT, 128, pThreadSystem);
 
 			pImage->Destroy();
 			conf_delete(pImage);
@@ -806,12 +814,143 @@ bool AssetPipeline::ProcessVirtualTextures(const Path* textureDirectory, const P
 			if (result == false)
 			{
 				LOGF(LogLevel::eERROR, "Failed to save sparse virtual texture %s.", outputFile.c_str());
+				Image::Exit();
+				shutdownThreadSystem(pThreadSystem);
 				return false;
 			}
 		}
 	}
 
+	Image::Exit();
+	shutdownThreadSystem(pThreadSystem);
 	ktxFilesInDirectory.set_capacity(0);
 #endif
 	return true;
 }
+
+static bool ParseShaderBinaryKey(const PathComponent& fileName, uint64_t key[2])
+{
+	// Loose binaries are named after their 128 bit key in hex, the high half first
+	if (fileName.length != 32)
+		return false;
+
+	key[0] = key[1] = 0;
+	for (size_t i = 0; i < 32; ++i)
+	{
+		char const c = fileName.buffer[i];
+		uint64_t   digit;
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else
+			return false;
+		key[i / 16] = (key[i / 16] << 4) | digit;
+	}
+	return true;
+}
+
+bool AssetPipeline::PackShaderBinaries(const Path* binaryDirectory, const Path* outputDirectory, ProcessAssetsSettings* settings)
+{
+	// Check if directory exists
+	if (!fsFileExists(binaryDirectory))
+	{
+		LOGF(LogLevel::eERROR, "binaryDirectory: \"%s\" does not exist.", fsGetPathAsNativeString(binaryDirectory));
+		return false;
+	}
+
+	// If output directory doesn't exist, create it.
+	if (!fsFileExists(outputDirectory))
+	{
+		if (!fsCreateDirectory(outputDirectory))
+		{
+			LOGF(LogLevel::eERROR, "Failed to create output directory %s.", fsGetPathAsNativeString(outputDirectory));
+			return false;
+		}
+	}
+
+	struct PackedBinary
+	{
+		ShaderPackEntry mEntry;
+		PathHandle      mFilePath;
+	};
+
+	eastl::vector<PathHandle>   binaryFiles = fsGetFilesWithExtension(binaryDirectory, ".bin");
+	eastl::vector<PackedBinary> binaries;
+	binaries.reserve(binaryFiles.size());
+	for (size_t i = 0; i < binaryFiles.size(); ++i)
+	{
+		PackedBinary binary = {};
+		if (!ParseShaderBinaryKey(fsGetPathFileName(binaryFiles[i]), binary.mEntry.mKey))
+		{
+			if (!settings->quiet)
+				LOGF(LogLevel::eWARNING, "Skipping %s, not a shader cache binary.", fsGetPathAsNativeString(binaryFiles[i]));
+			continue;
+		}
+		binary.mFilePath = binaryFiles[i];
+		binaries.push_back(binary);
+	}
+
+	// Sorted table of contents for a binary search at load time
+	eastl::sort(binaries.begin(), binaries.end(), [](const PackedBinary& a, const PackedBinary& b) {
+		return shaderPackKeyLess(a.mEntry.mKey, b.mEntry.mKey);
+	});
+
+	PathHandle  packPath = fsAppendPathComponent(outputDirectory, SHADER_PACK_FILE_NAME);
+	FileStream* pPack = fsOpenFile(packPath, FM_WRITE_BINARY);
+	if (!pPack)
+	{
+		LOGF(LogLevel::eERROR, "Failed to create shader pack %s.", fsGetPathAsNativeString(packPath));
+		return false;
+	}
+
+	ShaderPackHeader header = {};
+	header.mMagic = SHADER_PACK_MAGIC;
+	header.mVersion = SHADER_PACK_VERSION;
+	header.mEntryCount = (uint32_t)binaries.size();
+	fsWriteToStream(pPack, &header, sizeof(header));
+
+	// Table of contents is written once the binary sizes are known
+	uint64_t const tocOffset = sizeof(ShaderPackHeader);
+	uint64_t       offset = tocOffset + binaries.size() * sizeof(ShaderPackEntry);
+	eastl::vector<char> byteCode;
+	bool                success = true;
+	for (size_t i = 0; i < binaries.size() && success; ++i)
+	{
+		FileStream* pBinary = fsOpenFile(binaries[i].mFilePath, FM_READ_BINARY);
+		if (!pBinary)
+		{
+			LOGF(LogLevel::eERROR, "Failed to open %s.", fsGetPathAsNativeString(binaries[i].mFilePath));
+			success = false;
+			break;
+		}
+		byteCode.resize((size_t)fsGetStreamFileSize(pBinary));
+		success = fsReadFromStream(pBinary, byteCode.data(), byteCode.size()) == byteCode.size();
+		fsCloseStream(pBinary);
+
+		uint64_t const alignedOffset = (offset + SHADER_PACK_ALIGNMENT - 1) & ~(uint64_t)(SHADER_PACK_ALIGNMENT - 1);
+		success = success && fsSeekStream(pPack, SBO_START_OF_FILE, (ssize_t)alignedOffset) &&
+				  fsWriteToStream(pPack, byteCode.data(), byteCode.size()) == byteCode.size();
+		binaries[i].mEntry.mOffset = alignedOffset;
+		binaries[i].mEntry.mSize = byteCode.size();
+		offset = alignedOffset + byteCode.size();
+	}
+
+	if (success)
+	{
+		success = fsSeekStream(pPack, SBO_START_OF_FILE, (ssize_t)tocOffset);
+		for (size_t i = 0; i < binaries.size() && success; ++i)
+			success = fsWriteToStream(pPack, &binaries[i].mEntry, sizeof(ShaderPackEntry)) == sizeof(ShaderPackEntry);
+	}
+	fsCloseStream(pPack);
+
+	if (!success)
+	{
+		LOGF(LogLevel::eERROR, "Failed to write shader pack %s.", fsGetPathAsNativeString(packPath));
+		return false;
+	}
+
+	if (!settings->quiet)
+		LOGF(LogLevel::eINFO, "Packed %u shader binaries into %s.", header.mEntryCount, fsGetPathAsNativeString(packPath));
+	return true;
+}
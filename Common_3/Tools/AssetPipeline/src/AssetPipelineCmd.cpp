@@ -1,6 +1,7 @@
 #include "AssetPipeline.h"
 #include "../../../ThirdParty/OpenSource/EASTL/string.h"
 #include "../../../OS/Interfaces/ILog.h"
+#include "../../../Renderer/ShaderPack.h"
 
 #include <cstdio>
 #include <sys/stat.h>
@@ -20,6 +21,8 @@ void PrintHelp()
 	printf("\t-texbits N: use N-bit quantization for texture coordinates (default: 12; N should be between 1 and 16)\n");
 	printf("\t-normbits N: use N-bit quantization for normals and tangents (default: 8; N should be between 1 and 8)\n");
 	printf("\nCommand: processtextures \"textures/directory/\" \"output/directory/\" \n");
+	printf("\nCommand: packshaders \"shader/binaries/directory/\" \"output/directory/\" \n");
+	printf("\tPacks the cached shader binaries into one %s, which addShader reads before loose binaries.\n", SHADER_PACK_FILE_NAME);
 	printf("\nOther:\n");
 	printf("\t-h or -help: Print usage information.\n");
 }
@@ -157,6 +160,11 @@ int AssetPipelineCmd(int argc, char** argv)
 		if (!AssetPipeline::ProcessVirtualTextures(inputDir, outputDir, &settings))
 			return 1;
 	}
+	else if (command == "-ps")
+	{
+		if (!AssetPipeline::PackShaderBinaries(inputDir, outputDir, &settings))
+			return 1;
+	}
 	else
 	{
 		printf("ERROR: Invalid command.\n");
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Headless shader precompiler. Compiles every permutation listed in a manifest into the shader binary cache through
+// the same stage jobs as addShaders, without a window or device. The renderer defines depend on device features,
+// which are given on the command line, the binaries only match devices with these features.
+//
+// Manifest, one shader stage permutation per line, '#' starts a comment:
+//   <file relative to the shader source directory> [target=6_0] [entry=<name>] [NAME=VALUE]...
+// A macro value list NAME=a|b|c expands to one permutation per value, several lists to every combination.
+
+#include "../../../Renderer/IRenderer.h"
+#include "../../../Renderer/ResourceLoader.h"
+#include "../../../Renderer/ShaderPack.h"
+#include "../../../OS/Interfaces/IFileSystem.h"
+#include "../../../OS/Interfaces/ILog.h"
+#include "../../../ThirdParty/OpenSource/EASTL/string.h"
+#include "../../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include <cstdio>
+
+#include "../../../OS/Interfaces/IMemory.h"
+
+const char* gApplicationName = NULL;
+
+extern void vk_setBuiltinShaderDefines(Renderer* pRenderer, bool descriptorIndexing, bool textureArrayDynamicIndexing);
+
+struct ShaderPermutation
+{
+	eastl::string                mFileName;
+	eastl::string                mEntryPoint;
+	ShaderTarget                 mTarget;
+	eastl::vector<eastl::string> mMacroNames;
+	eastl::vector<eastl::string> mMacroValues;
+};
+
+void PrintHelp()
+{
+	printf("ShaderPrecompiler\n");
+	printf("\nCommand: ShaderPrecompiler \"manifest/file\" \"shader/source/directory/\" \"output/directory/\" [flags]\n");
+	printf("\t--quiet: Print only error messages.\n");
+	printf("\t--descriptor-indexing=<0|1>: Whether the target device has VK_EXT_descriptor_indexing. Default 1.\n");
+	printf("\t--texture-array-dynamic-indexing=<0|1>: Whether the target device has shaderSampledImageArrayDynamicIndexing. Default 1.\n");
+	printf("\t--verify: Check that addShader finds every compiled permutation.\n");
+	printf("\nManifest, one shader stage permutation per line:\n");
+	printf("\t<file relative to the shader source directory> [target=6_0] [entry=<name>] [NAME=VALUE]...\n");
+	printf("\tNAME=a|b|c expands to one permutation per value.\n");
+	printf("\nThe output directory can be packed into one %s with AssetPipelineCmd -ps.\n", SHADER_PACK_FILE_NAME);
+	printf("\nOther:\n");
+	printf("\t-h or -help: Print usage information.\n");
+}
+
+static bool ParseShaderTarget(const eastl::string& value, ShaderTarget* pTarget)
+{
+#if defined(DIRECT3D11)
+	static const char*  targetNames[] = { "5_0" };
+	static ShaderTarget targets[] = { shader_target_5_0 };
+#else
+	static const char*  targetNames[] = { "5_1", "6_0", "6_1", "6_2", "6_3" };
+	static ShaderTarget targets[] = { shader_target_5_1, shader_target_6_0, shader_target_6_1, shader_target_6_2, shader_target_6_3 };
+#endif
+	for (uint32_t i = 0; i < sizeof(targets) / sizeof(targets[0]); ++i)
+	{
+		if (value == targetNames[i])
+		{
+			*pTarget = targets[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+static void SplitTokens(const eastl::string& str, const char* separators, eastl::vector<eastl::string>& outTokens)
+{
+	size_t start = str.find_first_not_of(separators);
+	while (start != eastl::string::npos)
+	{
+		size_t const end = str.find_first_of(separators, start);
+		outTokens.push_back(str.substr(start, end == eastl::string::npos ? eastl::string::npos : end - start));
+		start = str.find_first_not_of(separators, end);
+	}
+}
+
+// Appends every permutation of one manifest line
+static bool ParseManifestLine(const eastl::string& line, uint32_t lineNumber, eastl::vector<ShaderPermutation>& outPermutations)
+{
+	eastl::vector<eastl::string> tokens;
+	SplitTokens(line.substr(0, line.find('#')), " \t\r", tokens);
+	if (tokens.empty())
+		return true;
+
+	ShaderPermutation                           permutation = {};
+	eastl::vector<eastl::vector<eastl::string>> macroValueLists;
+	permutation.mFileName = tokens[0];
+	permutation.mTarget = (ShaderTarget)0;
+	for (size_t i = 1; i < tokens.size(); ++i)
+	{
+		size_t const separator = tokens[i].find('=');
+		if (separator == eastl::string::npos || separator == 0)
+		{
+			LOGF(LogLevel::eERROR, "Manifest line %u: expected NAME=VALUE, got %s", lineNumber, tokens[i].c_str());
+			return false;
+		}
+		eastl::string const name = tokens[i].substr(0, separator);
+		eastl::string const value = tokens[i].substr(separator + 1);
+		if (name == "target")
+		{
+			if (!ParseShaderTarget(value, &permutation.mTarget))
+			{
+				LOGF(LogLevel::eERROR, "Manifest line %u: unknown shader target %s", lineNumber, value.c_str());
+				return false;
+			}
+		}
+		else if (name == "entry")
+		{
+			permutation.mEntryPoint = value;
+		}
+		else
+		{
+			permutation.mMacroNames.push_back(name);
+			macroValueLists.push_back(eastl::vector<eastl::string>());
+			SplitTokens(value, "|", macroValueLists.back());
+			// NAME= defines an empty macro
+			if (macroValueLists.back().empty())
+				macroValueLists.back().push_back(eastl::string());
+		}
+	}
+
+	// Every combination of the macro value lists, the first macro varies fastest
+	eastl::vector<size_t> valueIndices(macroValueLists.size(), 0);
+	permutation.mMacroValues.resize(macroValueLists.size());
+	for (bool done = false; !done;)
+	{
+		for (size_t m = 0; m < macroValueLists.size(); ++m)
+			permutation.mMacroValues[m] = macroValueLists[m][valueIndices[m]];
+		outPermutations.push_back(permutation);
+
+		done = true;
+		for (size_t m = 0; m < macroValueLists.size() && done; ++m)
+		{
+			if (++valueIndices[m] < macroValueLists[m].size())
+				done = false;
+			else
+				valueIndices[m] = 0;
+		}
+	}
+	return true;
+}
+
+int ShaderPrecompilerCmd(int argc, char** argv)
+{
+	if (argc > 0)
+		gApplicationName = argv[0];
+
+	if (argc == 1)
+	{
+		PrintHelp();
+		return 0;
+	}
+
+	eastl::string arg = argv[1];
+	arg.make_lower();
+	if (arg == "-h" || arg == "-help")
+	{
+		PrintHelp();
+		return 0;
+	}
+
+	if (argc < 4)
+	{
+		printf("ERROR: Invalid number of arguments.\n");
+		return 1;
+	}
+
+	bool quiet = false;
+	bool verify = false;
+	bool descriptorIndexing = true;
+	bool textureArrayDynamicIndexing = true;
+	for (int i = 4; i < argc; ++i)
+	{
+		arg = argv[i];
+		arg.make_lower();
+		if (arg == "--quiet")
+			quiet = true;
+		else if (arg == "--verify")
+			verify = true;
+		else if (arg == "--descriptor-indexing=0" || arg == "--descriptor-indexing=1")
+			descriptorIndexing = arg.back() == '1';
+		else if (arg == "--texture-array-dynamic-indexing=0" || arg == "--texture-array-dynamic-indexing=1")
+			textureArrayDynamicIndexing = arg.back() == '1';
+		else
+			printf("WARNING: Unrecognized argument: %s\n", arg.c_str());
+	}
+
+	FileSystem* fileSystem = fsGetSystemFileSystem();
+	PathHandle  workingDir = fsCopyWorkingDirectoryPath();
+	PathHandle  paths[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		paths[i] = fsCreatePath(fileSystem, argv[i + 1]);
+		if (!paths[i])
+			paths[i] = fsAppendPathComponent(workingDir, argv[i + 1]);
+	}
+	const PathHandle& manifestPath = paths[0];
+	const PathHandle& sourceDir = paths[1];
+	const PathHandle& outputDir = paths[2];
+
+	FileStream* fh = fsOpenFile(manifestPath, FM_READ_BINARY);
+	if (!fh)
+	{
+		LOGF(LogLevel::eERROR, "Failed to open manifest %s.", fsGetPathAsNativeString(manifestPath));
+		return 1;
+	}
+
+	eastl::vector<ShaderPermutation> permutations;
+	bool                             parsed = true;
+	for (uint32_t lineNumber = 1; !fsStreamAtEnd(fh) && parsed; ++lineNumber)
+		parsed = ParseManifestLine(fsReadFromStreamSTLLine(fh), lineNumber, permutations);
+	fsCloseStream(fh);
+	if (!parsed)
+		return 1;
+
+	// If output directory doesn't exist, create it.
+	if (!fsFileExists(outputDir) && !fsCreateDirectory(outputDir))
+	{
+		LOGF(LogLevel::eERROR, "Failed to create output directory %s.", fsGetPathAsNativeString(outputDir));
+		return 1;
+	}
+	fsSetPathForResourceDirectory(RD_SHADER_SOURCES, sourceDir);
+	fsSetPathForResourceDirectory(RD_SHADER_BINARIES, outputDir);
+
+	// Descs point into the permutations, which don't move anymore
+	eastl::vector<eastl::vector<ShaderMacro>> macros(permutations.size());
+	eastl::vector<ShaderLoadDesc>             descs(permutations.size());
+	for (size_t i = 0; i < permutations.size(); ++i)
+	{
+		const ShaderPermutation& permutation = permutations[i];
+		for (size_t m = 0; m < permutation.mMacroNames.size(); ++m)
+			macros[i].push_back({ permutation.mMacroNames[m].c_str(), permutation.mMacroValues[m].c_str() });
+
+		ShaderLoadDesc& desc = descs[i];
+		memset(&desc, 0, sizeof(desc));
+		desc.mTarget = permutation.mTarget;
+		desc.mStages[0].pFileName = permutation.mFileName.c_str();
+		desc.mStages[0].pMacros = macros[i].data();
+		desc.mStages[0].mMacroCount = (uint32_t)macros[i].size();
+		desc.mStages[0].mRoot = RD_SHADER_SOURCES;
+		desc.mStages[0].pEntryPointName = permutation.mEntryPoint.empty() ? NULL : permutation.mEntryPoint.c_str();
+	}
+
+	// The compile only reads the API and the shader defines of the renderer, no device is created.
+	// The defines are set by the Vulkan renderer itself from the device features given above
+	Renderer* pRenderer = (Renderer*)conf_calloc(1, sizeof(Renderer));
+	pRenderer->mSettings.mApi = RENDERER_API_VULKAN;
+#if defined(DIRECT3D11)
+	pRenderer->mSettings.mShaderTarget = shader_target_5_0;
+#else
+	pRenderer->mSettings.mShaderTarget = shader_target_6_3;
+#endif
+	vk_setBuiltinShaderDefines(pRenderer, descriptorIndexing, textureArrayDynamicIndexing);
+
+	if (!quiet)
+		LOGF(LogLevel::eINFO, "Compiling %u shader permutations.", (uint32_t)descs.size());
+	bool const compiled = compileShaderBinaries(pRenderer, (uint32_t)descs.size(), descs.data());
+
+	// The binaries are written by the stage jobs of addShaders, addShader computes its lookup on its own
+	uint32_t missing = 0;
+	for (size_t i = 0; compiled && verify && i < descs.size(); ++i)
+	{
+		if (!isShaderStageCompiled(pRenderer, &descs[i], 0))
+		{
+			LOGF(LogLevel::eERROR, "addShader doesn't find the binary of %s (manifest permutation %u).", permutations[i].mFileName.c_str(), (uint32_t)i);
+			++missing;
+		}
+	}
+	conf_free(pRenderer);
+
+	if (!compiled)
+	{
+		LOGF(LogLevel::eERROR, "Some shader permutations failed to compile.");
+		return 1;
+	}
+	if (missing)
+	{
+		LOGF(LogLevel::eERROR, "%u shader permutations don't match the runtime binary names.", missing);
+		return 1;
+	}
+
+	if (!quiet)
+		LOGF(LogLevel::eINFO, "Shader binaries written to %s.", fsGetPathAsNativeString(outputDir));
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	extern bool MemAllocInit();
+	extern void MemAllocExit();
+
+	if (!MemAllocInit())
+		return EXIT_FAILURE;
+
+	if (!fsInitAPI())
+		return EXIT_FAILURE;
+
+	Log::Init();
+
+	int ret = ShaderPrecompilerCmd(argc, argv);
+
+	Log::Exit();
+	fsDeinitAPI();
+	MemAllocExit();
+
+	return ret;
+}